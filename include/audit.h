@@ -0,0 +1,56 @@
+#ifndef AUDIT_H
+#define AUDIT_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Roster-wide money totals and invariant violations (see audit_roster).
+typedef struct {
+    uint32_t players;          // live players
+    Money balance;             // sums over live players
+    Money recharged;
+    Money spent;
+    Money won;
+    uint32_t mismatched;       // players whose balance != recharged - spent + won
+    uint32_t negative;         // players with a negative money field
+    uint32_t first_bad_id;     // first offending player in slot order, 0 if none
+} AuditTotals;
+
+// Sums every player's money in one pass over the hot records and checks, exactly, that each
+// balance equals total_recharged - total_spent + total_won (the opening balance counts as a
+// recharge) and that no money field is negative. Uses SSE2 where available.
+// 0 when the roster reconciles, -1 otherwise (details in out).
+int audit_roster(const Roster* r, AuditTotals* out);
+
+// O(1) check of the totals the engine maintains (r->totals), with the saved pot and the pots of
+// the active matches among `matches`:
+//   balances == recharged - spent + won
+//   saved_pot + active pots == spent - won + retired
+// 0 when the books balance, -1 otherwise. Run it after every match_end.
+int audit_verify(const Roster* r, const Accounting* acc, const Match* matches, uint32_t match_count);
+
+// Debug cross-check: a full audit_roster pass compared with r->totals. 0 when every player
+// reconciles and the sums equal the maintained totals, -1 otherwise (sums in out).
+int audit_recount(const Roster* r, AuditTotals* out);
+
+// Recomputes r->totals with a full pass after a checkpoint is loaded, taking the money then in
+// the saved pot and active pots as the baseline stake (totals are not stored). Call before replay.
+void audit_rebase(Roster* r, const Accounting* acc, const Match* matches, uint32_t match_count);
+
+// Rosters saved before v3 left the opening balance out of total_recharged (legacy files store no
+// flows at all). For each live player whose stored flows do not explain the balance, books the
+// difference, balance + spent - won - recharged, as an opening deposit on top of the stored
+// total_recharged. fn (may be NULL) sees the player before the change and the amount booked,
+// which is negative when the stored flows exceed the balance. Returns the players adjusted.
+// Call once the migrated roster is loaded, before audit_rebase.
+typedef void (*AuditOpeningFn)(void* ctx, const Player* p, Money opening);
+uint32_t audit_book_openings(Roster* r, AuditOpeningFn fn, void* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUDIT_H
@@ -10,16 +10,89 @@ extern "C" {
 // Engine lifecycle
 void engine_init(Accounting* acc);
 
+// Money conversions at the edges (input, display, old file formats): units such as 2.5 to cents,
+// rounded to the nearest cent, and cents back to units for printing with %.2f.
+static inline Money money_from_units(double units) {
+    double cents = units * MONEY_SCALE;
+    return (Money)(cents < 0 ? cents - 0.5 : cents + 0.5);
+}
+static inline double money_units(Money cents) { return (double)cents / MONEY_SCALE; }
+
+// Event sink: invoked after every roster, money and match state change (journaling).
+// Pass NULL to disable, e.g. while replaying a journal.
+typedef void (*EngineEventFn)(void* ctx, const EngineEvent* ev);
+void engine_set_event_sink(EngineEventFn fn, void* ctx);
+
+// Roster container (heap-backed, grows in chunks)
+void roster_init(Roster* r);
+void roster_free(Roster* r);
+int  roster_reserve(Roster* r, uint32_t slots); // make room for `slots` players; -1 on OOM
+// Hands n externally allocated chunks to an empty roster (the v3 loader). With `map` set the
+// chunks live inside that private file mapping, which roster_free unmaps instead of freeing
+// them; the pointer tables must come from malloc either way. -1 on OOM.
+int  roster_adopt_chunks(Roster* r, Player** chunks, char** name_chunks, uint32_t n, void* map, size_t map_size);
+int  roster_reindex(Roster* r); // rebuild ID index, live count and free-list after bulk edits of slots [0, slot_count); -1 on OOM
+void roster_compact(Roster* r); // squeeze out tombstones; moves players, so held Player* become stale
+// Forget the dirty slot list once a checkpoint has captured it (see persist_roster_delta).
+// Roster changes mark slots dirty; match_buy_cards changes are marked at match_end / match_cancel.
+void roster_clear_dirty(Roster* r);
+// Copies the live players of src into an empty dst, packed and in slot order (a snapshot for the
+// persistence writer). dst gets no ID index or leaderboards; call roster_reindex before looking players up. -1 on OOM.
+int  roster_copy(Roster* dst, const Roster* src);
+// Books `amount` of purchases into r->totals (balances down, spent up), atomically. match_buy_cards
+// does this itself; the engine calls it when sales reach a hall's match.
+void roster_book_purchase(Roster* r, Money amount);
+
+// Player in a slot below r->slot_count (no bounds check; id == 0 marks a tombstone).
+static inline Player* roster_at(const Roster* r, uint32_t slot) {
+    return &r->chunks[slot >> ROSTER_CHUNK_SHIFT][slot & (ROSTER_CHUNK_SIZE - 1)];
+}
+
+// Name of the player in a slot below r->slot_count (PLAYER_NAME_LEN bytes, NUL-terminated).
+static inline char* roster_name_at(const Roster* r, uint32_t slot) {
+    return r->name_chunks[slot >> ROSTER_CHUNK_SHIFT] + (size_t)(slot & (ROSTER_CHUNK_SIZE - 1)) * PLAYER_NAME_LEN;
+}
+
 // Roster management
-int  engine_add_player(Player* roster, uint32_t* roster_count, const char* name, double initial_balance);
-int  engine_remove_player(Player* roster, uint32_t* roster_count, uint32_t player_id);
-Player* engine_find_player(Player* roster, uint32_t roster_count, uint32_t player_id);
+int  engine_add_player(Roster* r, const char* name, Money initial_balance);
+int  engine_remove_player(Roster* r, uint32_t player_id); // O(1): tombstones the slot
+Player* engine_find_player(Roster* r, uint32_t player_id); // O(1) via ID index
+const char* engine_player_name(const Roster* r, uint32_t player_id); // NULL if not found
+// 0 ok, -1 not found, -2 amount <= 0. The balance is updated atomically (see player_reserve_cards).
+int  engine_recharge_player(Roster* r, uint32_t player_id, Money amount);
 
 // Match management
-void match_start(Match* m, GameMode mode, double card_cost);
-void match_buy_cards(Match* m, Player* p, uint32_t count);
-void match_end(Match* m, Accounting* acc, Player* roster, uint32_t roster_count);
-void match_cancel(Match* m, Player* roster, uint32_t roster_count); // refunds purchases and resets match
+// Pins card cost, saved pot percentage and the multi-winner rule for the whole match.
+// Set m->match_number before calling so the start event carries it.
+void match_start(Match* m, GameMode mode, Money card_cost);
+// Returns 0 on success, -1 if the match is inactive or count is 0, -2 if the ledger could not grow.
+// The caller checks the balance; see player_reserve_cards for buying from several threads.
+// p belongs to r, whose totals the purchase is booked into.
+int  match_buy_cards(Match* m, Roster* r, Player* p, uint32_t count);
+// Buys for many players in one sweep (the "reuse last participation" flow): each line is checked
+// against the player's balance and bought or skipped, and the pot and roster totals are updated
+// once. status[i] gets the line's result: 0 bought, -1 count 0, -3 player not found, -4
+// insufficient balance. Returns the number of lines bought, -1 if the match is inactive or -2 if
+// the ledger could not grow (nothing bought).
+int  match_buy_cards_batch(Match* m, Roster* r, const MatchPurchase* items, uint32_t n, int* status);
+
+// Concurrent purchase path (engine.h sellers). Takes `cost` from the balance with a
+// compare-and-swap, only if the balance covers it, and counts the spend and the cards with
+// atomic adds; 0 ok, -1 insufficient balance. Safe against concurrent reservations and recharges
+// of the same player. player_unreserve_cards reverses a reservation that could not be recorded.
+int  player_reserve_cards(Player* p, uint32_t count, Money cost);
+void player_unreserve_cards(Player* p, uint32_t count, Money cost);
+// Adds an already reserved purchase to the ledger and pot of m and emits the buy event
+// (m->match_number). Does not check m->active or book roster totals. 0 ok, -2 ledger OOM.
+int  match_record_purchase(Match* m, uint32_t player_id, uint32_t count, Money cost);
+// Moves the ledger rows and pot of src, sales recorded for the same match, into dst and leaves
+// src empty. -2 if dst's ledger could not grow: the rows not moved yet stay in src.
+int  match_merge(Match* dst, Match* src);
+void match_end(Match* m, Accounting* acc, Roster* r);
+void match_cancel(Match* m, Roster* r); // refunds purchases and resets match
+void match_release(Match* m); // frees the participant ledger
+// Ledger entry for a player in this match, or NULL if they bought no cards.
+const MatchEntry* match_find_entry(const Match* m, uint32_t player_id);
 
 // Results input
 // Adds a winner only if player exists and purchased at least one card this match.
@@ -31,13 +104,20 @@ void match_cancel(Match* m, Player* roster, uint32_t roster_count); // refunds p
 // -4  player not found
 // -5  player has no cards this match (not solvent/participated)
 // -6  duplicate winner
-int  match_add_winner(Match* m, Player* roster, uint32_t roster_count, uint32_t player_id);
-int  match_remove_winner(Match* m, uint32_t player_id); // returns 0 if removed, -1 not found
+int  match_add_winner(Match* m, Roster* r, uint32_t player_id);
+int  match_remove_winner(Match* m, uint32_t player_id); // returns 0 if removed, -1 not found; may reorder winners
 
 // Accounting utilities
-void apply_payouts_normal(Match* m, Player* roster, uint32_t roster_count);
-// Full house now distributes (saved_pot + current match pot)
-void apply_payouts_fullhouse(Accounting* acc, Match* m, Player* roster, uint32_t roster_count, uint32_t* winners, uint32_t winner_count);
+// Part of the pot saved for the final full house at match_end (0 in full house matches).
+Money match_saved_share(const Match* m);
+// Payout of winner i (0-based) when `amount` is split among n winners: whole cents, with the
+// remainder going one cent each to the first winners, so the shares add up to amount exactly.
+static inline Money money_share(Money amount, uint32_t n, uint32_t i) {
+    return amount / n + (i < (uint32_t)(amount % n) ? 1 : 0);
+}
+void apply_payouts_normal(Match* m, Roster* r);
+// Full house now distributes (saved_pot + current match pot) among m->winners
+void apply_payouts_fullhouse(Accounting* acc, Match* m, Roster* r);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,30 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdio.h>
+#include "session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Headless driver: one text command per line in, one response line per command out
+// (see docs/cli.md for the command set and response format).
+
+#define COMMAND_LINE_LEN 256
+#define COMMAND_SYNC_EVERY 256 // commands between background journal syncs in a stream
+
+// Runs one command line against the session and writes its response to `out`.
+// Blank lines and '#' comments produce no output.
+// Returns 0 ok, -1 the command was rejected (an `err` line was written), 1 quit requested.
+int command_run(Session* s, const char* line, FILE* out);
+
+// Runs commands from `in` until EOF or `quit`. Responses are buffered and flushed by
+// `sync`, `save`, `quit` and at EOF. Returns 0, or 1 if an input line was too long.
+int command_run_stream(Session* s, FILE* in, FILE* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMAND_H
@@ -7,20 +7,30 @@
 extern "C" {
 #endif
 
-// Global configuration accessible via functions
+// Global configuration accessible via functions. The settings live in an immutable
+// ConfigSnapshot (types.h) behind an atomic pointer: readers never lock, and a change publishes
+// a new snapshot instead of editing the current one. A match copies the snapshot at
+// match_start, so its rules cannot change while cards are sold or paid out.
 void cfg_init_defaults(void);
 
-// Tunables (mutable via setters)
-double cfg_get_normal_card_cost(void);
-void   cfg_set_normal_card_cost(double cost);
+// Current snapshot; one acquire load. The snapshot stays valid for the life of the process.
+const ConfigSnapshot* cfg_snapshot(void);
 
-double cfg_get_fullhouse_card_cost(void); // can be undefined (<=0) if not set
-void   cfg_set_fullhouse_card_cost(double cost);
+// Publishes a copy of `next` as the current snapshot. -1 if it fails cfg_validate's checks,
+// -2 if out of memory.
+int cfg_publish(const ConfigSnapshot* next);
 
-// Percentage of each normal match pot saved for final full house
-// value in [0,1]
-double cfg_get_saved_pot_percentage(void);
-void   cfg_set_saved_pot_percentage(double pct);
+// Tunables; each setter publishes a new snapshot with one field changed. Card costs in cents
+Money  cfg_get_normal_card_cost(void);
+void   cfg_set_normal_card_cost(Money cost);
+
+Money  cfg_get_fullhouse_card_cost(void); // can be undefined (<=0) if not set
+void   cfg_set_fullhouse_card_cost(Money cost);
+
+// Share of each normal match pot saved for final full house,
+// in basis points [0, MONEY_BP_SCALE]
+uint32_t cfg_get_saved_pot_bp(void);
+void     cfg_set_saved_pot_bp(uint32_t bp);
 
 // Max players supported in roster
 uint32_t cfg_get_max_players(void);
@@ -0,0 +1,86 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "types.h"
+#include "leaderboard.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Shared engine handle for several halls: one roster and Accounting, and one match per hall.
+// Every call is thread-safe, and matches in different halls run in parallel:
+//  - each hall has its own lock, held by that hall's match calls only
+//  - the roster has a reader/writer lock: per-player calls (recharge, lookup, engine_match_buy)
+//    share it, adding/removing players and ending/cancelling a match take it exclusively
+//  - balances are reserved and recharged with atomic operations (player_reserve_cards), so
+//    per-player calls need no lock of their own
+//  - sellers (below) sell into a hall without its lock or the roster's: each holds only its own
+//    lock, which everything that changes the roster or the hall's match takes as well
+// Lock order: hall -> roster -> sellers. The event sink (engine_set_event_sink) must be set
+// before other threads use the handle, and the sink must be thread-safe (the journal is).
+typedef struct Engine Engine;
+
+// A seller: one thread's card sales into one hall. Each buy takes the player's money with a
+// compare-and-swap and books the cards on the seller's private ledger and pot, so sellers on
+// different cores never wait for each other; the sales are merged into the hall's match when
+// it is read, gets a winner, ends or is cancelled. Use a handle from one thread at a time.
+typedef struct EngineSeller EngineSeller;
+
+#define ENGINE_MAX_HALLS 64
+
+// NULL on OOM or a hall count outside [1, ENGINE_MAX_HALLS].
+Engine*  engine_create(uint32_t hall_count);
+void     engine_destroy(Engine* e);
+uint32_t engine_hall_count(const Engine* e);
+
+// Exclusive access to all state, blocking every other call: loading, journal replay
+// (pass the halls array), checkpoints and reports. `halls` has engine_hall_count entries.
+// After loading a checkpoint, call audit_rebase (audit.h) before replaying the journal, and
+// leaderboard_attach after it to keep the boards engine_leaderboard reads.
+void engine_exclusive_begin(Engine* e, Roster** r, Accounting** acc, Match** halls);
+void engine_exclusive_end(Engine* e);
+// O(1) conservation check over the roster totals, saved pot and every hall's pot (audit_verify),
+// with sellers' sales merged first. 0 balanced, -1 not. Call it after engine_match_end.
+int engine_verify(Engine* e);
+
+int engine_player_add(Engine* e, const char* name, Money initial_balance); // ID, or -1 (max players / OOM)
+int engine_player_remove(Engine* e, uint32_t player_id);                   // 0, -1 not found
+int engine_player_recharge(Engine* e, uint32_t player_id, Money amount);   // engine_recharge_player codes
+// Copies the player record and, if `name` is not NULL, its name (PLAYER_NAME_LEN bytes). -1 not found.
+// Money fields are read one by one, so a copy taken during a sale may be between its updates.
+int engine_player_get(Engine* e, uint32_t player_id, Player* out, char* name);
+// leaderboard_top under the roster read lock: the best k players of a board, best first. Sales
+// through sellers count once their match ends or is cancelled. 0 when no boards are attached.
+uint32_t engine_leaderboard(Engine* e, BoardKind kind, uint32_t k, BoardEntry* out);
+
+// Returns the new match number, -1 bad hall, -2 a match is already active in the hall.
+int engine_match_start(Engine* e, uint32_t hall, GameMode mode, Money card_cost);
+// Sells under the hall lock; see sellers for the concurrent path.
+// 0 ok, -1 no active match (or bad hall, count 0), -2 ledger OOM, -3 player not found, -4 insufficient balance.
+int engine_match_buy(Engine* e, uint32_t hall, uint32_t player_id, uint32_t count);
+// match_buy_cards_batch under the hall lock and the roster taken exclusively; same codes, -1 also for a bad hall.
+int engine_match_buy_batch(Engine* e, uint32_t hall, const MatchPurchase* items, uint32_t n, int* status);
+// match_add_winner codes, or -7 if the sellers' sales could not be merged (OOM).
+int engine_match_add_winner(Engine* e, uint32_t hall, uint32_t player_id);
+int engine_match_remove_winner(Engine* e, uint32_t hall, uint32_t player_id); // 0, -1 not found / no match
+// 0, -1 no active match, -2 buyers but no winner, -3 sales could not be merged (OOM; still active).
+int engine_match_end(Engine* e, uint32_t hall);
+int engine_match_cancel(Engine* e, uint32_t hall); // 0, -1 no active match, -3 merge OOM
+// Copies the hall's match, sellers' sales included, without its ledger (entries pointers are NULL).
+// -1 bad hall, -3 merge OOM (the copy then lacks the unmerged sales).
+int engine_match_get(Engine* e, uint32_t hall, Match* out);
+
+// NULL on OOM or a bad hall. Opening and closing take the roster exclusively; keep a seller for
+// the lifetime of a selling thread rather than per sale.
+EngineSeller* engine_seller_open(Engine* e, uint32_t hall);
+// Merges the seller's unmerged sales into the hall's match and frees it. -3 merge OOM: the seller stays open.
+int engine_seller_close(EngineSeller* s);
+// engine_match_buy codes.
+int engine_seller_buy(EngineSeller* s, uint32_t player_id, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ENGINE_H
@@ -0,0 +1,58 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Binary write-ahead journal of engine events (see docs/persistence.md for the layout).
+// Appends are buffered in memory (a full buffer is written out); journal_sync writes the rest
+// and fsyncs. Callers group records between syncs: writer_sync_journal at every CLI pause and
+// every COMMAND_SYNC_EVERY commands of a batch stream; the server syncs once per event loop pass.
+// All calls are safe from multiple threads (the persistence writer trims while the engine appends).
+typedef struct Journal Journal;
+
+// Position of the last record at the time a checkpoint snapshot was taken.
+typedef struct {
+    uint64_t seq;
+    uint64_t offset;           // file offset just past that record
+} JournalMark;
+
+// Opens or creates the journal. A torn or corrupt tail is cut off. `base_seq` seeds the
+// sequence of a brand-new file (pass Accounting.journal_seq). NULL on failure.
+Journal* journal_open(const char* path, uint64_t base_seq);
+void     journal_close(Journal* j); // syncs pending records
+
+int journal_append(Journal* j, const EngineEvent* ev); // memcpy into the buffer; 0 ok, -1 I/O error
+int journal_sync(Journal* j);   // write and fsync now
+JournalMark journal_mark(Journal* j);
+// Drops records up to `mark` once the checkpoint taken at that mark is durable; later records are kept.
+int journal_trim(Journal* j, JournalMark mark);
+int journal_reset(Journal* j);  // trim everything; sequence numbers keep counting
+uint64_t journal_last_seq(Journal* j);
+
+// Adapter for engine_set_event_sink(journal_event_sink, journal).
+void journal_event_sink(void* ctx, const EngineEvent* ev);
+
+// History and ledger bases journal_replay records finished matches into.
+typedef struct {
+    const char* matches_path;  // persist_append_match
+    const char* ledger_path;   // persist_append_ledger
+} JournalReplayFiles;
+
+// Re-applies records newer than acc->journal_seq to a checkpointed roster/accounting.
+// Match records go to halls[hall] as recorded at match start (a single-hall session passes
+// its one match); matches still open at the end of the journal are left active there.
+// Matches that end or are cancelled in the replayed records are appended to `files` unless
+// already recorded there (either path may be NULL; NULL files writes nothing).
+// Call with the engine event sink disabled. Returns records applied, or -1 if the file is unreadable.
+int journal_replay(const char* path, Roster* r, Accounting* acc, Match* halls, uint32_t hall_count,
+                   const JournalReplayFiles* files);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JOURNAL_H
@@ -0,0 +1,51 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include "types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Player rankings kept in order as the engine changes players, so the top of a board is read
+// without sorting the roster. Attached to a roster (r->boards); while attached the engine
+// updates them on add/remove, purchases, payouts, match_end and match_cancel.
+typedef enum {
+    BOARD_WON,      // total_won
+    BOARD_NET,      // total_won - total_spent
+    BOARD_CARDS,    // lifetime_cards
+    BOARD_WINS,     // record.wins
+    BOARD_COUNT
+} BoardKind;
+
+typedef struct {
+    uint32_t player_id;
+    int64_t score;     // cents for BOARD_WON and BOARD_NET, a count otherwise
+} BoardEntry;
+
+// Builds the boards over every live player and attaches them to r, replacing any attached before.
+// Call once the roster is loaded and the journal replayed. 0 ok, -1 OOM (r->boards is then NULL).
+int  leaderboard_attach(Roster* r);
+void leaderboard_detach(Roster* r);
+
+// Writes the best k players of a board to out, best first; equal scores rank the lower ID
+// first. O(k + log N). Returns the number written, 0 when r has no boards.
+// Purchases made through sellers (engine.h) count once their match ends or is cancelled.
+uint32_t leaderboard_top(const Roster* r, BoardKind kind, uint32_t k, BoardEntry* out);
+int64_t  leaderboard_score(const Player* p, BoardKind kind);
+const char* leaderboard_name(BoardKind kind);   // "won", "net", "cards", "wins"
+int  leaderboard_parse(const char* name);       // BoardKind for a leaderboard_name, -1 if none
+
+// Engine hooks (bingo.c). leaderboard_reserve makes room for a player ID before it is added,
+// so the others never allocate; the rest are O(log N) and update only the boards whose score moved.
+int  leaderboard_reserve(Leaderboards* b, uint32_t player_id); // -1 on OOM
+void leaderboard_insert(Leaderboards* b, const Player* p);
+void leaderboard_update(Leaderboards* b, const Player* p);
+void leaderboard_remove(Leaderboards* b, uint32_t player_id);
+void leaderboard_free(Leaderboards* b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LEADERBOARD_H
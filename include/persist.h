@@ -7,20 +7,195 @@
 extern "C" {
 #endif
 
-int persist_save_roster(const char* path, Player* roster, uint32_t roster_count);
-int persist_load_roster(const char* path, Player* roster, uint32_t* roster_count, uint32_t max_players);
+// Changed roster records in file byte order, plus the new checksums of the chunks they touch
+// (see persist_roster_delta).
+typedef struct {
+    uint32_t slot_count;       // roster header fields when the delta was taken
+    uint32_t live_count;
+    uint32_t next_id;
+    uint32_t chunk_count;
+    Accounting acc;            // written into the header with the records
+    uint32_t count;            // records below
+    uint32_t* slots;           // ascending
+    Player* players;           // little-endian
+    char* names;               // count * PLAYER_NAME_LEN bytes
+    uint32_t sum_count;
+    uint32_t* sum_chunks;
+    uint64_t* sums;
+} RosterDelta;
 
-int persist_save_accounting(const char* path, const Accounting* acc);
+// Compacts the roster (see roster_compact), then writes a v3 file beside `path` and renames it
+// into place. The header carries `acc` (NULL: a fresh Accounting), so the roster and the
+// accounting checkpoint, journal position included, are replaced together. Saves fsync before
+// returning; -1 if the file could not be written.
+int persist_save_roster(const char* path, Roster* r, const Accounting* acc);
+
+// Incremental checkpoint: captures the dirty slots of r and clears them, along with `acc` for the
+// header. Only valid while !r->needs_rewrite (the file's slots match memory). -1 on OOM (dirty set is kept).
+int persist_roster_delta(RosterDelta* d, Roster* r, const Accounting* acc);
+void persist_roster_delta_free(RosterDelta* d);
+// Writes the delta's records, chunk checksums and header to <path>.redo and fsyncs it, then
+// rewrites them in place, fsyncs and removes the redo file. A crash in between is finished by the
+// next persist_load_roster. 0 ok, -1 I/O error, -2 file missing, not v3 or out of checksum slots
+// (do a full save instead).
+int persist_write_roster_delta(const char* path, const RosterDelta* d);
+// Loads into an empty r and rebuilds the ID index, first finishing an interrupted incremental
+// save. A v3 file is mapped and its chunk blocks become the roster storage where supported, and
+// its accounting checkpoint is copied to `acc` (may be NULL). v2 and legacy files are converted in
+// memory, leave `acc` alone and get rewritten as v3 by the next checkpoint.
+// -1 no file, -2 over max_players, -3 corrupt or truncated, -4 OOM.
+int persist_load_roster(const char* path, Roster* r, uint32_t max_players, Accounting* acc);
+
+// Reads the accounting.bin that goes with a v2 or legacy roster (a raw struct of doubles).
+// 0 ok, -1 no file, -2 truncated.
 int persist_load_accounting(const char* path, Accounting* acc);
 
-// Simple match history append (CSV-like)
-int persist_append_match(const char* path, const Match* m);
+// Match history (history.c): an indexed binary store of finished matches under a base path
+// (SESSION_MATCHES_PATH): <base>.bin column blocks, <base>.idx block directory and winner index,
+// <base>.tail the rows of the block being filled. See docs/persistence.md.
+#define HISTORY_BLOCK_MATCHES 256
+#define HISTORY_MAX_WINNERS 64
+#define HISTORY_IMPORTED 1     // flag: converted from matches.csv (no end time; see persist_import_match_csv)
+
+typedef struct {
+    uint32_t match_number;
+    uint8_t mode;              // GameMode
+    uint8_t flags;             // HISTORY_IMPORTED
+    uint32_t hall;
+    uint32_t buyers;           // players who bought cards
+    uint32_t cards;
+    int64_t ended_at;          // seconds since the epoch; never decreases along the history
+    Money card_cost;
+    Money pot;                 // card sales (card_cost * cards)
+    Money saved;               // put aside for the full house (normal matches)
+    Money paid;                // paid to the winners; winner i got money_share(paid, winner_count, i)
+    uint32_t winner_count;
+    uint32_t winners[HISTORY_MAX_WINNERS];
+} HistoryMatch;
+
+// Appends a finished match (called after match_end). Match numbers must increase: -2 if not
+// (the match is not recorded), -1 on I/O error. Every HISTORY_BLOCK_MATCHES matches the tail is
+// sealed into a block and the index rewritten.
+int persist_append_match(const char* base, const Match* m);
+
+// Read-only view of the history as of opening; reopen to see later appends. A missing history
+// is empty. NULL on OOM or a damaged block file.
+typedef struct MatchHistory MatchHistory;
+MatchHistory* persist_history_open(const char* base);
+void persist_history_close(MatchHistory* h);
+uint64_t persist_history_count(const MatchHistory* h);
+// O(log n). 0 found, -1 not recorded, -2 read error.
+int persist_history_find(MatchHistory* h, uint32_t match_number, HistoryMatch* out);
+// Visitor for the range queries; return non-zero to stop.
+typedef int (*HistoryFn)(void* ctx, const HistoryMatch* m);
+// Matches that ended in [from, to), in order; O(log n) to the first. Returns matches visited, -2 read error.
+int persist_history_between(MatchHistory* h, int64_t from, int64_t to, HistoryFn fn, void* ctx);
+// Matches the player won that ended in [from, to), in order; O(log n) to the first, then one
+// lookup per win. Returns matches visited, -2 read error.
+int persist_history_player_wins(MatchHistory* h, uint32_t player_id, int64_t from, int64_t to, HistoryFn fn, void* ctx);
+
+// Converts a matches.csv history (with match_ledger.csv for buyers and cards, if not NULL) into
+// an empty binary history. Imported matches have ended_at 0; a full house's payout is rebuilt
+// from the saved shares of the matches before it. Returns matches imported, -1 no CSV,
+// -2 the history is not empty, -3 I/O error or OOM.
+int persist_import_match_csv(const char* csv_path, const char* ledger_path, const char* base);
+
+// Player ledger (ledger.c): one row per buyer of every ended or cancelled match under a base
+// path (SESSION_LEDGER_PATH): <base>.bin varint segments, <base>.idx segment directory and
+// per-player run offsets, <base>.tail the rows of the segment being filled. See docs/persistence.md.
+#define LEDGER_SEGMENT_ROWS 4096  // tail rows sealed into a segment (whole matches, so it may run over)
+#define LEDGER_CANCELLED 1     // flag: the match was cancelled; payout is the refund of spend
+#define LEDGER_IMPORTED 2      // flag: converted from match_ledger.csv (see persist_import_ledger_csv)
+
+typedef struct {
+    uint32_t match_number;
+    uint32_t player_id;
+    uint8_t flags;             // LEDGER_CANCELLED, LEDGER_IMPORTED
+    int64_t at;                // match end or cancel, seconds since the epoch; never decreases
+    uint32_t cards;
+    Money spend;               // card_cost * cards
+    Money payout;              // the player's winner share (0 if lost), or the refund
+} LedgerRow;
+
+// Totals over the matches in a time range (persist_ledger_summary).
+typedef struct {
+    uint64_t matches;
+    uint64_t rows;             // buyer rows
+    uint64_t cards;
+    Money spend;
+    Money won;                 // payouts of ended matches
+    Money refunded;            // payouts of cancelled matches
+} LedgerSummary;
+
+// Appends one row per ledger entry of a match that just ended, or with `cancelled` was just
+// cancelled (match_cancel keeps the entries). Match numbers must increase: -2 if not (nothing is
+// recorded), -1 on I/O error or OOM. A match nobody bought into adds no rows.
+int persist_append_ledger(const char* base, const Match* m, int cancelled);
+
+// Read-only view of the ledger as of opening; reopen to see later appends. A missing ledger is
+// empty. NULL on OOM or a damaged segment file.
+typedef struct PlayerLedger PlayerLedger;
+PlayerLedger* persist_ledger_open(const char* base);
+void persist_ledger_close(PlayerLedger* l);
+uint64_t persist_ledger_rows(const PlayerLedger* l);
+typedef int (*LedgerFn)(void* ctx, const LedgerRow* row);
+// A player's rows of the matches that ended in [from, to), in match order: O(log n) to the
+// player's first segment, then one read of the player's run per segment. Returns rows visited,
+// -2 read error.
+int persist_ledger_statement(PlayerLedger* l, uint32_t player_id, int64_t from, int64_t to, LedgerFn fn, void* ctx);
+// Totals of the matches that ended in [from, to). Segments wholly inside the range use the
+// directory totals; only the two boundary segments' match tables are read. 0 ok, -2 read error.
+int persist_ledger_summary(PlayerLedger* l, int64_t from, int64_t to, LedgerSummary* out);
+
+// Converts match_ledger.csv rows `match,player,cards,spend` into an empty ledger. Payouts and
+// times come from the match history at `history_base` (convert it first); rows of matches it
+// lacks get payout 0 and the previous time. Returns rows imported, -1 no CSV, -2 the ledger is
+// not empty, -3 I/O error or OOM.
+int persist_import_ledger_csv(const char* csv_path, const char* history_base, const char* base);
+
+// Bulk text input (import.c). Files are mapped and scanned in place. Malformed rows go to a
+// CsvErrorFn (may be NULL) with their line number, counted from 1.
+typedef void (*CsvErrorFn)(void* ctx, uint64_t line, const char* reason);
+
+// Adds a player per `name,balance` row (an optional first row `name,balance` is a header; names
+// may be double-quoted, balances are units with up to two decimals). Every row is checked
+// before the roster changes, so a file with a malformed row adds nobody. Returns players added,
+// the first of them with ID *first_id and the rest in order; -1 cannot read the file,
+// -2 malformed rows (all reported), -3 over max_players, -4 OOM (players added so far stay).
+int persist_import_players_csv(const char* path, Roster* r, CsvErrorFn on_error, void* ctx, uint32_t* first_id);
+
+// transactions.csv rows `type,time,details`. The rows that move money are decoded; the rest
+// (checkpoint, audit, ...) are passed as TXN_OTHER.
+typedef enum { TXN_OTHER, TXN_ADD, TXN_REMOVE, TXN_RECHARGE, TXN_BUY } TxnType;
+typedef struct {
+    TxnType type;
+    uint64_t line;
+    int64_t at;                // seconds since the epoch
+    uint32_t player_id;
+    uint32_t count;            // TXN_BUY: cards
+    Money amount;              // TXN_ADD opening balance, TXN_RECHARGE amount, TXN_BUY cost
+    const char* name;          // TXN_ADD: name_len bytes inside the mapped file, not terminated
+    uint32_t name_len;
+} TxnRow;
+typedef int (*TxnFn)(void* ctx, const TxnRow* row); // nonzero stops the scan
+// Visits the valid rows in file order and reports the malformed ones, which are skipped.
+// Returns rows visited, -1 cannot read the file.
+int persist_read_transactions(const char* path, TxnFn fn, void* ctx, CsvErrorFn on_error, void* ectx);
 
-// Export roster financial summary to CSV
-int persist_export_players_csv(const char* path, Player* roster, uint32_t roster_count);
+// Roster financial summary as CSV, one row per live player in slot order. Rows are formatted a
+// roster chunk at a time on up to `threads` threads (0 = one per core, at most
+// EXPORT_MAX_THREADS); the output does not depend on the thread count.
+#define EXPORT_MAX_THREADS 8
+// Writes the summary to an open descriptor. 0 ok, -1 write error, -2 OOM.
+int persist_write_players_csv(int fd, const Roster* r, unsigned threads);
+// Writes the summary to `path` via a synced temp file and rename, so readers see either the old
+// export or the whole new one. 0 ok, -1 I/O error, -2 OOM.
+int persist_export_players_csv(const char* path, const Roster* r, unsigned threads);
 
 // Append transactional log rows: type,timestamp,details
 int persist_append_transaction(const char* path, const char* type, const char* details);
+// Appends one row per line of `rows` (details lines, each ending in '\n'), all of one type and time.
+int persist_append_transactions(const char* path, const char* type, const char* rows, size_t len);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,26 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "session.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Daemon mode: serves the batch command protocol (command.h) to many clients over a local
+// socket from a single-threaded epoll loop (see docs/cli.md). Responses are sent only after the
+// journal sync that covers their commands. Linux only for now.
+
+#define SERVER_MAX_CLIENTS 256
+#define SERVER_READ_CHUNK 16384
+#define SERVER_OUTPUT_LIMIT (1u << 20) // pending response bytes before a client stops being read
+
+// `endpoint` is "unix:<path>" or "tcp:<port>" (bound to 127.0.0.1 only).
+// Runs until SIGINT/SIGTERM. 0 on clean shutdown, -1 if the socket could not be set up.
+int server_run(Session* s, const char* endpoint);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SERVER_H
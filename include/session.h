@@ -0,0 +1,65 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "types.h"
+#include "journal.h"
+#include "writer.h"
+#include "persist.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SESSION_ROSTER_PATH "data/roster.bin"
+#define SESSION_ACCOUNTING_PATH "data/accounting.bin" // accounting of a pre-v3 roster, read once
+#define SESSION_JOURNAL_PATH "data/journal.bin"
+#define SESSION_TRANSACTIONS_PATH "data/transactions.csv"
+#define SESSION_MATCHES_PATH "data/matches"          // match history base path (persist_append_match)
+#define SESSION_MATCHES_CSV_PATH "data/matches.csv"  // history before the binary store, converted once
+#define SESSION_LEDGER_PATH "data/ledger"            // player ledger base path (persist_append_ledger)
+#define SESSION_LEDGER_CSV_PATH "data/match_ledger.csv" // spend per buyer before the ledger, converted once
+
+// The engine state of one running process plus the files behind it. Shared by the
+// interactive menu and the batch driver so both persist the same way.
+typedef struct {
+    Roster roster;
+    Accounting acc;
+    Match match;               // current match; active after a crash mid-match is replayed
+    Journal* journal;          // NULL if the journal could not be opened
+    Writer* writer;
+} Session;
+
+// Loads the checkpoint, replays the journal and attaches the leaderboards (if memory allows),
+// then opens the journal as the engine event sink and starts the writer. `max_players`, if not 0,
+// replaces the configured cap before the roster is loaded (bingo --max-players). 0 ok, 1 ok but no
+// journal (changes saved only at checkpoints), -1 OOM, -2 roster file corrupt, -3 legacy accounting
+// file corrupt, -4 roster holds more than max_players. A missing file starts empty; on any
+// error the files are left untouched and nothing needs closing.
+int  session_open(Session* s, uint32_t max_players);
+// Queues a roster + accounting checkpoint and journal trim. While a match is open its state
+// exists only in the journal, so only a journal sync is queued. Returns 1 if a full checkpoint was queued.
+int  session_checkpoint(Session* s);
+// Queues the match history and ledger rows of the match that just ended. Call before the
+// session_checkpoint that follows, so the journal is trimmed only after the rows are written.
+void session_record_match(Session* s);
+// Queues the ledger rows (refunds) of the match that was just cancelled.
+void session_record_cancel(Session* s);
+// Queues a transactions.csv row.
+void session_log(Session* s, const char* type, const char* details);
+// Queues the `add` row of a player just added (id, opening balance, name).
+void session_log_add(Session* s, uint32_t id);
+// Bulk player import (persist_import_players_csv), then the `add` rows of everyone added and a
+// checkpoint. Same return values.
+int  session_import_players(Session* s, const char* path, CsvErrorFn on_error, void* ctx, uint32_t* first_id);
+// O(1) check that the books balance (audit_verify); run after every match_end and match_cancel.
+// On failure logs an `audit` row with the totals and returns -1.
+int  session_verify(Session* s);
+// Final checkpoint, then waits for the writer and releases everything.
+// Returns the writer_flush result (0 ok, -1 a save failed).
+int  session_close(Session* s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SESSION_H
@@ -1,8 +1,15 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+// Money is carried as whole cents, so sums and splits are exact and balances can be
+// updated with integer atomics.
+typedef int64_t Money;
+#define MONEY_SCALE 100       // cents per currency unit
+#define MONEY_BP_SCALE 10000  // basis points per whole (percentages such as the saved pot share)
+
 typedef enum {
     GAME_NORMAL = 1,     // includes line/diagonal/corners
     GAME_FULL_HOUSE = 2
@@ -14,33 +21,143 @@ typedef struct {
     uint32_t draws;
 } Record;
 
+#define PLAYER_NAME_LEN 64
+
+// Hot per-player record: everything the payout, loss-marking, reset and audit loops touch.
+// Names are cold data and live in the roster's parallel name chunks (see roster_name_at).
 typedef struct {
     uint32_t id;
-    char name[64];
-    double balance;    // money owned by player
-    Record record;     // wins/losses/draws
-    uint32_t cards_owned; // cards purchased in current match
+    uint32_t cards_owned; // cards held in open matches (one per hall)
     uint32_t lifetime_cards; // for stats
-    double total_recharged; // cumulative added funds
-    double total_spent;     // cumulative spent on cards
-    double total_won;       // cumulative winnings from payouts
+    Record record;     // wins/losses/draws
+    Money balance;     // money owned by player
+    Money total_recharged;  // cumulative added funds
+    Money total_spent;      // cumulative spent on cards
+    Money total_won;        // cumulative winnings from payouts
 } Player;
 
+#define ROSTER_CHUNK_SHIFT 10                      // 1024 players per chunk
+#define ROSTER_CHUNK_SIZE  (1u << ROSTER_CHUNK_SHIFT)
+
+// Money totals over a roster, kept current by every call that moves player money, so the
+// books can be checked in O(1) (audit_verify) instead of by a pass over every player.
+typedef struct {
+    Money balances;    // sum of balance over live players
+    Money recharged;   // sum of total_recharged over live players
+    Money spent;       // sum of total_spent over live players (purchases booked on a match)
+    Money won;         // sum of total_won over live players
+    Money retired;     // net stake (spent - won) of removed players, less pot money paid to no one
+} RosterTotals;
+
+typedef struct Leaderboards Leaderboards; // leaderboard.h
+
+// Growable player storage plus an ID -> slot index. Players live in fixed-size
+// chunks that are never moved, so a Player* stays valid while the roster grows.
+// Each chunk has a hot Player block and a parallel cold block of names.
+// Removed players leave a tombstone (id == 0) whose slot goes on a free-list;
+// full-roster loops run over [0, slot_count) and skip tombstones.
+// IDs are handed out sequentially, so the index is a direct-mapped table rather than a hash.
+// Slots changed since the last checkpoint are tracked so a save can rewrite just those records.
+typedef struct {
+    Player** chunks;        // chunk_count blocks of ROSTER_CHUNK_SIZE players
+    char** name_chunks;     // matching blocks of ROSTER_CHUNK_SIZE * PLAYER_NAME_LEN bytes
+    uint32_t chunk_count;
+    uint32_t count;         // live players
+    uint32_t slot_count;    // slots handed out so far (live + tombstones)
+    uint32_t capacity;      // chunk_count * ROSTER_CHUNK_SIZE
+    uint32_t next_id;       // next player ID; monotonic, independent of slots
+    uint32_t* id_slots;     // id -> slot + 1 (0 = absent)
+    uint32_t id_capacity;   // entries in id_slots
+    uint32_t* free_slots;   // stack of tombstoned slots available for reuse
+    uint32_t free_count;
+    uint32_t free_capacity;
+    uint32_t* dirty_slots;  // slots changed since the last checkpoint, each listed once
+    uint32_t dirty_count;
+    uint32_t dirty_capacity; // always capacity: every slot fits, so marking never allocates
+    uint64_t* dirty_bits;   // one bit per slot (capacity bits), dedupes dirty_slots
+    uint8_t needs_rewrite;  // slots no longer match the file (new roster, compaction, old format)
+    void* map;              // private mapping of a v3 roster file backing the first mapped_chunks chunks
+    size_t map_size;
+    uint32_t mapped_chunks;
+    RosterTotals totals;    // not stored: audit_rebase recomputes them after a load
+    Leaderboards* boards;   // kept by the engine when attached (leaderboard_attach), else NULL
+} Roster;
+
+// Immutable configuration snapshot (config.h). Published whole through an atomic pointer,
+// never modified in place.
+typedef struct {
+    Money normal_card_cost;
+    Money fullhouse_card_cost;   // <= 0 when not set
+    uint32_t saved_pot_bp;       // share of each normal pot saved for the full house
+    uint32_t max_players;
+    uint8_t allow_multi_winners;
+} ConfigSnapshot;
+
+// One row of a match's participant ledger.
+typedef struct {
+    uint32_t player_id;
+    uint32_t cards;            // cards bought by this player in the match
+    uint32_t winner_pos;       // index in Match.winners + 1, 0 when not a winner
+} MatchEntry;
+
+// One line of a batch purchase (match_buy_cards_batch).
+typedef struct {
+    uint32_t player_id;
+    uint32_t count;
+} MatchPurchase;
+
 typedef struct {
     GameMode mode;
-    double card_cost;          // cost per card for this match
-    double pot;                // total money collected in this match
-    double saved_for_fullhouse;// amount saved from this match for final full house
+    Money card_cost;           // cost per card for this match
+    ConfigSnapshot rules;      // configuration current at match_start (save share, multi-winner rule)
+    Money pot;                 // total money collected in this match
+    Money saved_for_fullhouse; // amount saved from this match for final full house
+    Money paid_out;            // paid to the winners by match_end (full house: saved pot + pot)
     uint32_t match_number;
+    uint32_t hall;             // hall running the match (engine handle); 0 for a single-hall session
     uint32_t winners[64];      // player ids who won
     uint32_t winner_count;     // number of winners
     uint8_t active;            // 1 when active/in-progress, 0 otherwise
+    // Participant ledger: one entry per buying player, in first-purchase order.
+    // Heap-backed and reused across matches; release with match_release().
+    MatchEntry* entries;
+    uint32_t entry_count;
+    uint32_t entry_capacity;
+    uint32_t* entry_slots;     // open-addressing table: player id -> entry index + 1
+    uint32_t entry_slot_mask;  // table size - 1 (power of two), 0 when unallocated
 } Match;
 
 typedef struct {
-    double total_bank;         // house/account balance tracking
-    double saved_pot;          // accumulated pot reserved for final full house
+    Money total_bank;          // house/account balance tracking
+    Money saved_pot;           // accumulated pot reserved for final full house
     uint32_t total_matches;
+    uint64_t journal_seq;      // last journal record folded into this checkpoint
+    uint32_t next_match;       // number of the next match started; cancelled numbers are not reused
 } Accounting;
 
+// State changes reported by the engine (see engine_set_event_sink).
+typedef enum {
+    EV_PLAYER_ADD = 1,   // player_id, amount = initial balance, name
+    EV_PLAYER_REMOVE,    // player_id
+    EV_RECHARGE,         // player_id, amount
+    EV_MATCH_START,      // match_number, count = mode, amount = card cost, aux = saved basis points, flags = allow multi | hall << 8
+    EV_BUY,              // match_number, player_id, count = cards, amount = cost
+    EV_WINNER_ADD,       // match_number, player_id
+    EV_WINNER_REMOVE,    // match_number, player_id
+    EV_PAYOUT,           // match_number, player_id, amount
+    EV_MATCH_END,        // match_number, amount = pot, aux = saved for full house
+    EV_MATCH_CANCEL      // match_number, amount = refunded pot
+} EngineEventType;
+
+typedef struct {
+    EngineEventType type;
+    uint32_t match_number;
+    uint32_t player_id;
+    uint32_t count;
+    uint32_t flags;
+    Money amount;
+    int64_t aux;
+    const char* name;          // EV_PLAYER_ADD only
+} EngineEvent;
+
 #endif // TYPES_H
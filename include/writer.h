@@ -0,0 +1,51 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include "types.h"
+#include "journal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Background persistence stage. The engine thread enqueues snapshots and CSV rows into a
+// bounded queue; a writer thread does the file I/O (see docs/persistence.md).
+// If the thread cannot be started, jobs run inline on the calling thread.
+typedef struct Writer Writer;
+
+#define WRITER_QUEUE_LIMIT 64  // queued jobs before enqueueing blocks (backpressure)
+#define WRITER_PATH_LEN 128
+#define WRITER_COMPACT_DIVISOR 4 // full roster rewrite once more than 1/4 of the slots are tombstones
+
+// `journal` may be NULL; otherwise it is synced and trimmed by the writer.
+Writer* writer_start(Journal* journal);
+void    writer_stop(Writer* w); // runs the remaining jobs, then joins the thread
+
+// Snapshots the roster and accounting now; the writer saves both in the roster file and then
+// trims the journal up to `mark` (pass NULL to skip the trim). Normally only the roster's dirty records are
+// captured and rewritten in place. A full rewrite (compacting r first) happens when
+// r->needs_rewrite is set, tombstones exceed the compaction threshold, or an earlier
+// incremental save failed; a full checkpoint replaces one still waiting in the queue.
+// 0 ok, -1 out of memory.
+int writer_checkpoint(Writer* w, const char* roster_path, Roster* r, const Accounting* acc, const JournalMark* mark);
+// Records a finished match in the match history and its rows in the player ledger
+// (persist_append_match / persist_append_ledger).
+int writer_append_match(Writer* w, const char* matches_path, const char* ledger_path, const Match* m);
+// Records the refund rows of a cancelled match in the player ledger.
+int writer_append_cancel(Writer* w, const char* ledger_path, const Match* m);
+int writer_append_transaction(Writer* w, const char* path, const char* type, const char* details);
+// One transaction row per line of `rows` (malloc'd details lines, each ending in '\n'), written
+// with a single open of the log. Takes ownership of rows, also on failure.
+int writer_append_transactions(Writer* w, const char* path, const char* type, char* rows, size_t len);
+// Writes and fsyncs the journal. Coalesces with a sync already in the queue.
+int writer_sync_journal(Writer* w);
+
+// Barrier: waits until every job queued so far has run. Returns 0, or the first error
+// (-1) reported by a job since the previous flush.
+int writer_flush(Writer* w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WRITER_H
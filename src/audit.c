@@ -0,0 +1,120 @@
+#include <string.h>
+#include "audit.h"
+#include "bingo.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AUDIT_SSE2 1
+#endif
+
+// The four money fields are adjacent in Player, so each record is two 16-byte loads:
+// [balance, total_recharged] and [total_spent, total_won].
+_Static_assert(offsetof(Player, total_recharged) == offsetof(Player, balance) + sizeof(Money)
+               && offsetof(Player, total_spent) == offsetof(Player, balance) + 2 * sizeof(Money)
+               && offsetof(Player, total_won) == offsetof(Player, balance) + 3 * sizeof(Money),
+               "audit kernel expects balance, total_recharged, total_spent, total_won in a row");
+
+// Exact per-player check: balance + spent == recharged + won and nothing negative. Tombstones
+// are all zero and pass.
+static void check_player(const Player* p, AuditTotals* out) {
+    int bad = p->balance + p->total_spent != p->total_recharged + p->total_won;
+    int neg = p->balance < 0 || p->total_recharged < 0 || p->total_spent < 0 || p->total_won < 0;
+    out->mismatched += bad;
+    out->negative += neg;
+    if ((bad || neg) && out->first_bad_id == 0) out->first_bad_id = p->id;
+}
+
+// Adds the sums of players [0, n) to out and reports whether any of them needs a closer look.
+// The check folds into the sums: t = [balance + spent, recharged + won], and t xor (t with
+// its halves swapped) is zero exactly when the two halves agree. OR-ing that and the raw
+// fields over the chunk leaves a nonzero flag or a set sign bit if any player is off.
+static int sum_chunk(const Player* p, uint32_t n, AuditTotals* out) {
+#ifdef AUDIT_SSE2
+    __m128i br = _mm_setzero_si128(), sw = _mm_setzero_si128();
+    __m128i bad = _mm_setzero_si128(), sign = _mm_setzero_si128();
+    for (uint32_t i = 0; i < n; ++i) {
+        __m128i a = _mm_loadu_si128((const __m128i*)&p[i].balance);
+        __m128i b = _mm_loadu_si128((const __m128i*)&p[i].total_spent);
+        br = _mm_add_epi64(br, a);
+        sw = _mm_add_epi64(sw, b);
+        __m128i t = _mm_add_epi64(a, b);
+        bad = _mm_or_si128(bad, _mm_xor_si128(t, _mm_shuffle_epi32(t, _MM_SHUFFLE(1, 0, 3, 2))));
+        sign = _mm_or_si128(sign, _mm_or_si128(a, b));
+    }
+    Money sums[4];
+    _mm_storeu_si128((__m128i*)&sums[0], br);
+    _mm_storeu_si128((__m128i*)&sums[2], sw);
+    out->balance += sums[0];
+    out->recharged += sums[1];
+    out->spent += sums[2];
+    out->won += sums[3];
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(bad, _mm_setzero_si128())) != 0xffff
+        || _mm_movemask_pd(_mm_castsi128_pd(sign)) != 0;
+#else
+    int flagged = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        out->balance += p[i].balance;
+        out->recharged += p[i].total_recharged;
+        out->spent += p[i].total_spent;
+        out->won += p[i].total_won;
+        flagged |= p[i].balance + p[i].total_spent != p[i].total_recharged + p[i].total_won
+                || (p[i].balance | p[i].total_recharged | p[i].total_spent | p[i].total_won) < 0;
+    }
+    return flagged;
+#endif
+}
+
+int audit_roster(const Roster* r, AuditTotals* out) {
+    memset(out, 0, sizeof(*out));
+    out->players = r->count;
+    for (uint32_t base = 0; base < r->slot_count; base += ROSTER_CHUNK_SIZE) {
+        const Player* p = roster_at(r, base);
+        uint32_t n = r->slot_count - base < ROSTER_CHUNK_SIZE ? r->slot_count - base : ROSTER_CHUNK_SIZE;
+        // a flagged chunk is rare; find the offenders with a scalar pass
+        if (sum_chunk(p, n, out)) for (uint32_t i = 0; i < n; ++i) check_player(&p[i], out);
+    }
+    return out->mismatched || out->negative ? -1 : 0;
+}
+
+// Money outside the players: the saved pot plus every active match's pot.
+static Money pots(const Accounting* acc, const Match* matches, uint32_t match_count) {
+    Money sum = acc->saved_pot;
+    for (uint32_t i = 0; i < match_count; ++i) if (matches[i].active) sum += matches[i].pot;
+    return sum;
+}
+
+int audit_verify(const Roster* r, const Accounting* acc, const Match* matches, uint32_t match_count) {
+    const RosterTotals* t = &r->totals;
+    if (t->balances != t->recharged - t->spent + t->won) return -1;
+    return pots(acc, matches, match_count) == t->spent - t->won + t->retired ? 0 : -1;
+}
+
+int audit_recount(const Roster* r, AuditTotals* out) {
+    int rc = audit_roster(r, out);
+    const RosterTotals* t = &r->totals;
+    if (out->balance != t->balances || out->recharged != t->recharged || out->spent != t->spent || out->won != t->won) rc = -1;
+    return rc;
+}
+
+void audit_rebase(Roster* r, const Accounting* acc, const Match* matches, uint32_t match_count) {
+    AuditTotals sums;
+    audit_roster(r, &sums);
+    r->totals.balances = sums.balance;
+    r->totals.recharged = sums.recharged;
+    r->totals.spent = sums.spent;
+    r->totals.won = sums.won;
+    r->totals.retired = pots(acc, matches, match_count) - (sums.spent - sums.won);
+}
+
+uint32_t audit_book_openings(Roster* r, AuditOpeningFn fn, void* ctx) {
+    uint32_t adjusted = 0;
+    for (uint32_t i = 0; i < r->slot_count; ++i) {
+        Player* p = roster_at(r, i);
+        Money opening = p->balance + p->total_spent - p->total_won - p->total_recharged;
+        if (p->id == 0 || opening == 0) continue;
+        if (fn) fn(ctx, p, opening);
+        p->total_recharged += opening;
+        adjusted++;
+    }
+    return adjusted;
+}
@@ -1,175 +1,627 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // pthread_rwlock_t (platform.h)
+#endif
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "bingo.h"
 #include "config.h"
+#include "leaderboard.h"
+#include "platform.h"
+
+static EngineEventFn EVENT_FN = NULL;
+static void* EVENT_CTX = NULL;
 
 void engine_init(Accounting* acc) {
     cfg_init_defaults();
-    acc->total_bank = 0.0;
-    acc->saved_pot = 0.0;
+    acc->total_bank = 0;
+    acc->saved_pot = 0;
     acc->total_matches = 0;
+    acc->journal_seq = 0;
+    acc->next_match = 1;
+}
+
+void engine_set_event_sink(EngineEventFn fn, void* ctx) {
+    EVENT_FN = fn;
+    EVENT_CTX = ctx;
+}
+
+static void emit(EngineEventType type, uint32_t match_number, uint32_t player_id, uint32_t count, Money amount, int64_t aux) {
+    if (!EVENT_FN) return;
+    EngineEvent ev = {0};
+    ev.type = type;
+    ev.match_number = match_number;
+    ev.player_id = player_id;
+    ev.count = count;
+    ev.amount = amount;
+    ev.aux = aux;
+    EVENT_FN(EVENT_CTX, &ev);
+}
+
+void roster_init(Roster* r) {
+    memset(r, 0, sizeof(*r));
+    r->next_id = 1;
+    r->needs_rewrite = 1; // nothing on disk matches yet
+}
+
+void roster_free(Roster* r) {
+    for (uint32_t c = r->mapped_chunks; c < r->chunk_count; ++c) { free(r->chunks[c]); free(r->name_chunks[c]); }
+    if (r->map) plat_unmap(r->map, r->map_size);
+    free(r->chunks);
+    free(r->name_chunks);
+    free(r->id_slots);
+    free(r->free_slots);
+    free(r->dirty_slots);
+    free(r->dirty_bits);
+    leaderboard_free(r->boards);
+    roster_init(r);
+}
+
+int roster_reserve(Roster* r, uint32_t slots) {
+    if (slots <= r->capacity) return 0;
+    uint32_t need = (uint32_t)(((uint64_t)slots + ROSTER_CHUNK_SIZE - 1) >> ROSTER_CHUNK_SHIFT);
+    // The chunk pointer tables are reallocated on every growth, sized to the current chunk count
+    // doubled until it covers `need` (4 for a new roster); no spare capacity is kept between
+    // calls, so adding players one by one costs one small realloc per new 1024-slot chunk. The
+    // dirty-slot arrays are sized to exactly `need` chunks. Chunks themselves are allocated once
+    // and never move.
+    uint32_t table = r->chunk_count ? r->chunk_count : 4;
+    while (table < need) table *= 2;
+    Player** chunks = (Player**)realloc(r->chunks, (size_t)table * sizeof(Player*));
+    if (!chunks) return -1;
+    r->chunks = chunks;
+    char** name_chunks = (char**)realloc(r->name_chunks, (size_t)table * sizeof(char*));
+    if (!name_chunks) return -1;
+    r->name_chunks = name_chunks;
+    uint64_t* bits = (uint64_t*)realloc(r->dirty_bits, (size_t)need * (ROSTER_CHUNK_SIZE / 64) * sizeof(uint64_t));
+    if (!bits) return -1;
+    memset(bits + (size_t)r->chunk_count * (ROSTER_CHUNK_SIZE / 64), 0, (size_t)(need - r->chunk_count) * (ROSTER_CHUNK_SIZE / 64) * sizeof(uint64_t));
+    r->dirty_bits = bits;
+    // room to list every slot, so marking never allocates (see mark_dirty)
+    uint32_t* dirty = (uint32_t*)realloc(r->dirty_slots, (size_t)need * ROSTER_CHUNK_SIZE * sizeof(uint32_t));
+    if (!dirty) return -1;
+    r->dirty_slots = dirty;
+    r->dirty_capacity = need * ROSTER_CHUNK_SIZE;
+    while (r->chunk_count < need) {
+        Player* chunk = (Player*)malloc(ROSTER_CHUNK_SIZE * sizeof(Player));
+        char* names = (char*)malloc((size_t)ROSTER_CHUNK_SIZE * PLAYER_NAME_LEN);
+        if (!chunk || !names) { free(chunk); free(names); return -1; }
+        r->chunks[r->chunk_count] = chunk;
+        r->name_chunks[r->chunk_count++] = names;
+        r->capacity += ROSTER_CHUNK_SIZE;
+    }
+    return 0;
+}
+
+// Make sure id_slots can hold `id`; grows geometrically so sequential adds stay amortized O(1).
+static int index_reserve(Roster* r, uint32_t id) {
+    if (id < r->id_capacity) return 0;
+    uint32_t cap = r->id_capacity ? r->id_capacity : 64;
+    while (cap <= id) cap *= 2;
+    uint32_t* grown = (uint32_t*)realloc(r->id_slots, (size_t)cap * sizeof(uint32_t));
+    if (!grown) return -1;
+    memset(grown + r->id_capacity, 0, (size_t)(cap - r->id_capacity) * sizeof(uint32_t));
+    r->id_slots = grown;
+    r->id_capacity = cap;
+    return 0;
+}
+
+// Push a tombstoned slot on the free-list.
+static int free_push(Roster* r, uint32_t slot) {
+    if (r->free_count == r->free_capacity) {
+        uint32_t cap = r->free_capacity ? r->free_capacity * 2 : 64;
+        uint32_t* grown = (uint32_t*)realloc(r->free_slots, (size_t)cap * sizeof(uint32_t));
+        if (!grown) return -1;
+        r->free_slots = grown;
+        r->free_capacity = cap;
+    }
+    r->free_slots[r->free_count++] = slot;
+    return 0;
+}
+
+int roster_adopt_chunks(Roster* r, Player** chunks, char** name_chunks, uint32_t n, void* map, size_t map_size) {
+    uint64_t* bits = (uint64_t*)calloc((size_t)n * (ROSTER_CHUNK_SIZE / 64) + 1, sizeof(uint64_t));
+    uint32_t* dirty = (uint32_t*)malloc(((size_t)n * ROSTER_CHUNK_SIZE + 1) * sizeof(uint32_t));
+    if (!bits || !dirty) { free(bits); free(dirty); return -1; }
+    r->dirty_slots = dirty;
+    r->dirty_capacity = n * ROSTER_CHUNK_SIZE;
+    r->chunks = chunks;
+    r->name_chunks = name_chunks;
+    r->chunk_count = n;
+    r->capacity = n * ROSTER_CHUNK_SIZE;
+    r->dirty_bits = bits;
+    r->map = map;
+    r->map_size = map_size;
+    r->mapped_chunks = map ? n : 0;
+    return 0;
+}
+
+// Queue a slot for the next incremental checkpoint. dirty_slots is sized for every slot and
+// both updates are atomic, so threads sharing the engine handle's read lock may mark concurrently.
+static void mark_dirty(Roster* r, uint32_t slot) {
+    uint64_t bit = 1ull << (slot & 63);
+    if (plat_atomic_or64(&r->dirty_bits[slot >> 6], bit) & bit) return;
+    r->dirty_slots[plat_atomic_add32(&r->dirty_count, 1)] = slot;
+}
+
+static void mark_dirty_id(Roster* r, uint32_t player_id) {
+    if (player_id < r->id_capacity && r->id_slots[player_id]) mark_dirty(r, r->id_slots[player_id] - 1);
 }
 
-int engine_add_player(Player* roster, uint32_t* roster_count, const char* name, double initial_balance) {
+void roster_clear_dirty(Roster* r) {
+    for (uint32_t i = 0; i < r->dirty_count; ++i) r->dirty_bits[r->dirty_slots[i] >> 6] &= ~(1ull << (r->dirty_slots[i] & 63));
+    r->dirty_count = 0;
+}
+
+int roster_reindex(Roster* r) {
+    if (r->id_slots) memset(r->id_slots, 0, (size_t)r->id_capacity * sizeof(uint32_t));
+    r->count = 0;
+    r->free_count = 0;
+    for (uint32_t i = 0; i < r->slot_count; ++i) {
+        uint32_t id = roster_at(r, i)->id;
+        if (id == 0) {
+            if (free_push(r, i) != 0) return -1;
+            continue;
+        }
+        if (index_reserve(r, id) != 0) return -1;
+        r->id_slots[id] = i + 1;
+        r->count++;
+        if (id >= r->next_id) r->next_id = id + 1;
+    }
+    return 0;
+}
+
+void roster_compact(Roster* r) {
+    uint32_t live = 0;
+    for (uint32_t i = 0; i < r->slot_count; ++i) {
+        Player* src = roster_at(r, i);
+        if (src->id == 0) continue;
+        if (live != i) {
+            *roster_at(r, live) = *src;
+            memcpy(roster_name_at(r, live), roster_name_at(r, i), PLAYER_NAME_LEN);
+            r->id_slots[src->id] = live + 1;
+        }
+        live++;
+    }
+    r->slot_count = live;
+    r->free_count = 0;
+    // every moved slot differs from the file now
+    roster_clear_dirty(r);
+    r->needs_rewrite = 1;
+}
+
+int roster_copy(Roster* dst, const Roster* src) {
+    if (roster_reserve(dst, src->count) != 0) return -1;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < src->slot_count; ++i) {
+        const Player* p = roster_at(src, i);
+        if (p->id == 0) continue;
+        *roster_at(dst, n) = *p;
+        memcpy(roster_name_at(dst, n), roster_name_at(src, i), PLAYER_NAME_LEN);
+        n++;
+    }
+    dst->slot_count = dst->count = n;
+    dst->next_id = src->next_id;
+    return 0;
+}
+
+int engine_add_player(Roster* r, const char* name, Money initial_balance) {
     uint32_t maxp = cfg_get_max_players();
-    if (*roster_count >= maxp) return -1;
-    uint32_t id = *roster_count ? roster[*roster_count - 1].id + 1 : 1;
+    if (r->count >= maxp) return -1;
+    // reuse a tombstoned slot before growing; IDs never follow slot position
+    uint32_t slot = r->free_count ? r->free_slots[r->free_count - 1] : r->slot_count;
+    if (roster_reserve(r, slot + 1) != 0) return -1;
+    uint32_t id = r->next_id;
+    if (index_reserve(r, id) != 0) return -1;
+    if (r->boards && leaderboard_reserve(r->boards, id) != 0) return -1;
+    if (r->free_count) r->free_count--;
+    else r->slot_count++;
     Player p = {0};
     p.id = id;
-    strncpy(p.name, name ? name : "Player", sizeof(p.name) - 1);
-    p.name[sizeof(p.name) - 1] = '\0';
     p.balance = initial_balance;
+    p.total_recharged = initial_balance; // the opening deposit, so balance == recharged - spent + won
+    r->totals.balances += initial_balance;
+    r->totals.recharged += initial_balance;
     p.record.wins = p.record.losses = p.record.draws = 0;
     p.cards_owned = 0;
     p.lifetime_cards = 0;
-    roster[*roster_count] = p;
-    (*roster_count)++;
+    *roster_at(r, slot) = p;
+    char* dst_name = roster_name_at(r, slot);
+    strncpy(dst_name, name ? name : "Player", PLAYER_NAME_LEN - 1);
+    dst_name[PLAYER_NAME_LEN - 1] = '\0';
+    r->id_slots[id] = slot + 1;
+    r->next_id++;
+    r->count++;
+    mark_dirty(r, slot);
+    if (r->boards) leaderboard_insert(r->boards, roster_at(r, slot));
+    if (EVENT_FN) {
+        EngineEvent ev = {0};
+        ev.type = EV_PLAYER_ADD;
+        ev.player_id = id;
+        ev.amount = initial_balance;
+        ev.name = dst_name;
+        EVENT_FN(EVENT_CTX, &ev);
+    }
     return (int)id;
 }
 
-int engine_remove_player(Player* roster, uint32_t* roster_count, uint32_t player_id) {
-    for (uint32_t i = 0; i < *roster_count; ++i) {
-        if (roster[i].id == player_id) {
-            // compact
-            for (uint32_t j = i + 1; j < *roster_count; ++j) roster[j - 1] = roster[j];
-            (*roster_count)--;
-            return 0;
-        }
-    }
-    return -1;
+int engine_remove_player(Roster* r, uint32_t player_id) {
+    if (player_id >= r->id_capacity || r->id_slots[player_id] == 0) return -1;
+    uint32_t slot = r->id_slots[player_id] - 1;
+    if (free_push(r, slot) != 0) return -1;
+    // the balance leaves with the player; their net stake stays in the pots
+    Player* p = roster_at(r, slot);
+    r->totals.balances -= p->balance;
+    r->totals.recharged -= p->total_recharged;
+    r->totals.spent -= p->total_spent;
+    r->totals.won -= p->total_won;
+    r->totals.retired += p->total_spent - p->total_won;
+    if (r->boards) leaderboard_remove(r->boards, player_id);
+    // tombstone in place; compaction happens on save (roster_compact)
+    memset(p, 0, sizeof(Player));
+    roster_name_at(r, slot)[0] = '\0';
+    mark_dirty(r, slot);
+    r->id_slots[player_id] = 0;
+    r->count--;
+    emit(EV_PLAYER_REMOVE, 0, player_id, 0, 0, 0);
+    return 0;
 }
 
-Player* engine_find_player(Player* roster, uint32_t roster_count, uint32_t player_id) {
-    for (uint32_t i = 0; i < roster_count; ++i) if (roster[i].id == player_id) return &roster[i];
-    return NULL;
+Player* engine_find_player(Roster* r, uint32_t player_id) {
+    if (player_id >= r->id_capacity) return NULL;
+    uint32_t slot = r->id_slots[player_id];
+    return slot ? roster_at(r, slot - 1) : NULL;
 }
 
-void match_start(Match* m, GameMode mode, double card_cost) {
+int engine_recharge_player(Roster* r, uint32_t player_id, Money amount) {
+    if (amount <= 0) return -2;
+    Player* p = engine_find_player(r, player_id);
+    if (!p) return -1;
+    // atomic: sellers may be reserving from this balance at the same time
+    plat_atomic_add64(&p->balance, amount);
+    plat_atomic_add64(&p->total_recharged, amount);
+    plat_atomic_add64(&r->totals.balances, amount);
+    plat_atomic_add64(&r->totals.recharged, amount);
+    mark_dirty_id(r, player_id);
+    emit(EV_RECHARGE, 0, player_id, 0, amount, 0);
+    return 0;
+}
+
+const char* engine_player_name(const Roster* r, uint32_t player_id) {
+    if (player_id >= r->id_capacity) return NULL;
+    uint32_t slot = r->id_slots[player_id];
+    return slot ? roster_name_at(r, slot - 1) : NULL;
+}
+
+static uint32_t ledger_hash(uint32_t player_id) {
+    return player_id * 2654435761u; // Knuth multiplicative hash; IDs are sequential
+}
+
+static void ledger_clear(Match* m) {
+    m->entry_count = 0;
+    if (m->entry_slots) memset(m->entry_slots, 0, ((size_t)m->entry_slot_mask + 1) * sizeof(uint32_t));
+}
+
+// Slot in entry_slots that holds player_id, or the empty slot where it would go.
+static uint32_t ledger_probe(const Match* m, uint32_t player_id) {
+    uint32_t i = ledger_hash(player_id) & m->entry_slot_mask;
+    while (m->entry_slots[i] && m->entries[m->entry_slots[i] - 1].player_id != player_id) i = (i + 1) & m->entry_slot_mask;
+    return i;
+}
+
+// Grow entries (and keep the table at most half full) before appending `extra` more entries.
+static int ledger_reserve(Match* m, uint32_t extra) {
+    if (extra <= m->entry_capacity - m->entry_count) return 0;
+    uint32_t cap = m->entry_capacity ? m->entry_capacity : 16;
+    do {
+        if (cap > UINT32_MAX / 4) return -1;
+        cap *= 2;
+    } while (extra > cap - m->entry_count);
+    MatchEntry* entries = (MatchEntry*)realloc(m->entries, (size_t)cap * sizeof(MatchEntry));
+    if (!entries) return -1;
+    m->entries = entries;
+    uint32_t* slots = (uint32_t*)calloc((size_t)cap * 2, sizeof(uint32_t));
+    if (!slots) return -1;
+    free(m->entry_slots);
+    m->entry_slots = slots;
+    m->entry_slot_mask = cap * 2 - 1;
+    m->entry_capacity = cap;
+    for (uint32_t e = 0; e < m->entry_count; ++e) m->entry_slots[ledger_probe(m, m->entries[e].player_id)] = e + 1;
+    return 0;
+}
+
+const MatchEntry* match_find_entry(const Match* m, uint32_t player_id) {
+    if (!m->entry_slots) return NULL;
+    uint32_t e = m->entry_slots[ledger_probe(m, player_id)];
+    return e ? &m->entries[e - 1] : NULL;
+}
+
+// The player's ledger row, appended with no cards if missing. NULL if the ledger could not grow.
+static MatchEntry* ledger_entry(Match* m, uint32_t player_id) {
+    MatchEntry* entry = (MatchEntry*)match_find_entry(m, player_id);
+    if (entry) return entry;
+    if (ledger_reserve(m, 1) != 0) return NULL;
+    entry = &m->entries[m->entry_count];
+    entry->player_id = player_id;
+    entry->cards = 0;
+    entry->winner_pos = 0;
+    m->entry_slots[ledger_probe(m, player_id)] = ++m->entry_count;
+    return entry;
+}
+
+void match_release(Match* m) {
+    free(m->entries);
+    free(m->entry_slots);
+    m->entries = NULL;
+    m->entry_slots = NULL;
+    m->entry_count = m->entry_capacity = m->entry_slot_mask = 0;
+}
+
+void match_start(Match* m, GameMode mode, Money card_cost) {
+    // one snapshot for every rule, so a concurrent settings change cannot mix old and new values
+    const ConfigSnapshot* cfg = cfg_snapshot();
     m->mode = mode;
-    m->card_cost = card_cost > 0.0 ? card_cost : (mode == GAME_FULL_HOUSE ? cfg_get_fullhouse_card_cost() : cfg_get_normal_card_cost());
-    m->pot = 0.0;
-    m->saved_for_fullhouse = 0.0;
+    m->rules = *cfg;
+    m->card_cost = card_cost > 0 ? card_cost : (mode == GAME_FULL_HOUSE ? cfg->fullhouse_card_cost : cfg->normal_card_cost);
+    m->pot = 0;
+    m->saved_for_fullhouse = 0;
+    m->paid_out = 0;
     m->winner_count = 0;
+    ledger_clear(m);
     m->active = 1;
+    if (EVENT_FN) {
+        EngineEvent ev = {0};
+        ev.type = EV_MATCH_START;
+        ev.match_number = m->match_number;
+        ev.count = (uint32_t)mode;
+        ev.amount = m->card_cost;
+        ev.aux = m->rules.saved_pot_bp;
+        ev.flags = m->rules.allow_multi_winners | (m->hall << 8);
+        EVENT_FN(EVENT_CTX, &ev);
+    }
 }
 
-void match_buy_cards(Match* m, Player* p, uint32_t count) {
-    if (!m->active || count == 0) return;
-    double cost = m->card_cost * (double)count;
+void roster_book_purchase(Roster* r, Money amount) {
+    plat_atomic_add64(&r->totals.balances, -amount);
+    plat_atomic_add64(&r->totals.spent, amount);
+}
+
+int match_buy_cards(Match* m, Roster* r, Player* p, uint32_t count) {
+    if (!m->active || count == 0) return -1;
+    MatchEntry* entry = ledger_entry(m, p->id);
+    if (!entry) return -2;
+    Money cost = m->card_cost * (Money)count;
     // player pays cost, pot increases
     p->balance -= cost;
     p->cards_owned += count;
     p->lifetime_cards += count;
     p->total_spent += cost;
+    entry->cards += count;
     m->pot += cost;
+    roster_book_purchase(r, cost);
+    if (r->boards) leaderboard_update(r->boards, p);
+    emit(EV_BUY, m->match_number, p->id, count, cost, 0);
+    return 0;
 }
 
-int match_add_winner(Match* m, Player* roster, uint32_t roster_count, uint32_t player_id) {
+int match_buy_cards_batch(Match* m, Roster* r, const MatchPurchase* items, uint32_t n, int* status) {
     if (!m->active) return -1;
-    if (m->mode != GAME_FULL_HOUSE && !cfg_get_allow_multi_winners() && m->winner_count > 0) return -2;
+    // room for every line up front, so nothing below can fail half-way through
+    if (ledger_reserve(m, n) != 0) return -2;
+    Money total = 0;
+    int bought = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        uint32_t count = items[i].count;
+        Player* p = count ? engine_find_player(r, items[i].player_id) : NULL;
+        Money cost = m->card_cost * (Money)count;
+        int rc = count == 0 ? -1 : !p ? -3 : p->balance < cost ? -4 : 0;
+        status[i] = rc;
+        if (rc != 0) continue;
+        // a player listed twice is checked against what the earlier line left
+        p->balance -= cost;
+        p->cards_owned += count;
+        p->lifetime_cards += count;
+        p->total_spent += cost;
+        ledger_entry(m, p->id)->cards += count;
+        if (r->boards) leaderboard_update(r->boards, p);
+        total += cost;
+        bought++;
+        emit(EV_BUY, m->match_number, p->id, count, cost, 0);
+    }
+    m->pot += total;
+    roster_book_purchase(r, total);
+    return bought;
+}
+
+int player_reserve_cards(Player* p, uint32_t count, Money cost) {
+    Money balance = plat_atomic_load64(&p->balance);
+    do {
+        if (balance < cost) return -1;
+    } while (!plat_atomic_cas64(&p->balance, &balance, balance - cost));
+    plat_atomic_add64(&p->total_spent, cost);
+    plat_atomic_add32(&p->cards_owned, count);
+    plat_atomic_add32(&p->lifetime_cards, count);
+    return 0;
+}
+
+void player_unreserve_cards(Player* p, uint32_t count, Money cost) {
+    plat_atomic_add64(&p->balance, cost);
+    plat_atomic_add64(&p->total_spent, -cost);
+    plat_atomic_add32(&p->cards_owned, (uint32_t)-count);
+    plat_atomic_add32(&p->lifetime_cards, (uint32_t)-count);
+}
+
+int match_record_purchase(Match* m, uint32_t player_id, uint32_t count, Money cost) {
+    MatchEntry* entry = ledger_entry(m, player_id);
+    if (!entry) return -2;
+    entry->cards += count;
+    m->pot += cost;
+    emit(EV_BUY, m->match_number, player_id, count, cost, 0);
+    return 0;
+}
+
+int match_merge(Match* dst, Match* src) {
+    uint32_t e = 0;
+    for (; e < src->entry_count; ++e) {
+        MatchEntry* entry = ledger_entry(dst, src->entries[e].player_id);
+        if (!entry) break;
+        // every sale was recorded at the match's card cost
+        Money cost = dst->card_cost * (Money)src->entries[e].cards;
+        entry->cards += src->entries[e].cards;
+        dst->pot += cost;
+        src->pot -= cost;
+    }
+    if (e == src->entry_count) {
+        ledger_clear(src);
+        return 0;
+    }
+    // keep the rows not moved, re-indexed
+    memmove(src->entries, src->entries + e, (size_t)(src->entry_count - e) * sizeof(MatchEntry));
+    src->entry_count -= e;
+    memset(src->entry_slots, 0, ((size_t)src->entry_slot_mask + 1) * sizeof(uint32_t));
+    for (e = 0; e < src->entry_count; ++e) src->entry_slots[ledger_probe(src, src->entries[e].player_id)] = e + 1;
+    return -2;
+}
+
+int match_add_winner(Match* m, Roster* r, uint32_t player_id) {
+    if (!m->active) return -1;
+    if (m->mode != GAME_FULL_HOUSE && !m->rules.allow_multi_winners && m->winner_count > 0) return -2;
     if (m->winner_count >= sizeof(m->winners)/sizeof(m->winners[0])) return -3;
-    // duplicate check
-    for (uint32_t i = 0; i < m->winner_count; ++i) if (m->winners[i] == player_id) return -6;
-    Player* p = engine_find_player(roster, roster_count, player_id);
+    // winners must be buyers, so membership lives on the ledger entry
+    MatchEntry* entry = (MatchEntry*)match_find_entry(m, player_id);
+    if (entry && entry->winner_pos) return -6; // duplicate
+    Player* p = engine_find_player(r, player_id);
     if (!p) return -4;
-    if (p->cards_owned == 0) return -5; // did not participate
+    if (!entry) return -5; // did not participate
     m->winners[m->winner_count++] = player_id;
+    entry->winner_pos = m->winner_count;
+    emit(EV_WINNER_ADD, m->match_number, player_id, 0, 0, 0);
     return 0;
 }
 
 int match_remove_winner(Match* m, uint32_t player_id) {
     if (!m->active) return -1;
-    for (uint32_t i = 0; i < m->winner_count; ++i) {
-        if (m->winners[i] == player_id) {
-            for (uint32_t j = i + 1; j < m->winner_count; ++j) m->winners[j - 1] = m->winners[j];
-            m->winner_count--;
-            return 0;
-        }
+    MatchEntry* entry = (MatchEntry*)match_find_entry(m, player_id);
+    if (!entry || !entry->winner_pos) return -1;
+    // swap the last winner into the freed position
+    uint32_t pos = entry->winner_pos - 1;
+    uint32_t last = m->winners[--m->winner_count];
+    if (pos != m->winner_count) {
+        m->winners[pos] = last;
+        ((MatchEntry*)match_find_entry(m, last))->winner_pos = pos + 1;
     }
-    return -1;
+    entry->winner_pos = 0;
+    emit(EV_WINNER_REMOVE, m->match_number, player_id, 0, 0, 0);
+    return 0;
 }
 
-void apply_payouts_normal(Match* m, Player* roster, uint32_t roster_count) {
-    // Save a percentage for final full house
-    double save_pct = cfg_get_saved_pot_percentage();
-    double to_save = m->pot * save_pct;
-    double distributable = m->pot - to_save;
-    if (m->winner_count == 0) return; // draw (no payout)
-    double per_winner = distributable / (double)m->winner_count;
-    for (uint32_t i = 0; i < m->winner_count; ++i) {
-        Player* p = engine_find_player(roster, roster_count, m->winners[i]);
-        if (p) {
-            p->balance += per_winner;
-            p->record.wins++;
-            p->total_won += per_winner;
-        }
+// cards_owned spans every match the player is in (one per hall), so a finished match
+// returns only its own cards.
+static void release_cards(Player* p, uint32_t cards) {
+    p->cards_owned = p->cards_owned > cards ? p->cards_owned - cards : 0;
+}
+
+// Pays a winner's share. A share owed to a removed player is paid to no one.
+static void pay_winner(Match* m, Roster* r, uint32_t player_id, Money share) {
+    Player* p = engine_find_player(r, player_id);
+    if (!p) { r->totals.retired -= share; return; }
+    p->balance += share;
+    p->record.wins++;
+    p->total_won += share;
+    r->totals.balances += share;
+    r->totals.won += share;
+    if (r->boards) leaderboard_update(r->boards, p);
+    emit(EV_PAYOUT, m->match_number, p->id, 0, share, 0);
+}
+
+// Every ledger entry without a winner position bought cards and lost.
+static void mark_losses(Match* m, Roster* r) {
+    for (uint32_t e = 0; e < m->entry_count; ++e) {
+        if (m->entries[e].winner_pos) continue;
+        Player* p = engine_find_player(r, m->entries[e].player_id);
+        if (p) p->record.losses++;
     }
+}
+
+Money match_saved_share(const Match* m) {
+    if (m->mode == GAME_FULL_HOUSE) return 0;
+    // rounded down: the odd cents stay with the winners
+    return m->pot * (Money)m->rules.saved_pot_bp / MONEY_BP_SCALE;
+}
+
+void apply_payouts_normal(Match* m, Roster* r) {
+    // Save a percentage for final full house
+    Money to_save = match_saved_share(m);
+    Money distributable = m->pot - to_save;
+    if (m->winner_count == 0) { r->totals.retired -= m->pot; return; } // draw (no payout, nothing saved)
+    for (uint32_t i = 0; i < m->winner_count; ++i) pay_winner(m, r, m->winners[i], money_share(distributable, m->winner_count, i));
     // losers increment losses, winners handled above; draws handled elsewhere
-    for (uint32_t i = 0; i < roster_count; ++i) {
-        int is_winner = 0;
-        for (uint32_t w = 0; w < m->winner_count; ++w) if (roster[i].id == m->winners[w]) { is_winner = 1; break; }
-        if (!is_winner) {
-            // only consider players who purchased cards this match
-            if (roster[i].cards_owned > 0) roster[i].record.losses++;
-        }
-    }
+    mark_losses(m, r);
     m->saved_for_fullhouse = to_save;
+    m->paid_out = distributable;
 }
 
-void apply_payouts_fullhouse(Accounting* acc, Match* m, Player* roster, uint32_t roster_count, uint32_t* winners, uint32_t winner_count) {
-    if (winner_count == 0) return;
+void apply_payouts_fullhouse(Accounting* acc, Match* m, Roster* r) {
+    uint32_t* winners = m->winners;
+    uint32_t winner_count = m->winner_count;
+    if (winner_count == 0) { r->totals.retired -= m->pot; return; } // the saved pot waits for the next one
     // Distribute both accumulated saved pot and current full house match pot
-    double total_distributable = acc->saved_pot + m->pot;
-    double per_winner = total_distributable / (double)winner_count;
-    for (uint32_t i = 0; i < winner_count; ++i) {
-        Player* p = engine_find_player(roster, roster_count, winners[i]);
-        if (p) {
-            p->balance += per_winner;
-            p->record.wins++;
-            p->total_won += per_winner;
-        }
-    }
+    Money total_distributable = acc->saved_pot + m->pot;
+    for (uint32_t i = 0; i < winner_count; ++i) pay_winner(m, r, winners[i], money_share(total_distributable, winner_count, i));
     // Mark losses for participants who are not winners
-    for (uint32_t i = 0; i < roster_count; ++i) {
-        int is_winner = 0;
-        for (uint32_t w = 0; w < winner_count; ++w) if (roster[i].id == winners[w]) { is_winner = 1; break; }
-        if (!is_winner && roster[i].cards_owned > 0) roster[i].record.losses++;
-    }
+    mark_losses(m, r);
+    m->paid_out = total_distributable;
     // Clear saved pot and match pot after distribution
-    acc->saved_pot = 0.0;
-    m->pot = 0.0;
+    acc->saved_pot = 0;
+    m->pot = 0;
 }
 
-void match_end(Match* m, Accounting* acc, Player* roster, uint32_t roster_count) {
+void match_end(Match* m, Accounting* acc, Roster* r) {
     if (!m->active) return;
+    Money pot = m->pot; // full house payouts clear m->pot
     if (m->mode == GAME_FULL_HOUSE) {
         // Winners get saved pot + current match pot
-        apply_payouts_fullhouse(acc, m, roster, roster_count, m->winners, m->winner_count);
+        apply_payouts_fullhouse(acc, m, r);
     } else {
-        apply_payouts_normal(m, roster, roster_count);
+        apply_payouts_normal(m, r);
         acc->saved_pot += m->saved_for_fullhouse;
     }
-    // reset per-match player state
-    for (uint32_t i = 0; i < roster_count; ++i) roster[i].cards_owned = 0;
+    // reset per-match player state; the ledger itself is kept for reporting until the next match_start.
+    // Buys, payouts and losses only touch ledger players, so this marks every changed slot and
+    // brings the leaderboards up to date with sales made through sellers (player_reserve_cards).
+    for (uint32_t e = 0; e < m->entry_count; ++e) {
+        Player* p = engine_find_player(r, m->entries[e].player_id);
+        if (p) release_cards(p, m->entries[e].cards);
+        if (p && r->boards) leaderboard_update(r->boards, p);
+        mark_dirty_id(r, m->entries[e].player_id);
+    }
     m->active = 0;
     acc->total_matches++;
+    emit(EV_MATCH_END, m->match_number, 0, 0, pot, m->saved_for_fullhouse);
 }
 
-void match_cancel(Match* m, Player* roster, uint32_t roster_count) {
+void match_cancel(Match* m, Roster* r) {
     if (!m->active) return;
-    // Refund purchases: each player's cards_owned * card_cost back to balance
-    for (uint32_t i = 0; i < roster_count; ++i) {
-        if (roster[i].cards_owned > 0) {
-            double refund = (double)roster[i].cards_owned * m->card_cost;
-            roster[i].balance += refund;
-            // Adjust total_spent, since cancellation negates spend
-            roster[i].total_spent -= refund;
-            roster[i].cards_owned = 0;
-        }
+    // Refund purchases: each buyer's ledger cards * card_cost back to balance
+    for (uint32_t e = 0; e < m->entry_count; ++e) {
+        m->entries[e].winner_pos = 0; // nobody won
+        Player* p = engine_find_player(r, m->entries[e].player_id);
+        Money refund = (Money)m->entries[e].cards * m->card_cost;
+        if (!p) { r->totals.retired -= refund; continue; } // removed since buying: nobody to refund
+        p->balance += refund;
+        // Adjust total_spent, since cancellation negates spend
+        p->total_spent -= refund;
+        r->totals.balances += refund;
+        r->totals.spent -= refund;
+        release_cards(p, m->entries[e].cards);
+        if (r->boards) leaderboard_update(r->boards, p);
+        mark_dirty_id(r, m->entries[e].player_id);
     }
-    // Reset match
-    m->pot = 0.0;
-    m->saved_for_fullhouse = 0.0;
+    emit(EV_MATCH_CANCEL, m->match_number, 0, 0, m->pot, 0);
+    // Reset match; as after match_end, the ledger is kept for reporting (the refund rows)
+    // until the next match_start
+    m->pot = 0;
+    m->saved_for_fullhouse = 0;
     m->winner_count = 0;
     m->active = 0;
 }
@@ -0,0 +1,477 @@
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "command.h"
+#include "bingo.h"
+#include "audit.h"
+#include "leaderboard.h"
+#include "persist.h"
+
+#define MAX_ARGS 4
+#define TOP_DEFAULT_K 10 // players listed by `top` without a count
+
+// Splits line in place on spaces/tabs; returns the token count (extra tokens are counted, not stored).
+static int tokenize(char* line, char** argv) {
+    int argc = 0;
+    char* p = line;
+    for (;;) {
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+        if (*p == '\0' || *p == '#') break;
+        char* start = p;
+        while (*p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+        if (argc < MAX_ARGS) argv[argc] = start;
+        argc++;
+        if (*p == '\0') break;
+        *p++ = '\0';
+    }
+    return argc;
+}
+
+static int parse_u32(const char* s, uint32_t* out) {
+    if (*s < '0' || *s > '9') return -1; // strtoul would accept a sign or spaces
+    errno = 0;
+    char* end;
+    unsigned long v = strtoul(s, &end, 10);
+    if (*end || errno || v > UINT32_MAX) return -1;
+    *out = (uint32_t)v;
+    return 0;
+}
+
+// Amount in units ("2.5"), rounded to cents.
+static int parse_money(const char* s, Money* out) {
+    errno = 0;
+    char* end;
+    double v = strtod(s, &end);
+    if (end == s || *end || errno || !isfinite(v) || v > 1e15 || v < -1e15) return -1; // keeps sums of cents far from int64 overflow
+    *out = money_from_units(v);
+    return 0;
+}
+
+static int fail(FILE* out, const char* reason) {
+    fprintf(out, "err %s\n", reason);
+    return -1;
+}
+
+static const char* winner_error(int rc) {
+    switch (rc) {
+        case -1: return "no_match";
+        case -2: return "single_winner";
+        case -3: return "winners_full";
+        case -4: return "not_found";
+        case -5: return "no_cards";
+        case -6: return "duplicate_winner";
+        default: return "winner";
+    }
+}
+
+static int cmd_start(Session* s, int argc, char** argv, FILE* out) {
+    if (argc < 2 || argc > 3) return fail(out, "usage start <normal|fullhouse> [cost]");
+    if (s->match.active) return fail(out, "match_active");
+    GameMode mode;
+    if (strcmp(argv[1], "normal") == 0 || strcmp(argv[1], "1") == 0) mode = GAME_NORMAL;
+    else if (strcmp(argv[1], "fullhouse") == 0 || strcmp(argv[1], "2") == 0) mode = GAME_FULL_HOUSE;
+    else return fail(out, "usage start <normal|fullhouse> [cost]");
+    Money cost = 0; // 0 = configured cost for the mode
+    if (argc == 3 && (parse_money(argv[2], &cost) != 0 || cost < 0)) return fail(out, "amount");
+    s->match.match_number = s->acc.next_match++;
+    match_start(&s->match, mode, cost);
+    fprintf(out, "ok %u %.2f\n", s->match.match_number, money_units(s->match.card_cost));
+    return 0;
+}
+
+static int cmd_buy(Session* s, int argc, char** argv, FILE* out) {
+    uint32_t id, count;
+    if (argc != 3 || parse_u32(argv[1], &id) != 0 || parse_u32(argv[2], &count) != 0 || count == 0)
+        return fail(out, "usage buy <id> <count>");
+    if (!s->match.active) return fail(out, "no_match");
+    Player* p = engine_find_player(&s->roster, id);
+    if (!p) return fail(out, "not_found");
+    Money total_cost = s->match.card_cost * (Money)count;
+    if (p->balance < total_cost) return fail(out, "balance");
+    if (match_buy_cards(&s->match, &s->roster, p, count) != 0) return fail(out, "oom");
+    char details[128];
+    snprintf(details, sizeof(details), "buy,id=%u,count=%u,cost=%.2f", id, count, money_units(total_cost));
+    session_log(s, "buy", details);
+    fprintf(out, "ok %.2f %.2f\n", money_units(p->balance), money_units(s->match.pot));
+    return 0;
+}
+
+static int cmd_end(Session* s, int argc, FILE* out) {
+    if (argc != 1) return fail(out, "usage end");
+    if (!s->match.active) return fail(out, "no_match");
+    if (s->match.entry_count > 0 && s->match.winner_count == 0) return fail(out, "no_winner");
+    Money pot = s->match.pot; // a full house payout clears it
+    match_end(&s->match, &s->acc, &s->roster);
+    if (session_verify(s) != 0) fprintf(stderr, "audit: books do not balance after match %u\n", s->match.match_number);
+    session_record_match(s);
+    session_checkpoint(s);
+    fprintf(out, "ok %u %.2f %.2f %.2f\n", s->match.match_number, money_units(pot), money_units(s->acc.saved_pot), money_units(s->match.paid_out));
+    return 0;
+}
+
+// Malformed rows of an import: the first is reported back, all are counted.
+typedef struct {
+    uint64_t first_line;
+    uint64_t rows;
+} ImportErrors;
+
+static void import_error(void* ctx, uint64_t line, const char* reason) {
+    ImportErrors* e = (ImportErrors*)ctx;
+    (void)reason;
+    if (e->rows++ == 0) e->first_line = line;
+}
+
+static int cmd_import(Session* s, int argc, char** argv, FILE* out) {
+    if (argc != 2) return fail(out, "usage import <csv>");
+    ImportErrors errors = {0, 0};
+    uint32_t first = 0;
+    int added = session_import_players(s, argv[1], import_error, &errors, &first);
+    if (added == -1) return fail(out, "io");
+    if (added == -2) {
+        fprintf(out, "err malformed %llu %llu\n", (unsigned long long)errors.first_line, (unsigned long long)errors.rows);
+        return -1;
+    }
+    if (added == -3) return fail(out, "max_players");
+    if (added < 0) return fail(out, "oom");
+    fprintf(out, "ok %d %u\n", added, first);
+    return 0;
+}
+
+static int parse_time(const char* s, int64_t* out) {
+    if ((*s < '0' || *s > '9') && *s != '-') return -1;
+    errno = 0;
+    char* end;
+    long long v = strtoll(s, &end, 10);
+    if (*end || errno) return -1;
+    *out = (int64_t)v;
+    return 0;
+}
+
+// The history as written so far, queued matches included. NULL after replying with the error.
+static MatchHistory* open_history(Session* s, FILE* out) {
+    if (writer_flush(s->writer) != 0) { fail(out, "io"); return NULL; }
+    MatchHistory* h = persist_history_open(SESSION_MATCHES_PATH);
+    if (!h) fail(out, "io");
+    return h;
+}
+
+static int cmd_history(Session* s, int argc, char** argv, FILE* out) {
+    uint32_t number;
+    if (argc != 2 || parse_u32(argv[1], &number) != 0) return fail(out, "usage history <match>");
+    MatchHistory* h = open_history(s, out);
+    if (!h) return -1;
+    HistoryMatch m;
+    int rc = persist_history_find(h, number, &m);
+    persist_history_close(h);
+    if (rc != 0) return fail(out, rc == -1 ? "not_found" : "io");
+    fprintf(out, "ok %u %u %lld %.2f %.2f %.2f %.2f %u %u %u", m.match_number, m.mode, (long long)m.ended_at, money_units(m.card_cost),
+            money_units(m.pot), money_units(m.saved), money_units(m.paid), m.buyers, m.cards, m.winner_count);
+    for (uint32_t i = 0; i < m.winner_count; ++i) fprintf(out, " %u", m.winners[i]);
+    fputc('\n', out);
+    return 0;
+}
+
+// Wins collected before replying, so a read error part-way still answers with one `err` line.
+typedef struct {
+    uint32_t player_id;
+    uint32_t count, cap;
+    uint32_t* matches;
+    Money* shares;
+    int oom;
+} WinsReply;
+
+static int collect_win(void* ctx, const HistoryMatch* m) {
+    WinsReply* w = (WinsReply*)ctx;
+    if (w->count == w->cap) {
+        uint32_t cap = w->cap ? w->cap * 2 : 64;
+        uint32_t* matches = (uint32_t*)realloc(w->matches, sizeof(uint32_t) * cap);
+        if (matches) w->matches = matches;
+        Money* shares = (Money*)realloc(w->shares, sizeof(Money) * cap);
+        if (shares) w->shares = shares;
+        if (!matches || !shares) { w->oom = 1; return 1; }
+        w->cap = cap;
+    }
+    uint32_t i = 0;
+    while (m->winners[i] != w->player_id) i++;
+    w->matches[w->count] = m->match_number;
+    w->shares[w->count++] = money_share(m->paid, m->winner_count, i);
+    return 0;
+}
+
+static int cmd_wins(Session* s, int argc, char** argv, FILE* out) {
+    uint32_t id;
+    int64_t from = INT64_MIN, to = INT64_MAX;
+    if ((argc != 2 && argc != 4) || parse_u32(argv[1], &id) != 0 || (argc == 4 && (parse_time(argv[2], &from) != 0 || parse_time(argv[3], &to) != 0)))
+        return fail(out, "usage wins <id> [from to]");
+    MatchHistory* h = open_history(s, out);
+    if (!h) return -1;
+    WinsReply w = {id, 0, 0, NULL, NULL, 0};
+    int rc = persist_history_player_wins(h, id, from, to, collect_win, &w);
+    persist_history_close(h);
+    if (rc < 0 || w.oom) rc = fail(out, w.oom ? "oom" : "io");
+    else {
+        fprintf(out, "ok %u", w.count);
+        for (uint32_t i = 0; i < w.count; ++i) fprintf(out, " %u:%.2f", w.matches[i], money_units(w.shares[i]));
+        fputc('\n', out);
+        rc = 0;
+    }
+    free(w.matches);
+    free(w.shares);
+    return rc;
+}
+
+// The player ledger as written so far, queued rows included. NULL after replying with the error.
+static PlayerLedger* open_ledger(Session* s, FILE* out) {
+    if (writer_flush(s->writer) != 0) { fail(out, "io"); return NULL; }
+    PlayerLedger* l = persist_ledger_open(SESSION_LEDGER_PATH);
+    if (!l) fail(out, "io");
+    return l;
+}
+
+// Statement rows collected before replying, like WinsReply.
+typedef struct {
+    LedgerRow* rows;
+    uint32_t count, cap;
+    int oom;
+} StatementReply;
+
+static int collect_row(void* ctx, const LedgerRow* row) {
+    StatementReply* st = (StatementReply*)ctx;
+    if (st->count == st->cap) {
+        uint32_t cap = st->cap ? st->cap * 2 : 64;
+        LedgerRow* rows = (LedgerRow*)realloc(st->rows, sizeof(LedgerRow) * cap);
+        if (!rows) { st->oom = 1; return 1; }
+        st->rows = rows;
+        st->cap = cap;
+    }
+    st->rows[st->count++] = *row;
+    return 0;
+}
+
+static int cmd_statement(Session* s, int argc, char** argv, FILE* out) {
+    uint32_t id;
+    int64_t from = INT64_MIN, to = INT64_MAX;
+    if ((argc != 2 && argc != 4) || parse_u32(argv[1], &id) != 0 || (argc == 4 && (parse_time(argv[2], &from) != 0 || parse_time(argv[3], &to) != 0)))
+        return fail(out, "usage statement <id> [from to]");
+    PlayerLedger* l = open_ledger(s, out);
+    if (!l) return -1;
+    StatementReply st = {NULL, 0, 0, 0};
+    int rc = persist_ledger_statement(l, id, from, to, collect_row, &st);
+    persist_ledger_close(l);
+    if (rc < 0 || st.oom) rc = fail(out, st.oom ? "oom" : "io");
+    else {
+        uint64_t cards = 0;
+        Money spend = 0, won = 0, refunded = 0;
+        for (uint32_t i = 0; i < st.count; ++i) {
+            cards += st.rows[i].cards;
+            spend += st.rows[i].spend;
+            if (st.rows[i].flags & LEDGER_CANCELLED) refunded += st.rows[i].payout;
+            else won += st.rows[i].payout;
+        }
+        fprintf(out, "ok %u %llu %.2f %.2f %.2f\n", st.count, (unsigned long long)cards, money_units(spend), money_units(won), money_units(refunded));
+        for (uint32_t i = 0; i < st.count; ++i) {
+            const LedgerRow* r = &st.rows[i];
+            fprintf(out, "%u %lld %u %.2f %.2f %s\n", r->match_number, (long long)r->at, r->cards, money_units(r->spend),
+                    money_units(r->payout), (r->flags & LEDGER_CANCELLED) ? "cancel" : "end");
+        }
+        rc = 0;
+    }
+    free(st.rows);
+    return rc;
+}
+
+static int cmd_summary(Session* s, int argc, char** argv, FILE* out) {
+    int64_t from = INT64_MIN, to = INT64_MAX;
+    if ((argc != 1 && argc != 3) || (argc == 3 && (parse_time(argv[1], &from) != 0 || parse_time(argv[2], &to) != 0)))
+        return fail(out, "usage summary [from to]");
+    PlayerLedger* l = open_ledger(s, out);
+    if (!l) return -1;
+    LedgerSummary sum;
+    int rc = persist_ledger_summary(l, from, to, &sum);
+    persist_ledger_close(l);
+    if (rc != 0) return fail(out, "io");
+    fprintf(out, "ok %llu %llu %llu %.2f %.2f %.2f\n", (unsigned long long)sum.matches, (unsigned long long)sum.rows, (unsigned long long)sum.cards,
+            money_units(sum.spend), money_units(sum.won), money_units(sum.refunded));
+    return 0;
+}
+
+static int cmd_top(Session* s, int argc, char** argv, FILE* out) {
+    uint32_t k = TOP_DEFAULT_K;
+    int kind = argc >= 2 ? leaderboard_parse(argv[1]) : -1;
+    if (argc < 2 || argc > 3 || kind < 0 || (argc == 3 && parse_u32(argv[2], &k) != 0))
+        return fail(out, "usage top <won|net|cards|wins> [k]");
+    if (!s->roster.boards) return fail(out, "unavailable");
+    if (k > s->roster.count) k = s->roster.count;
+    BoardEntry* top = (BoardEntry*)malloc(((size_t)k + 1) * sizeof(BoardEntry));
+    if (!top) return fail(out, "oom");
+    uint32_t n = leaderboard_top(&s->roster, (BoardKind)kind, k, top);
+    fprintf(out, "ok %u\n", n);
+    for (uint32_t i = 0; i < n; ++i) {
+        fprintf(out, "%u %u %s ", i + 1, top[i].player_id, engine_player_name(&s->roster, top[i].player_id));
+        if (kind == BOARD_WON || kind == BOARD_NET) fprintf(out, "%.2f\n", money_units(top[i].score));
+        else fprintf(out, "%lld\n", (long long)top[i].score);
+    }
+    free(top);
+    return 0;
+}
+
+static int cmd_list(Session* s, int argc, FILE* out) {
+    if (argc != 1) return fail(out, "usage list");
+    fprintf(out, "ok %u\n", s->roster.count);
+    for (uint32_t i = 0; i < s->roster.slot_count; ++i) {
+        const Player* p = roster_at(&s->roster, i);
+        if (p->id) fprintf(out, "%u %s %.2f\n", p->id, roster_name_at(&s->roster, i), money_units(p->balance));
+    }
+    return 0;
+}
+
+int command_run(Session* s, const char* line, FILE* out) {
+    char buf[COMMAND_LINE_LEN];
+    snprintf(buf, sizeof(buf), "%s", line);
+    char* argv[MAX_ARGS];
+    int argc = tokenize(buf, argv);
+    if (argc == 0) return 0;
+    const char* cmd = argv[0];
+    if (argc > MAX_ARGS) return fail(out, "usage too many arguments");
+
+    if (strcmp(cmd, "add") == 0) {
+        Money bal;
+        if (argc != 3 || parse_money(argv[2], &bal) != 0) return fail(out, "usage add <name> <balance>");
+        if (bal < 0) return fail(out, "amount");
+        int id = engine_add_player(&s->roster, argv[1], bal);
+        if (id < 0) return fail(out, "max_players");
+        session_log_add(s, (uint32_t)id);
+        fprintf(out, "ok %d\n", id);
+    } else if (strcmp(cmd, "remove") == 0) {
+        uint32_t id;
+        if (argc != 2 || parse_u32(argv[1], &id) != 0) return fail(out, "usage remove <id>");
+        if (engine_remove_player(&s->roster, id) != 0) return fail(out, "not_found");
+        char details[64];
+        snprintf(details, sizeof(details), "remove,id=%u", id);
+        session_log(s, "remove", details);
+        fprintf(out, "ok\n");
+    } else if (strcmp(cmd, "recharge") == 0) {
+        uint32_t id;
+        Money amount;
+        if (argc != 3 || parse_u32(argv[1], &id) != 0 || parse_money(argv[2], &amount) != 0)
+            return fail(out, "usage recharge <id> <amount>");
+        int rc = engine_recharge_player(&s->roster, id, amount);
+        if (rc == -2) return fail(out, "amount");
+        if (rc != 0) return fail(out, "not_found");
+        // no checkpoint per recharge: the journal holds it until the next end/cancel/save
+        char details[128];
+        snprintf(details, sizeof(details), "recharge,id=%u,amount=%.2f", id, money_units(amount));
+        session_log(s, "recharge", details);
+        fprintf(out, "ok %.2f\n", money_units(engine_find_player(&s->roster, id)->balance));
+    } else if (strcmp(cmd, "import") == 0) {
+        return cmd_import(s, argc, argv, out);
+    } else if (strcmp(cmd, "start") == 0) {
+        return cmd_start(s, argc, argv, out);
+    } else if (strcmp(cmd, "buy") == 0) {
+        return cmd_buy(s, argc, argv, out);
+    } else if (strcmp(cmd, "winner") == 0 || strcmp(cmd, "unwinner") == 0) {
+        uint32_t id;
+        if (argc != 2 || parse_u32(argv[1], &id) != 0) return fail(out, cmd[0] == 'w' ? "usage winner <id>" : "usage unwinner <id>");
+        if (!s->match.active) return fail(out, "no_match");
+        if (cmd[0] == 'w') {
+            int rc = match_add_winner(&s->match, &s->roster, id);
+            if (rc != 0) return fail(out, winner_error(rc));
+        } else if (match_remove_winner(&s->match, id) != 0) {
+            return fail(out, "not_found");
+        }
+        fprintf(out, "ok %u\n", s->match.winner_count);
+    } else if (strcmp(cmd, "end") == 0) {
+        return cmd_end(s, argc, out);
+    } else if (strcmp(cmd, "cancel") == 0) {
+        if (argc != 1) return fail(out, "usage cancel");
+        if (!s->match.active) return fail(out, "no_match");
+        Money refunded = s->match.pot;
+        match_cancel(&s->match, &s->roster);
+        if (session_verify(s) != 0) fprintf(stderr, "audit: books do not balance after cancelling match %u\n", s->match.match_number);
+        session_record_cancel(s);
+        session_checkpoint(s);
+        session_log(s, "cancel_match", "refunds issued");
+        fprintf(out, "ok %.2f\n", money_units(refunded));
+    } else if (strcmp(cmd, "player") == 0 || strcmp(cmd, "find") == 0) {
+        uint32_t id;
+        if (argc != 2 || parse_u32(argv[1], &id) != 0) return fail(out, "usage player <id>");
+        const Player* p = engine_find_player(&s->roster, id);
+        if (!p) return fail(out, "not_found");
+        fprintf(out, "ok %u %s %.2f %u %u %u\n", p->id, engine_player_name(&s->roster, id), money_units(p->balance),
+                p->record.wins, p->record.losses, p->lifetime_cards);
+    } else if (strcmp(cmd, "list") == 0) {
+        return cmd_list(s, argc, out);
+    } else if (strcmp(cmd, "top") == 0) {
+        return cmd_top(s, argc, argv, out);
+    } else if (strcmp(cmd, "status") == 0) {
+        if (argc != 1) return fail(out, "usage status");
+        fprintf(out, "ok %u %u %.2f %d %u %.2f %u\n", s->roster.count, s->acc.total_matches, money_units(s->acc.saved_pot),
+                s->match.active ? 1 : 0, s->match.active ? s->match.match_number : 0,
+                money_units(s->match.active ? s->match.pot : 0), s->match.active ? s->match.winner_count : 0);
+    } else if (strcmp(cmd, "audit") == 0) {
+        if (argc != 1) return fail(out, "usage audit");
+        AuditTotals t;
+        if (audit_roster(&s->roster, &t) != 0) {
+            fprintf(out, "err mismatch %u %u %u\n", t.first_bad_id, t.mismatched, t.negative);
+            return -1;
+        }
+        // the full pass doubles as a cross-check of the maintained totals
+        if (audit_recount(&s->roster, &t) != 0) return fail(out, "totals");
+        if (audit_verify(&s->roster, &s->acc, &s->match, 1) != 0) return fail(out, "unbalanced");
+        fprintf(out, "ok %u %.2f %.2f %.2f %.2f\n", t.players, money_units(t.balance), money_units(t.recharged),
+                money_units(t.spent), money_units(t.won));
+    } else if (strcmp(cmd, "history") == 0) {
+        return cmd_history(s, argc, argv, out);
+    } else if (strcmp(cmd, "wins") == 0) {
+        return cmd_wins(s, argc, argv, out);
+    } else if (strcmp(cmd, "statement") == 0) {
+        return cmd_statement(s, argc, argv, out);
+    } else if (strcmp(cmd, "summary") == 0) {
+        return cmd_summary(s, argc, argv, out);
+    } else if (strcmp(cmd, "save") == 0) {
+        if (argc != 1) return fail(out, "usage save");
+        int full = session_checkpoint(s);
+        session_log(s, "checkpoint", "batch save");
+        int rc = writer_flush(s->writer) != 0 ? fail(out, "io") : 0;
+        if (rc == 0) fprintf(out, "ok %s\n", full ? "checkpoint" : "journal");
+        fflush(out); // a client waits for this answer
+        return rc;
+    } else if (strcmp(cmd, "sync") == 0) {
+        if (argc != 1) return fail(out, "usage sync");
+        writer_sync_journal(s->writer);
+        int rc = writer_flush(s->writer) != 0 ? fail(out, "io") : 0;
+        if (rc == 0) fprintf(out, "ok\n");
+        fflush(out); // responses are buffered up to here
+        return rc;
+    } else if (strcmp(cmd, "quit") == 0) {
+        fprintf(out, "ok\n");
+        return 1;
+    } else {
+        return fail(out, "unknown");
+    }
+    return 0;
+}
+
+int command_run_stream(Session* s, FILE* in, FILE* out) {
+    char line[COMMAND_LINE_LEN];
+    uint32_t since_sync = 0;
+    int rc = 0;
+    while (fgets(line, sizeof(line), in)) {
+        size_t len = strlen(line);
+        if (len == sizeof(line) - 1 && line[len - 1] != '\n' && !feof(in)) {
+            // skip the rest of an over-long line rather than running its tail as a command
+            int c;
+            while ((c = fgetc(in)) != EOF && c != '\n') {}
+            fail(out, "line_too_long");
+            rc = 1;
+            continue;
+        }
+        int r = command_run(s, line, out);
+        if (r == 1) break;
+        // keep the journal moving without a sync per command
+        if (++since_sync >= COMMAND_SYNC_EVERY) { writer_sync_journal(s->writer); since_sync = 0; }
+    }
+    fflush(out);
+    return rc;
+}
@@ -1,38 +1,79 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // pthread_rwlock_t (platform.h)
+#endif
+#include <stdlib.h>
 #include "config.h"
+#include "platform.h"
 
-static double NORMAL_CARD_COST = 0.25; // rule 4
-static double FULLHOUSE_CARD_COST = 0.0; // undefined until set
-static double SAVED_POT_PERCENTAGE = 0.15; // rule 5 (example default 15%)
-static uint32_t MAX_PLAYERS = 512; // capacity
-static int ALLOW_MULTI_WINNERS = 1; // rule 3
+static const ConfigSnapshot DEFAULTS = {
+    25,        // normal card cost, rule 4
+    0,         // full house card cost, undefined until set
+    1500,      // saved pot share, rule 5 (example default 15%)
+    512,       // max players; soft cap, roster storage grows on demand
+    1          // allow multi winners, rule 3
+};
 
-void cfg_init_defaults(void) {
-    NORMAL_CARD_COST = 0.25;
-    FULLHOUSE_CARD_COST = 0.0;
-    SAVED_POT_PERCENTAGE = 0.15;
-    MAX_PLAYERS = 512;
-    ALLOW_MULTI_WINNERS = 1;
+// Published snapshots are never freed: a reader on another thread may still be using the one
+// it loaded. Settings change by operator action only, so the few retired copies cost nothing.
+static void* CURRENT = (void*)&DEFAULTS;
+
+static int snapshot_valid(const ConfigSnapshot* c) {
+    return c->normal_card_cost >= 0 && c->fullhouse_card_cost >= 0 && c->saved_pot_bp <= MONEY_BP_SCALE && c->max_players > 0;
 }
 
-double cfg_get_normal_card_cost(void) { return NORMAL_CARD_COST; }
-void   cfg_set_normal_card_cost(double cost) { NORMAL_CARD_COST = (cost >= 0.0) ? cost : NORMAL_CARD_COST; }
+// Copy-and-swap: retried if another setter published in between, so no change is lost.
+static int publish_from(const ConfigSnapshot* seen, const ConfigSnapshot* next) {
+    if (!snapshot_valid(next)) return -1;
+    ConfigSnapshot* copy = (ConfigSnapshot*)malloc(sizeof(ConfigSnapshot));
+    if (!copy) return -2;
+    *copy = *next;
+    if (plat_atomic_cas_ptr(&CURRENT, (void*)seen, copy)) return 0;
+    free(copy);
+    return 1;
+}
+
+void cfg_init_defaults(void) {
+    const ConfigSnapshot* seen;
+    do seen = cfg_snapshot();
+    while (!plat_atomic_cas_ptr(&CURRENT, (void*)seen, (void*)&DEFAULTS));
+}
 
-double cfg_get_fullhouse_card_cost(void) { return FULLHOUSE_CARD_COST; }
-void   cfg_set_fullhouse_card_cost(double cost) { FULLHOUSE_CARD_COST = (cost >= 0.0) ? cost : FULLHOUSE_CARD_COST; }
+const ConfigSnapshot* cfg_snapshot(void) { return (const ConfigSnapshot*)plat_atomic_load_ptr(&CURRENT); }
 
-double cfg_get_saved_pot_percentage(void) { return SAVED_POT_PERCENTAGE; }
-void   cfg_set_saved_pot_percentage(double pct) {
-    if (pct < 0.0) pct = 0.0;
-    if (pct > 1.0) pct = 1.0;
-    SAVED_POT_PERCENTAGE = pct;
+int cfg_publish(const ConfigSnapshot* next) {
+    int rc;
+    do rc = publish_from(cfg_snapshot(), next);
+    while (rc == 1);
+    return rc;
 }
 
-uint32_t cfg_get_max_players(void) { return MAX_PLAYERS; }
-void     cfg_set_max_players(uint32_t maxp) { if (maxp > 0) MAX_PLAYERS = maxp; }
+// Applies `edit` to a copy of the current snapshot and publishes it. Out-of-range values (and
+// a failed allocation) leave the setting unchanged, as the setters always have.
+#define CFG_UPDATE(edit) do {                                        \
+        int rc_;                                                     \
+        do {                                                         \
+            const ConfigSnapshot* seen_ = cfg_snapshot();            \
+            ConfigSnapshot next_ = *seen_;                           \
+            edit;                                                    \
+            rc_ = publish_from(seen_, &next_);                       \
+        } while (rc_ == 1);                                          \
+    } while (0)
+
+Money cfg_get_normal_card_cost(void) { return cfg_snapshot()->normal_card_cost; }
+void  cfg_set_normal_card_cost(Money cost) { if (cost >= 0) CFG_UPDATE(next_.normal_card_cost = cost); }
+
+Money cfg_get_fullhouse_card_cost(void) { return cfg_snapshot()->fullhouse_card_cost; }
+void  cfg_set_fullhouse_card_cost(Money cost) { if (cost >= 0) CFG_UPDATE(next_.fullhouse_card_cost = cost); }
+
+uint32_t cfg_get_saved_pot_bp(void) { return cfg_snapshot()->saved_pot_bp; }
+void     cfg_set_saved_pot_bp(uint32_t bp) { CFG_UPDATE(next_.saved_pot_bp = bp > MONEY_BP_SCALE ? MONEY_BP_SCALE : bp); }
+
+uint32_t cfg_get_max_players(void) { return cfg_snapshot()->max_players; }
+void     cfg_set_max_players(uint32_t maxp) { if (maxp > 0) CFG_UPDATE(next_.max_players = maxp); }
 
-int cfg_get_allow_multi_winners(void) { return ALLOW_MULTI_WINNERS; }
-void cfg_set_allow_multi_winners(int allow) { ALLOW_MULTI_WINNERS = allow ? 1 : 0; }
+int cfg_get_allow_multi_winners(void) { return cfg_snapshot()->allow_multi_winners; }
+void cfg_set_allow_multi_winners(int allow) { CFG_UPDATE(next_.allow_multi_winners = allow ? 1 : 0); }
 
 int cfg_validate(void) {
-    return NORMAL_CARD_COST >= 0.0 && SAVED_POT_PERCENTAGE >= 0.0 && SAVED_POT_PERCENTAGE <= 1.0 && MAX_PLAYERS > 0;
+    return snapshot_valid(cfg_snapshot());
 }
@@ -0,0 +1,390 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // pthread_rwlock_t (platform.h)
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include "engine.h"
+#include "bingo.h"
+#include "audit.h"
+#include "platform.h"
+
+// Locks sit on their own cache lines so neighbouring halls and sellers do not false-share.
+typedef union {
+    plat_mutex lock;
+    char pad[64];
+} PaddedLock;
+
+struct EngineSeller {
+    PaddedLock lock;           // held by each buy; taken by every change to the roster or the hall's match
+    Engine* engine;
+    uint32_t hall;
+    Match sold;                // sales not merged yet: ledger rows and pot only
+};
+
+// A hall's sellers. Changed under the hall lock plus the roster write lock, so either one
+// is enough to walk the list.
+typedef struct {
+    EngineSeller** list;
+    uint32_t count;
+    uint32_t capacity;
+} SellerList;
+
+struct Engine {
+    plat_rwlock roster_lock;   // roster structure, and with it Accounting (changed only under the write side)
+    Roster roster;
+    Accounting acc;            // acc.next_match is taken atomically at match start
+    uint32_t hall_count;
+    PaddedLock* hall_locks;
+    Match* matches;            // one per hall, contiguous so journal_replay can take the array
+    SellerList* sellers;       // one list per hall
+};
+
+// Returns the hall's match with the hall lock held, or NULL for a bad index.
+static Match* hall_lock(Engine* e, uint32_t hall) {
+    if (hall >= e->hall_count) return NULL;
+    plat_mutex_lock(&e->hall_locks[hall].lock);
+    return &e->matches[hall];
+}
+
+static void hall_unlock(Engine* e, const Match* m) {
+    plat_mutex_unlock(&e->hall_locks[m->hall].lock);
+}
+
+static void sellers_lock(const SellerList* l) {
+    for (uint32_t i = 0; i < l->count; ++i) plat_mutex_lock(&l->list[i]->lock.lock);
+}
+
+static void sellers_unlock(const SellerList* l) {
+    for (uint32_t i = l->count; i-- > 0;) plat_mutex_unlock(&l->list[i]->lock.lock);
+}
+
+// Moves the sellers' sales into the hall's match and books them into the roster totals;
+// call with the sellers locked. -3 on OOM.
+static int sellers_merge(Engine* e, const SellerList* l, Match* m) {
+    int rc = 0;
+    Money pot = m->pot;
+    for (uint32_t i = 0; i < l->count; ++i) {
+        if (l->list[i]->sold.entry_count && match_merge(m, &l->list[i]->sold) != 0) rc = -3;
+    }
+    if (m->pot != pot) roster_book_purchase(&e->roster, m->pot - pot);
+    return rc;
+}
+
+// The roster exclusively: its write lock, then every seller (sellers read it without the rwlock).
+static void roster_exclusive_begin(Engine* e) {
+    plat_rwlock_wrlock(&e->roster_lock);
+    for (uint32_t h = 0; h < e->hall_count; ++h) sellers_lock(&e->sellers[h]);
+}
+
+static void roster_exclusive_end(Engine* e) {
+    for (uint32_t h = e->hall_count; h-- > 0;) sellers_unlock(&e->sellers[h]);
+    plat_rwlock_wrunlock(&e->roster_lock);
+}
+
+Engine* engine_create(uint32_t hall_count) {
+    if (hall_count == 0 || hall_count > ENGINE_MAX_HALLS) return NULL;
+    Engine* e = (Engine*)calloc(1, sizeof(Engine));
+    if (!e) return NULL;
+    e->hall_locks = (PaddedLock*)calloc(hall_count, sizeof(PaddedLock));
+    e->matches = (Match*)calloc(hall_count, sizeof(Match));
+    e->sellers = (SellerList*)calloc(hall_count, sizeof(SellerList));
+    if (!e->hall_locks || !e->matches || !e->sellers) { free(e->hall_locks); free(e->matches); free(e->sellers); free(e); return NULL; }
+    e->hall_count = hall_count;
+    plat_rwlock_init(&e->roster_lock);
+    roster_init(&e->roster);
+    e->acc.next_match = 1;
+    for (uint32_t h = 0; h < hall_count; ++h) {
+        plat_mutex_init(&e->hall_locks[h].lock);
+        e->matches[h].hall = h;
+    }
+    return e;
+}
+
+static void seller_free(EngineSeller* s) {
+    match_release(&s->sold);
+    plat_mutex_destroy(&s->lock.lock);
+    free(s);
+}
+
+void engine_destroy(Engine* e) {
+    if (!e) return;
+    for (uint32_t h = 0; h < e->hall_count; ++h) {
+        for (uint32_t i = 0; i < e->sellers[h].count; ++i) seller_free(e->sellers[h].list[i]);
+        free(e->sellers[h].list);
+        match_release(&e->matches[h]);
+        plat_mutex_destroy(&e->hall_locks[h].lock);
+    }
+    roster_free(&e->roster);
+    plat_rwlock_destroy(&e->roster_lock);
+    free(e->hall_locks);
+    free(e->matches);
+    free(e->sellers);
+    free(e);
+}
+
+uint32_t engine_hall_count(const Engine* e) { return e->hall_count; }
+
+// Halls are locked in index order, then the roster, matching the normal lock order.
+void engine_exclusive_begin(Engine* e, Roster** r, Accounting** acc, Match** halls) {
+    for (uint32_t h = 0; h < e->hall_count; ++h) plat_mutex_lock(&e->hall_locks[h].lock);
+    roster_exclusive_begin(e);
+    // sales that cannot be merged for lack of memory stay with their sellers
+    for (uint32_t h = 0; h < e->hall_count; ++h) sellers_merge(e, &e->sellers[h], &e->matches[h]);
+    if (r) *r = &e->roster;
+    if (acc) *acc = &e->acc;
+    if (halls) *halls = e->matches;
+}
+
+void engine_exclusive_end(Engine* e) {
+    roster_exclusive_end(e);
+    for (uint32_t h = e->hall_count; h-- > 0;) plat_mutex_unlock(&e->hall_locks[h].lock);
+}
+
+int engine_verify(Engine* e) {
+    Roster* r;
+    Accounting* acc;
+    Match* halls;
+    engine_exclusive_begin(e, &r, &acc, &halls);
+    int rc = audit_verify(r, acc, halls, e->hall_count);
+    engine_exclusive_end(e);
+    return rc;
+}
+
+int engine_player_add(Engine* e, const char* name, Money initial_balance) {
+    roster_exclusive_begin(e);
+    int id = engine_add_player(&e->roster, name, initial_balance);
+    roster_exclusive_end(e);
+    return id;
+}
+
+int engine_player_remove(Engine* e, uint32_t player_id) {
+    roster_exclusive_begin(e);
+    int rc = engine_remove_player(&e->roster, player_id);
+    roster_exclusive_end(e);
+    return rc;
+}
+
+int engine_player_recharge(Engine* e, uint32_t player_id, Money amount) {
+    plat_rwlock_rdlock(&e->roster_lock);
+    int rc = engine_recharge_player(&e->roster, player_id, amount);
+    plat_rwlock_rdunlock(&e->roster_lock);
+    return rc;
+}
+
+int engine_player_get(Engine* e, uint32_t player_id, Player* out, char* name) {
+    plat_rwlock_rdlock(&e->roster_lock);
+    int rc = -1;
+    Player* p = engine_find_player(&e->roster, player_id);
+    if (p) {
+        // id, record and winnings change only under the exclusive roster
+        out->id = p->id;
+        out->record = p->record;
+        out->total_won = p->total_won;
+        out->balance = plat_atomic_load64(&p->balance);
+        out->total_recharged = plat_atomic_load64(&p->total_recharged);
+        out->total_spent = plat_atomic_load64(&p->total_spent);
+        out->cards_owned = plat_atomic_load32(&p->cards_owned);
+        out->lifetime_cards = plat_atomic_load32(&p->lifetime_cards);
+        if (name) memcpy(name, engine_player_name(&e->roster, player_id), PLAYER_NAME_LEN);
+        rc = 0;
+    }
+    plat_rwlock_rdunlock(&e->roster_lock);
+    return rc;
+}
+
+uint32_t engine_leaderboard(Engine* e, BoardKind kind, uint32_t k, BoardEntry* out) {
+    // the boards change only under the exclusive roster or the write lock (engine_match_buy_batch)
+    plat_rwlock_rdlock(&e->roster_lock);
+    uint32_t n = leaderboard_top(&e->roster, kind, k, out);
+    plat_rwlock_rdunlock(&e->roster_lock);
+    return n;
+}
+
+int engine_match_start(Engine* e, uint32_t hall, GameMode mode, Money card_cost) {
+    Match* m = hall_lock(e, hall);
+    if (!m) return -1;
+    int rc = -2;
+    if (!m->active) {
+        sellers_lock(&e->sellers[hall]);
+        m->hall = hall;
+        m->match_number = plat_atomic_add32(&e->acc.next_match, 1);
+        match_start(m, mode, card_cost);
+        sellers_unlock(&e->sellers[hall]);
+        rc = (int)m->match_number;
+    }
+    hall_unlock(e, m);
+    return rc;
+}
+
+// Reserves the money, then books the sale on `ledger` (the hall's match or a seller's).
+// Call with the roster readable: its read lock, or the seller's lock.
+static int sell(Engine* e, const Match* m, Match* ledger, uint32_t player_id, uint32_t count) {
+    Player* p = engine_find_player(&e->roster, player_id);
+    if (!p) return -3;
+    Money cost = m->card_cost * (Money)count;
+    if (player_reserve_cards(p, count, cost) != 0) return -4;
+    if (ledger != m) ledger->match_number = m->match_number; // for the buy event
+    if (match_record_purchase(ledger, player_id, count, cost) != 0) {
+        player_unreserve_cards(p, count, cost);
+        return -2;
+    }
+    // a seller's sales are booked when they are merged into the hall's match
+    if (ledger == m) roster_book_purchase(&e->roster, cost);
+    return 0;
+}
+
+int engine_match_buy(Engine* e, uint32_t hall, uint32_t player_id, uint32_t count) {
+    Match* m = hall_lock(e, hall);
+    if (!m) return -1;
+    int rc = -1;
+    if (m->active && count > 0) {
+        plat_rwlock_rdlock(&e->roster_lock);
+        rc = sell(e, m, m, player_id, count);
+        plat_rwlock_rdunlock(&e->roster_lock);
+    }
+    hall_unlock(e, m);
+    return rc;
+}
+
+// The batch writes balances without compare-and-swap, so it holds the roster exclusively: the
+// write lock keeps out recharges and hall buys, and every seller's lock keeps out seller
+// reservations (engine_seller_buy takes only its own). The whole list is one sweep.
+int engine_match_buy_batch(Engine* e, uint32_t hall, const MatchPurchase* items, uint32_t n, int* status) {
+    Match* m = hall_lock(e, hall);
+    if (!m) return -1;
+    roster_exclusive_begin(e);
+    int rc = match_buy_cards_batch(m, &e->roster, items, n, status);
+    roster_exclusive_end(e);
+    hall_unlock(e, m);
+    return rc;
+}
+
+int engine_match_add_winner(Engine* e, uint32_t hall, uint32_t player_id) {
+    Match* m = hall_lock(e, hall);
+    if (!m) return -1;
+    plat_rwlock_rdlock(&e->roster_lock);
+    // winners must be on the ledger, so bring in the sellers' buyers first
+    sellers_lock(&e->sellers[hall]);
+    int rc = sellers_merge(e, &e->sellers[hall], m) != 0 ? -7 : 0;
+    sellers_unlock(&e->sellers[hall]);
+    if (rc == 0) rc = match_add_winner(m, &e->roster, player_id);
+    plat_rwlock_rdunlock(&e->roster_lock);
+    hall_unlock(e, m);
+    return rc;
+}
+
+int engine_match_remove_winner(Engine* e, uint32_t hall, uint32_t player_id) {
+    Match* m = hall_lock(e, hall);
+    if (!m) return -1;
+    int rc = match_remove_winner(m, player_id);
+    hall_unlock(e, m);
+    return rc;
+}
+
+// Payouts touch many players plus Accounting, so ending takes the roster exclusively;
+// it is one short pass per match, against many buys.
+int engine_match_end(Engine* e, uint32_t hall) {
+    Match* m = hall_lock(e, hall);
+    if (!m) return -1;
+    int rc = -1;
+    if (m->active) {
+        roster_exclusive_begin(e);
+        if (sellers_merge(e, &e->sellers[hall], m) != 0) {
+            rc = -3;
+        } else if (m->entry_count > 0 && m->winner_count == 0) {
+            rc = -2;
+        } else {
+            match_end(m, &e->acc, &e->roster);
+            rc = 0;
+        }
+        roster_exclusive_end(e);
+    }
+    hall_unlock(e, m);
+    return rc;
+}
+
+int engine_match_cancel(Engine* e, uint32_t hall) {
+    Match* m = hall_lock(e, hall);
+    if (!m) return -1;
+    int rc = -1;
+    if (m->active) {
+        roster_exclusive_begin(e);
+        rc = sellers_merge(e, &e->sellers[hall], m);
+        if (rc == 0) match_cancel(m, &e->roster);
+        roster_exclusive_end(e);
+    }
+    hall_unlock(e, m);
+    return rc;
+}
+
+int engine_match_get(Engine* e, uint32_t hall, Match* out) {
+    Match* m = hall_lock(e, hall);
+    if (!m) return -1;
+    sellers_lock(&e->sellers[hall]);
+    int rc = sellers_merge(e, &e->sellers[hall], m);
+    sellers_unlock(&e->sellers[hall]);
+    *out = *m;
+    hall_unlock(e, m);
+    out->entries = NULL;
+    out->entry_slots = NULL;
+    out->entry_capacity = out->entry_slot_mask = 0;
+    return rc;
+}
+
+EngineSeller* engine_seller_open(Engine* e, uint32_t hall) {
+    if (hall >= e->hall_count) return NULL;
+    EngineSeller* s = (EngineSeller*)calloc(1, sizeof(EngineSeller));
+    if (!s) return NULL;
+    plat_mutex_init(&s->lock.lock);
+    s->engine = e;
+    s->hall = hall;
+    s->sold.hall = hall;
+    // listing needs no seller lock: sellers only ever lock themselves
+    Match* m = hall_lock(e, hall);
+    plat_rwlock_wrlock(&e->roster_lock);
+    SellerList* l = &e->sellers[hall];
+    int ok = 1;
+    if (l->count == l->capacity) {
+        uint32_t cap = l->capacity ? l->capacity * 2 : 8;
+        EngineSeller** grown = (EngineSeller**)realloc(l->list, (size_t)cap * sizeof(EngineSeller*));
+        if (grown) { l->list = grown; l->capacity = cap; }
+        else ok = 0;
+    }
+    if (ok) l->list[l->count++] = s;
+    plat_rwlock_wrunlock(&e->roster_lock);
+    hall_unlock(e, m);
+    if (!ok) { seller_free(s); return NULL; }
+    return s;
+}
+
+int engine_seller_close(EngineSeller* s) {
+    Engine* e = s->engine;
+    // the calling thread owns the seller, so its sales need no lock; the hall lock covers the match
+    Match* m = hall_lock(e, s->hall);
+    Money pot = m->pot;
+    int rc = s->sold.entry_count && match_merge(m, &s->sold) != 0 ? -3 : 0;
+    if (m->pot != pot) roster_book_purchase(&e->roster, m->pot - pot);
+    if (rc == 0) {
+        SellerList* l = &e->sellers[s->hall];
+        plat_rwlock_wrlock(&e->roster_lock);
+        for (uint32_t i = 0; i < l->count; ++i) {
+            if (l->list[i] == s) { l->list[i] = l->list[--l->count]; break; }
+        }
+        plat_rwlock_wrunlock(&e->roster_lock);
+    }
+    hall_unlock(e, m);
+    if (rc == 0) seller_free(s);
+    return rc;
+}
+
+// Only the seller's own lock: it keeps the roster and the hall's match settled (every change
+// to either takes all sellers' locks), and the money moves by compare-and-swap.
+int engine_seller_buy(EngineSeller* s, uint32_t player_id, uint32_t count) {
+    if (count == 0) return -1;
+    Engine* e = s->engine;
+    plat_mutex_lock(&s->lock.lock);
+    const Match* m = &e->matches[s->hall];
+    int rc = m->active ? sell(e, m, &s->sold, player_id, count) : -1;
+    plat_mutex_unlock(&s->lock.lock);
+    return rc;
+}
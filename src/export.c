@@ -0,0 +1,225 @@
+// Roster summary export (players_summary.csv). Rows are formatted without stdio: integers and
+// cents go through a two-digits-at-a-time formatter into one buffer per roster chunk. With more
+// than one thread, workers format chunks ahead of the calling thread, which writes them to the
+// descriptor strictly in chunk order, so the output is the same for any thread count.
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // fsync, pthread_rwlock_t (platform.h)
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "persist.h"
+#include "bingo.h"
+#include "platform.h"
+
+#define EXPORT_HEADER "id,name,balance,total_recharged,total_spent,total_won,wins,losses,draws,lifetime_cards,net_gain\n"
+#define EXPORT_PATH_LEN 512
+#define EXPORT_SLOTS_PER_THREAD 2 // chunks a worker may run ahead of the writer
+
+// Longest row: four u32 counters and an id (10 digits each), five money fields ("-" plus 20
+// digits, ".", 2 digits), a name, ten commas and the newline.
+#define EXPORT_ROW_MAX (5 * 10 + 5 * 24 + (PLAYER_NAME_LEN - 1) + 11)
+#define EXPORT_CHUNK_MAX ((size_t)ROSTER_CHUNK_SIZE * EXPORT_ROW_MAX)
+
+#ifdef _WIN32
+static int e_create(const char* path) { return _open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644); }
+static long long e_write(int fd, const void* p, size_t n) { return _write(fd, p, (unsigned)(n < (1u << 30) ? n : (1u << 30))); }
+static int e_fsync(int fd) { return _commit(fd); }
+static int e_close(int fd) { return _close(fd); }
+static int e_replace(const char* from, const char* to) { return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : -1; }
+#else
+static int e_create(const char* path) { return open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644); }
+static long long e_write(int fd, const void* p, size_t n) {
+    ssize_t w;
+    do w = write(fd, p, n); while (w < 0 && errno == EINTR);
+    return (long long)w;
+}
+static int e_fsync(int fd) { return fsync(fd); }
+static int e_close(int fd) { return close(fd); }
+static int e_replace(const char* from, const char* to) { return rename(from, to); }
+#endif
+
+static int write_all(int fd, const char* p, size_t n) {
+    while (n) {
+        long long w = e_write(fd, p, n);
+        if (w <= 0) return -1;
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+static const char DIGIT_PAIRS[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+static char* put_uint(char* p, uint64_t v) {
+    char tmp[20];
+    char* t = tmp + sizeof(tmp);
+    while (v >= 100) {
+        uint64_t q = v / 100;
+        t -= 2;
+        memcpy(t, DIGIT_PAIRS + 2 * (v - q * 100), 2);
+        v = q;
+    }
+    if (v >= 10) { t -= 2; memcpy(t, DIGIT_PAIRS + 2 * v, 2); }
+    else *--t = (char)('0' + v);
+    size_t n = (size_t)(tmp + sizeof(tmp) - t);
+    memcpy(p, t, n);
+    return p + n;
+}
+
+// Cents as units with two decimals, the same text as printf("%.2f", money_units(c)).
+static char* put_money(char* p, Money c) {
+    uint64_t u = (uint64_t)c;
+    if (c < 0) { *p++ = '-'; u = 0 - u; }
+    p = put_uint(p, u / MONEY_SCALE);
+    *p++ = '.';
+    memcpy(p, DIGIT_PAIRS + 2 * (u % MONEY_SCALE), 2);
+    return p + 2;
+}
+
+// Formats the live players of roster chunk c into out (EXPORT_CHUNK_MAX bytes); returns the length.
+static size_t format_chunk(const Roster* r, uint32_t c, char* out) {
+    uint32_t first = c << ROSTER_CHUNK_SHIFT;
+    uint32_t end = r->slot_count - first < ROSTER_CHUNK_SIZE ? r->slot_count : first + ROSTER_CHUNK_SIZE;
+    char* p = out;
+    for (uint32_t i = first; i < end; ++i) {
+        const Player* pl = roster_at(r, i);
+        if (pl->id == 0) continue;
+        const char* name = roster_name_at(r, i);
+        const char* nul = (const char*)memchr(name, '\0', PLAYER_NAME_LEN - 1);
+        size_t len = nul ? (size_t)(nul - name) : PLAYER_NAME_LEN - 1;
+        p = put_uint(p, pl->id); *p++ = ',';
+        memcpy(p, name, len); p += len; *p++ = ',';
+        p = put_money(p, pl->balance); *p++ = ',';
+        p = put_money(p, pl->total_recharged); *p++ = ',';
+        p = put_money(p, pl->total_spent); *p++ = ',';
+        p = put_money(p, pl->total_won); *p++ = ',';
+        p = put_uint(p, pl->record.wins); *p++ = ',';
+        p = put_uint(p, pl->record.losses); *p++ = ',';
+        p = put_uint(p, pl->record.draws); *p++ = ',';
+        p = put_uint(p, pl->lifetime_cards); *p++ = ',';
+        p = put_money(p, pl->total_won - pl->total_spent); *p++ = '\n';
+    }
+    return (size_t)(p - out);
+}
+
+// Ordered pipeline: chunk c is formatted into slot c % slot_count once the writer has written
+// chunk c - slot_count, and the writer takes the slots back in chunk order.
+typedef struct {
+    char* buf;
+    size_t len;
+    int ready;
+} ExportSlot;
+
+typedef struct {
+    const Roster* r;
+    uint32_t chunks;
+    uint32_t next;      // next chunk a worker claims
+    uint32_t written;   // chunks written so far
+    uint32_t slot_count;
+    int stop;           // write failed; workers quit
+    ExportSlot* slots;
+    plat_mutex lock;
+    plat_cond cond;
+} Export;
+
+static void export_worker(void* arg) {
+    Export* e = (Export*)arg;
+    plat_mutex_lock(&e->lock);
+    for (;;) {
+        while (!e->stop && e->next < e->chunks && e->next >= e->written + e->slot_count) plat_cond_wait(&e->cond, &e->lock);
+        if (e->stop || e->next >= e->chunks) break;
+        uint32_t c = e->next++;
+        ExportSlot* s = &e->slots[c % e->slot_count];
+        plat_mutex_unlock(&e->lock);
+        s->len = format_chunk(e->r, c, s->buf);
+        plat_mutex_lock(&e->lock);
+        s->ready = 1;
+        plat_cond_broadcast(&e->cond);
+    }
+    plat_mutex_unlock(&e->lock);
+}
+
+static int write_serial(int fd, const Roster* r, uint32_t chunks) {
+    char* buf = (char*)malloc(EXPORT_CHUNK_MAX);
+    if (!buf) return -2;
+    int rc = 0;
+    for (uint32_t c = 0; rc == 0 && c < chunks; ++c) rc = write_all(fd, buf, format_chunk(r, c, buf));
+    free(buf);
+    return rc;
+}
+
+static int write_parallel(int fd, const Roster* r, uint32_t chunks, uint32_t threads) {
+    Export e;
+    memset(&e, 0, sizeof(e));
+    e.r = r;
+    e.chunks = chunks;
+    e.slot_count = threads * EXPORT_SLOTS_PER_THREAD;
+    e.slots = (ExportSlot*)calloc(e.slot_count, sizeof(ExportSlot));
+    plat_thread* pool = (plat_thread*)malloc(threads * sizeof(plat_thread));
+    char* arena = (char*)malloc(e.slot_count * EXPORT_CHUNK_MAX);
+    if (!e.slots || !pool || !arena) { free(e.slots); free(pool); free(arena); return -2; }
+    for (uint32_t i = 0; i < e.slot_count; ++i) e.slots[i].buf = arena + i * EXPORT_CHUNK_MAX;
+    plat_mutex_init(&e.lock);
+    plat_cond_init(&e.cond);
+    uint32_t started = 0;
+    while (started < threads && plat_thread_start(&pool[started], export_worker, &e) == 0) ++started;
+    int rc = 0;
+    if (started == 0) {
+        rc = write_serial(fd, r, chunks);
+    } else {
+        for (uint32_t c = 0; c < chunks; ++c) {
+            ExportSlot* s = &e.slots[c % e.slot_count];
+            plat_mutex_lock(&e.lock);
+            while (!s->ready) plat_cond_wait(&e.cond, &e.lock);
+            plat_mutex_unlock(&e.lock);
+            rc = write_all(fd, s->buf, s->len);
+            plat_mutex_lock(&e.lock);
+            s->ready = 0;
+            ++e.written;
+            if (rc != 0) e.stop = 1;
+            plat_cond_broadcast(&e.cond);
+            plat_mutex_unlock(&e.lock);
+            if (rc != 0) break;
+        }
+    }
+    for (uint32_t i = 0; i < started; ++i) plat_thread_join(pool[i]);
+    plat_cond_destroy(&e.cond);
+    plat_mutex_destroy(&e.lock);
+    free(arena);
+    free(pool);
+    free(e.slots);
+    return rc;
+}
+
+int persist_write_players_csv(int fd, const Roster* r, unsigned threads) {
+    uint32_t chunks = (uint32_t)(((uint64_t)r->slot_count + ROSTER_CHUNK_SIZE - 1) >> ROSTER_CHUNK_SHIFT);
+    if (threads == 0) threads = plat_cpu_count();
+    if (threads > EXPORT_MAX_THREADS) threads = EXPORT_MAX_THREADS;
+    if (threads > chunks) threads = chunks;
+    if (write_all(fd, EXPORT_HEADER, sizeof(EXPORT_HEADER) - 1) != 0) return -1;
+    return threads > 1 ? write_parallel(fd, r, chunks, threads) : write_serial(fd, r, chunks);
+}
+
+int persist_export_players_csv(const char* path, const Roster* r, unsigned threads) {
+    char tmp[EXPORT_PATH_LEN + 4];
+    if (strlen(path) >= EXPORT_PATH_LEN) return -1;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = e_create(tmp);
+    if (fd < 0) return -1;
+    int rc = persist_write_players_csv(fd, r, threads);
+    if (rc == 0 && e_fsync(fd) != 0) rc = -1;
+    if (e_close(fd) != 0 && rc == 0) rc = -1;
+    if (rc == 0 && e_replace(tmp, path) != 0) rc = -1;
+    if (rc != 0) remove(tmp);
+    return rc;
+}
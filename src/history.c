@@ -0,0 +1,847 @@
+// Indexed binary match history (layout in docs/persistence.md). Finished matches are appended
+// as fixed-size rows to <base>.tail; every HISTORY_BLOCK_MATCHES rows are sealed into one
+// column block appended to <base>.bin, and <base>.idx is rewritten with the block directory
+// (the sparse index by match number and time) and the winner postings sorted by player.
+// Order of a seal: block written and synced, index replaced, tail emptied; a crash between
+// any two steps is repaired from the block file and the rows already sealed are skipped.
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // fsync, fileno
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "persist.h"
+#include "bingo.h"
+
+#define HIST_MAGIC 0x42474F48        /* 'BGOH' */
+#define HIST_INDEX_MAGIC 0x42474F49  /* 'BGOI' */
+#define HIST_BLOCK_MAGIC 0x48424C4B  /* 'HBLK' */
+#define HIST_VERSION 1
+#define HIST_PATH_LEN 512
+
+#define HIST_FILE_HEADER 32
+#define HIST_BLOCK_HEADER 48
+#define HIST_ROW_BYTES 328
+#define HIST_INDEX_HEADER 64
+#define HIST_DIR_BYTES 32
+#define HIST_POSTING_BYTES 16
+
+// Column bytes per match in a block (see block_columns): match number, five 8-byte columns,
+// four 4-byte columns, mode and flags. The winners column adds 4 bytes per winner.
+#define HIST_ROW_COLUMN_BYTES 62
+
+typedef struct {
+    uint64_t offset;           // of the block header in <base>.bin
+    uint32_t first_match, last_match;
+    int64_t first_time, last_time;
+} HistBlockRef;
+
+typedef struct {
+    uint32_t player_id;
+    uint32_t match_number;
+    int64_t ended_at;
+} HistPosting;
+
+typedef struct {
+    HistBlockRef* blocks;
+    uint32_t block_count, block_cap;
+    HistPosting* postings;     // sorted by (player, ended_at, match) once `sorted`
+    uint32_t posting_count, posting_cap;
+    int sorted;
+    uint64_t bin_size;         // bytes of <base>.bin holding sealed blocks (0: no file yet)
+    uint64_t sealed;           // matches in the blocks
+    uint32_t last_match;
+    int64_t last_time;
+} HistIndex;
+
+// A block read into memory: the body and the offsets of its columns.
+typedef struct {
+    const uint8_t* body;
+    uint32_t count, winners;
+} BlockView;
+
+struct MatchHistory {
+    HistIndex idx;
+    HistoryMatch* tail;        // rows not yet sealed, in match order
+    uint32_t tail_count;
+    FILE* bin;
+    uint8_t* block;            // last block read, reused by the next query in the same block
+    size_t block_cap;
+    uint32_t cached;           // its directory index, UINT32_MAX if none
+    BlockView view;
+};
+
+static uint32_t CRC_TABLE[256];
+
+static uint32_t crc32(const uint8_t* p, size_t n) {
+    if (!CRC_TABLE[1]) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            CRC_TABLE[i] = c;
+        }
+    }
+    uint32_t c = 0xFFFFFFFFu;
+    while (n--) c = CRC_TABLE[(c ^ *p++) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+// Little-endian, like the journal, so history moves between machines.
+static void put_u16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put_u32(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; ++i) p[i] = (uint8_t)(v >> (8 * i)); }
+static void put_u64(uint8_t* p, uint64_t v) { for (int i = 0; i < 8; ++i) p[i] = (uint8_t)(v >> (8 * i)); }
+static uint16_t get_u16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t get_u32(const uint8_t* p) { uint32_t v = 0; for (int i = 3; i >= 0; --i) v = (v << 8) | p[i]; return v; }
+static uint64_t get_u64(const uint8_t* p) { uint64_t v = 0; for (int i = 7; i >= 0; --i) v = (v << 8) | p[i]; return v; }
+
+static int hist_path(char* out, const char* base, const char* ext) {
+    int n = snprintf(out, HIST_PATH_LEN, "%s%s", base, ext);
+    return n > 0 && n < HIST_PATH_LEN ? 0 : -1;
+}
+
+static long long file_size(FILE* f) {
+    if (fseek(f, 0, SEEK_END) != 0) return -1;
+    long long n = (long long)ftell(f);
+    return fseek(f, 0, SEEK_SET) == 0 ? n : -1;
+}
+
+// fclose after pushing the data to the device.
+static int close_synced(FILE* f) {
+    int rc = fflush(f);
+#ifdef _WIN32
+    if (rc == 0) rc = _commit(_fileno(f));
+#else
+    if (rc == 0) rc = fsync(fileno(f));
+#endif
+    if (fclose(f) != 0) rc = -1;
+    return rc == 0 ? 0 : -1;
+}
+
+// ---- tail rows ----
+
+static void row_encode(uint8_t* p, const HistoryMatch* h) {
+    memset(p, 0, HIST_ROW_BYTES);
+    put_u32(p, h->match_number);
+    p[4] = h->mode;
+    p[5] = h->flags;
+    put_u16(p + 6, (uint16_t)h->winner_count);
+    put_u32(p + 8, h->hall);
+    put_u32(p + 12, h->buyers);
+    put_u32(p + 16, h->cards);
+    put_u64(p + 24, (uint64_t)h->ended_at);
+    put_u64(p + 32, (uint64_t)h->card_cost);
+    put_u64(p + 40, (uint64_t)h->pot);
+    put_u64(p + 48, (uint64_t)h->saved);
+    put_u64(p + 56, (uint64_t)h->paid);
+    for (uint32_t i = 0; i < h->winner_count; ++i) put_u32(p + 64 + 4 * i, h->winners[i]);
+    put_u32(p + 320, crc32(p, 320));
+}
+
+static int row_decode(const uint8_t* p, HistoryMatch* h) {
+    if (get_u32(p + 320) != crc32(p, 320)) return -1;
+    memset(h, 0, sizeof(*h));
+    h->match_number = get_u32(p);
+    h->mode = p[4];
+    h->flags = p[5];
+    h->winner_count = get_u16(p + 6);
+    if (h->winner_count > HISTORY_MAX_WINNERS) return -1;
+    h->hall = get_u32(p + 8);
+    h->buyers = get_u32(p + 12);
+    h->cards = get_u32(p + 16);
+    h->ended_at = (int64_t)get_u64(p + 24);
+    h->card_cost = (Money)get_u64(p + 32);
+    h->pot = (Money)get_u64(p + 40);
+    h->saved = (Money)get_u64(p + 48);
+    h->paid = (Money)get_u64(p + 56);
+    for (uint32_t i = 0; i < h->winner_count; ++i) h->winners[i] = get_u32(p + 64 + 4 * i);
+    return 0;
+}
+
+// Reads the intact rows of the tail (a torn or corrupt row ends it). A missing file has none.
+// *clean is 0 if anything follows them; 0 ok, -1 OOM.
+static int tail_read(const char* path, HistoryMatch** rows, uint32_t* count, int* clean) {
+    *rows = NULL;
+    *count = 0;
+    *clean = 1;
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+    long long size = file_size(f);
+    uint32_t cap = size > 0 ? (uint32_t)(size / HIST_ROW_BYTES) : 0;
+    if (cap > 0 && !(*rows = (HistoryMatch*)malloc(sizeof(HistoryMatch) * cap))) { fclose(f); return -1; }
+    uint8_t row[HIST_ROW_BYTES];
+    while (*count < cap && fread(row, HIST_ROW_BYTES, 1, f) == 1 && row_decode(row, &(*rows)[*count]) == 0) (*count)++;
+    fclose(f);
+    *clean = size == (long long)*count * HIST_ROW_BYTES;
+    return 0;
+}
+
+// Rewrites the tail with exactly these rows (none: an empty file).
+static int tail_write(const char* path, const HistoryMatch* rows, uint32_t count) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return -1;
+    uint8_t row[HIST_ROW_BYTES];
+    int ok = 1;
+    for (uint32_t i = 0; i < count && ok; ++i) {
+        row_encode(row, &rows[i]);
+        ok = fwrite(row, HIST_ROW_BYTES, 1, f) == 1;
+    }
+    return close_synced(f) == 0 && ok ? 0 : -1;
+}
+
+// ---- blocks ----
+
+typedef struct {
+    size_t match, ended_at, card_cost, pot, saved, paid, hall, buyers, cards, winner_end, mode, flags, winners;
+} BlockColumns;
+
+static BlockColumns block_columns(uint32_t n) {
+    BlockColumns c;
+    c.match = 0;
+    c.ended_at = (size_t)n * 4;
+    c.card_cost = c.ended_at + (size_t)n * 8;
+    c.pot = c.card_cost + (size_t)n * 8;
+    c.saved = c.pot + (size_t)n * 8;
+    c.paid = c.saved + (size_t)n * 8;
+    c.hall = c.paid + (size_t)n * 8;
+    c.buyers = c.hall + (size_t)n * 4;
+    c.cards = c.buyers + (size_t)n * 4;
+    c.winner_end = c.cards + (size_t)n * 4;
+    c.mode = c.winner_end + (size_t)n * 4;
+    c.flags = c.mode + n;
+    c.winners = c.flags + n;
+    return c;
+}
+
+static size_t block_body_bytes(uint32_t n, uint32_t winners) {
+    return (size_t)n * HIST_ROW_COLUMN_BYTES + (size_t)winners * 4;
+}
+
+// Header and column body of a block holding rows[0..n). NULL on OOM.
+static uint8_t* block_encode(const HistoryMatch* rows, uint32_t n, size_t* size) {
+    uint32_t winners = 0;
+    for (uint32_t i = 0; i < n; ++i) winners += rows[i].winner_count;
+    size_t body_bytes = block_body_bytes(n, winners);
+    uint8_t* b = (uint8_t*)calloc(1, HIST_BLOCK_HEADER + body_bytes);
+    if (!b) return NULL;
+    uint8_t* body = b + HIST_BLOCK_HEADER;
+    BlockColumns c = block_columns(n);
+    uint32_t w = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        const HistoryMatch* h = &rows[i];
+        put_u32(body + c.match + 4 * i, h->match_number);
+        put_u64(body + c.ended_at + 8 * i, (uint64_t)h->ended_at);
+        put_u64(body + c.card_cost + 8 * i, (uint64_t)h->card_cost);
+        put_u64(body + c.pot + 8 * i, (uint64_t)h->pot);
+        put_u64(body + c.saved + 8 * i, (uint64_t)h->saved);
+        put_u64(body + c.paid + 8 * i, (uint64_t)h->paid);
+        put_u32(body + c.hall + 4 * i, h->hall);
+        put_u32(body + c.buyers + 4 * i, h->buyers);
+        put_u32(body + c.cards + 4 * i, h->cards);
+        body[c.mode + i] = h->mode;
+        body[c.flags + i] = h->flags;
+        for (uint32_t k = 0; k < h->winner_count; ++k, ++w) put_u32(body + c.winners + 4 * w, h->winners[k]);
+        put_u32(body + c.winner_end + 4 * i, w);
+    }
+    put_u32(b, HIST_BLOCK_MAGIC);
+    put_u32(b + 4, n);
+    put_u32(b + 8, winners);
+    put_u32(b + 12, (uint32_t)body_bytes);
+    put_u32(b + 16, rows[0].match_number);
+    put_u32(b + 20, rows[n - 1].match_number);
+    put_u64(b + 24, (uint64_t)rows[0].ended_at);
+    put_u64(b + 32, (uint64_t)rows[n - 1].ended_at);
+    put_u32(b + 40, crc32(body, body_bytes));
+    put_u32(b + 44, crc32(b, 44));
+    *size = HIST_BLOCK_HEADER + body_bytes;
+    return b;
+}
+
+static uint32_t view_match(const BlockView* v, uint32_t i) { return get_u32(v->body + 4 * i); }
+static int64_t view_time(const BlockView* v, uint32_t i) { return (int64_t)get_u64(v->body + block_columns(v->count).ended_at + 8 * i); }
+
+static void view_row(const BlockView* v, uint32_t i, HistoryMatch* h) {
+    BlockColumns c = block_columns(v->count);
+    const uint8_t* b = v->body;
+    memset(h, 0, sizeof(*h));
+    h->match_number = get_u32(b + c.match + 4 * i);
+    h->ended_at = (int64_t)get_u64(b + c.ended_at + 8 * i);
+    h->card_cost = (Money)get_u64(b + c.card_cost + 8 * i);
+    h->pot = (Money)get_u64(b + c.pot + 8 * i);
+    h->saved = (Money)get_u64(b + c.saved + 8 * i);
+    h->paid = (Money)get_u64(b + c.paid + 8 * i);
+    h->hall = get_u32(b + c.hall + 4 * i);
+    h->buyers = get_u32(b + c.buyers + 4 * i);
+    h->cards = get_u32(b + c.cards + 4 * i);
+    h->mode = b[c.mode + i];
+    h->flags = b[c.flags + i];
+    uint32_t end = get_u32(b + c.winner_end + 4 * i);
+    uint32_t start = i ? get_u32(b + c.winner_end + 4 * (i - 1)) : 0;
+    h->winner_count = end - start;
+    for (uint32_t k = 0; k < h->winner_count; ++k) h->winners[k] = get_u32(b + c.winners + 4 * (start + k));
+}
+
+// Reads and checks the block at `offset` into *buf (grown as needed). 0 ok, -1 torn or corrupt, -2 OOM.
+static int block_read(FILE* f, uint64_t offset, uint8_t** buf, size_t* cap, BlockView* v) {
+    uint8_t h[HIST_BLOCK_HEADER];
+    if (fseek(f, (long)offset, SEEK_SET) != 0 || fread(h, sizeof(h), 1, f) != 1) return -1;
+    if (get_u32(h) != HIST_BLOCK_MAGIC || get_u32(h + 44) != crc32(h, 44)) return -1;
+    uint32_t n = get_u32(h + 4), winners = get_u32(h + 8);
+    size_t body_bytes = get_u32(h + 12);
+    if (n == 0 || n > HISTORY_BLOCK_MATCHES || winners > n * HISTORY_MAX_WINNERS || body_bytes != block_body_bytes(n, winners)) return -1;
+    if (body_bytes > *cap) {
+        uint8_t* grown = (uint8_t*)realloc(*buf, body_bytes);
+        if (!grown) return -2;
+        *buf = grown;
+        *cap = body_bytes;
+    }
+    if (fread(*buf, body_bytes, 1, f) != 1 || crc32(*buf, body_bytes) != get_u32(h + 40)) return -1;
+    v->body = *buf;
+    v->count = n;
+    v->winners = winners;
+    return 0;
+}
+
+// ---- index ----
+
+static void index_free(HistIndex* idx) {
+    free(idx->blocks);
+    free(idx->postings);
+    memset(idx, 0, sizeof(*idx));
+}
+
+static int cmp_posting(const void* a, const void* b) {
+    const HistPosting* x = (const HistPosting*)a;
+    const HistPosting* y = (const HistPosting*)b;
+    if (x->player_id != y->player_id) return x->player_id < y->player_id ? -1 : 1;
+    if (x->ended_at != y->ended_at) return x->ended_at < y->ended_at ? -1 : 1;
+    return x->match_number < y->match_number ? -1 : x->match_number > y->match_number;
+}
+
+static void index_sort(HistIndex* idx) {
+    if (!idx->sorted) qsort(idx->postings, idx->posting_count, sizeof(HistPosting), cmp_posting);
+    idx->sorted = 1;
+}
+
+// Adds a sealed block found at `offset`. -1 OOM.
+static int index_add_block(HistIndex* idx, uint64_t offset, const BlockView* v) {
+    if (idx->block_count == idx->block_cap) {
+        uint32_t cap = idx->block_cap ? idx->block_cap * 2 : 64;
+        HistBlockRef* blocks = (HistBlockRef*)realloc(idx->blocks, sizeof(HistBlockRef) * cap);
+        if (!blocks) return -1;
+        idx->blocks = blocks;
+        idx->block_cap = cap;
+    }
+    if (idx->posting_count + v->winners > idx->posting_cap) {
+        uint32_t cap = idx->posting_cap ? idx->posting_cap : 1024;
+        while (cap < idx->posting_count + v->winners) cap *= 2;
+        HistPosting* postings = (HistPosting*)realloc(idx->postings, sizeof(HistPosting) * cap);
+        if (!postings) return -1;
+        idx->postings = postings;
+        idx->posting_cap = cap;
+    }
+    HistBlockRef* ref = &idx->blocks[idx->block_count++];
+    ref->offset = offset;
+    ref->first_match = view_match(v, 0);
+    ref->last_match = view_match(v, v->count - 1);
+    ref->first_time = view_time(v, 0);
+    ref->last_time = view_time(v, v->count - 1);
+    HistoryMatch h;
+    for (uint32_t i = 0; i < v->count; ++i) {
+        view_row(v, i, &h);
+        for (uint32_t k = 0; k < h.winner_count; ++k) idx->postings[idx->posting_count++] = (HistPosting){h.winners[k], h.match_number, h.ended_at};
+    }
+    if (v->winners) idx->sorted = 0;
+    idx->sealed += v->count;
+    idx->last_match = ref->last_match;
+    idx->last_time = ref->last_time;
+    return 0;
+}
+
+// Loads <base>.idx. -1 if missing or damaged (idx is left empty), -2 OOM.
+static int index_read(const char* path, HistIndex* idx) {
+    memset(idx, 0, sizeof(*idx));
+    idx->sorted = 1;
+    FILE* f = fopen(path, "rb");
+    if (!f) return -1;
+    uint8_t h[HIST_INDEX_HEADER];
+    int rc = -1;
+    if (fread(h, sizeof(h), 1, f) == 1 && get_u32(h) == HIST_INDEX_MAGIC && get_u16(h + 4) == HIST_VERSION && get_u32(h + 52) == crc32(h, 52)) {
+        uint32_t blocks = get_u32(h + 8), postings = get_u32(h + 12);
+        size_t bytes = (size_t)blocks * HIST_DIR_BYTES + (size_t)postings * HIST_POSTING_BYTES;
+        uint8_t* body = (uint8_t*)malloc(bytes ? bytes : 1);
+        idx->blocks = (HistBlockRef*)malloc(sizeof(HistBlockRef) * (blocks ? blocks : 1));
+        idx->postings = (HistPosting*)malloc(sizeof(HistPosting) * (postings ? postings : 1));
+        if (!body || !idx->blocks || !idx->postings) {
+            rc = -2;
+        } else if (fread(body, 1, bytes, f) == bytes && crc32(body, bytes) == get_u32(h + 48)) {
+            idx->block_cap = idx->block_count = blocks;
+            idx->posting_cap = idx->posting_count = postings;
+            for (uint32_t i = 0; i < blocks; ++i) {
+                const uint8_t* p = body + (size_t)i * HIST_DIR_BYTES;
+                idx->blocks[i] = (HistBlockRef){get_u64(p), get_u32(p + 8), get_u32(p + 12), (int64_t)get_u64(p + 16), (int64_t)get_u64(p + 24)};
+            }
+            for (uint32_t i = 0; i < postings; ++i) {
+                const uint8_t* p = body + (size_t)blocks * HIST_DIR_BYTES + (size_t)i * HIST_POSTING_BYTES;
+                idx->postings[i] = (HistPosting){get_u32(p), get_u32(p + 4), (int64_t)get_u64(p + 8)};
+            }
+            idx->bin_size = get_u64(h + 16);
+            idx->last_match = get_u32(h + 24);
+            idx->last_time = (int64_t)get_u64(h + 32);
+            idx->sealed = get_u64(h + 40);
+            rc = 0;
+        }
+        free(body);
+    }
+    fclose(f);
+    if (rc != 0) {
+        index_free(idx);
+        idx->sorted = 1;
+    }
+    return rc;
+}
+
+// Replaces <base>.idx (temp file + rename). -1 on I/O error or OOM.
+static int index_write(const char* path, HistIndex* idx) {
+    index_sort(idx);
+    size_t bytes = (size_t)idx->block_count * HIST_DIR_BYTES + (size_t)idx->posting_count * HIST_POSTING_BYTES;
+    uint8_t* body = (uint8_t*)malloc(bytes ? bytes : 1);
+    if (!body) return -1;
+    for (uint32_t i = 0; i < idx->block_count; ++i) {
+        uint8_t* p = body + (size_t)i * HIST_DIR_BYTES;
+        const HistBlockRef* b = &idx->blocks[i];
+        put_u64(p, b->offset);
+        put_u32(p + 8, b->first_match);
+        put_u32(p + 12, b->last_match);
+        put_u64(p + 16, (uint64_t)b->first_time);
+        put_u64(p + 24, (uint64_t)b->last_time);
+    }
+    for (uint32_t i = 0; i < idx->posting_count; ++i) {
+        uint8_t* p = body + (size_t)idx->block_count * HIST_DIR_BYTES + (size_t)i * HIST_POSTING_BYTES;
+        put_u32(p, idx->postings[i].player_id);
+        put_u32(p + 4, idx->postings[i].match_number);
+        put_u64(p + 8, (uint64_t)idx->postings[i].ended_at);
+    }
+    uint8_t h[HIST_INDEX_HEADER] = {0};
+    put_u32(h, HIST_INDEX_MAGIC);
+    put_u16(h + 4, HIST_VERSION);
+    put_u32(h + 8, idx->block_count);
+    put_u32(h + 12, idx->posting_count);
+    put_u64(h + 16, idx->bin_size);
+    put_u32(h + 24, idx->last_match);
+    put_u64(h + 32, (uint64_t)idx->last_time);
+    put_u64(h + 40, idx->sealed);
+    put_u32(h + 48, crc32(body, bytes));
+    put_u32(h + 52, crc32(h, 52));
+    char tmp[HIST_PATH_LEN + 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = fopen(tmp, "wb");
+    int ok = f && fwrite(h, sizeof(h), 1, f) == 1 && fwrite(body, 1, bytes, f) == bytes;
+    free(body);
+    if (f && close_synced(f) != 0) ok = 0;
+#ifdef _WIN32
+    if (ok) remove(path); // rename does not replace on Windows
+#endif
+    ok = ok && rename(tmp, path) == 0;
+    if (!ok) remove(tmp);
+    return ok ? 0 : -1;
+}
+
+// Loads the index and adds any blocks past its end that made it to <base>.bin (a seal cut short
+// by a crash, or a missing or damaged index rebuilt from scratch). *bin is the open block file,
+// or NULL if there is none yet. 1 if blocks were added, 0 if not, -2 OOM, -3 bad block file.
+static int index_load(const char* bin_path, const char* idx_path, HistIndex* idx, FILE** bin) {
+    if (index_read(idx_path, idx) == -2) return -2;
+    *bin = fopen(bin_path, "rb");
+    if (!*bin) {
+        if (idx->block_count) index_free(idx);
+        idx->sorted = 1;
+        return 0;
+    }
+    long long size = file_size(*bin);
+    uint8_t fh[HIST_FILE_HEADER];
+    if (size < HIST_FILE_HEADER || fread(fh, sizeof(fh), 1, *bin) != 1 || get_u32(fh) != HIST_MAGIC || get_u16(fh + 4) != HIST_VERSION) return -3;
+    if (idx->bin_size < HIST_FILE_HEADER || idx->bin_size > (uint64_t)size) {
+        // the index does not describe this file: rebuild it
+        index_free(idx);
+        idx->sorted = 1;
+        idx->bin_size = HIST_FILE_HEADER;
+    }
+    uint8_t* buf = NULL;
+    size_t cap = 0;
+    BlockView v;
+    int added = 0, rc;
+    while ((rc = block_read(*bin, idx->bin_size, &buf, &cap, &v)) == 0) {
+        if (view_match(&v, 0) <= idx->last_match && idx->block_count) break; // not a continuation
+        if (index_add_block(idx, idx->bin_size, &v) != 0) { rc = -2; break; }
+        idx->bin_size += HIST_BLOCK_HEADER + block_body_bytes(v.count, v.winners);
+        added = 1;
+    }
+    free(buf);
+    return rc == -2 ? -2 : added;
+}
+
+// Appends rows[0..n) as one block at idx->bin_size (creating the file if needed), syncs it and
+// adds it to idx; the index file is not written. -1 I/O error, -2 OOM.
+static int seal_block(const char* bin_path, HistIndex* idx, const HistoryMatch* rows, uint32_t n) {
+    size_t size;
+    uint8_t* block = block_encode(rows, n, &size);
+    if (!block) return -2;
+    FILE* f = idx->bin_size ? fopen(bin_path, "r+b") : fopen(bin_path, "wb");
+    int ok = f != NULL;
+    if (ok && idx->bin_size == 0) {
+        uint8_t fh[HIST_FILE_HEADER] = {0};
+        put_u32(fh, HIST_MAGIC);
+        put_u16(fh + 4, HIST_VERSION);
+        put_u32(fh + 8, HISTORY_BLOCK_MATCHES);
+        ok = fwrite(fh, sizeof(fh), 1, f) == 1;
+        idx->bin_size = HIST_FILE_HEADER;
+    }
+    ok = ok && fseek(f, (long)idx->bin_size, SEEK_SET) == 0 && fwrite(block, size, 1, f) == 1;
+    if (f && close_synced(f) != 0) ok = 0;
+    int rc = ok ? 0 : -1;
+    if (ok) {
+        BlockView v = {block + HIST_BLOCK_HEADER, n, get_u32(block + 8)};
+        if (index_add_block(idx, idx->bin_size, &v) != 0) rc = -2;
+        else idx->bin_size += size;
+    }
+    free(block);
+    return rc;
+}
+
+// ---- appending ----
+
+// Adds one finished match; the caller fills everything but the clamped time.
+static int history_append(const char* base, HistoryMatch* h) {
+    char bin_path[HIST_PATH_LEN], idx_path[HIST_PATH_LEN], tail_path[HIST_PATH_LEN];
+    if (hist_path(bin_path, base, ".bin") || hist_path(idx_path, base, ".idx") || hist_path(tail_path, base, ".tail")) return -1;
+    HistoryMatch* rows;
+    uint32_t n;
+    int clean;
+    if (tail_read(tail_path, &rows, &n, &clean) != 0) return -1;
+    HistIndex idx;
+    FILE* bin = NULL;
+    int loaded = 0, rc = 0;
+    uint32_t last_match = 0;
+    int64_t last_time = 0;
+    if (n > 0) {
+        last_match = rows[n - 1].match_number;
+        last_time = rows[n - 1].ended_at;
+    } else {
+        // empty tail: the index is current up to its last seal
+        if (index_load(bin_path, idx_path, &idx, &bin) < 0) { free(rows); if (bin) fclose(bin); index_free(&idx); return -1; }
+        loaded = 1;
+        last_match = idx.last_match;
+        last_time = idx.last_time;
+    }
+    // match numbers key the index, so they only grow; times never run backwards
+    if (h->match_number <= last_match) rc = -2;
+    if (h->ended_at < last_time) h->ended_at = last_time;
+
+    if (rc == 0 && n + 1 < HISTORY_BLOCK_MATCHES) {
+        // a torn row from a crash is dropped by rewriting the intact ones first
+        if (!clean && tail_write(tail_path, rows, n) != 0) rc = -1;
+        uint8_t row[HIST_ROW_BYTES];
+        row_encode(row, h);
+        FILE* f = rc == 0 ? fopen(tail_path, "ab") : NULL;
+        if (!f || fwrite(row, HIST_ROW_BYTES, 1, f) != 1) rc = -1;
+        if (f && fclose(f) != 0) rc = -1;
+    } else if (rc == 0) {
+        // the block is full: seal the rows not sealed already, then empty the tail
+        if (!loaded) {
+            if (index_load(bin_path, idx_path, &idx, &bin) < 0) rc = -1;
+            loaded = 1;
+        }
+        if (bin) { fclose(bin); bin = NULL; }
+        HistoryMatch* grown = rc == 0 ? (HistoryMatch*)realloc(rows, sizeof(HistoryMatch) * (n + 1)) : NULL;
+        if (rc == 0 && !grown) rc = -1;
+        if (rc == 0) {
+            rows = grown;
+            rows[n++] = *h;
+            uint32_t skip = 0;
+            while (skip < n && rows[skip].match_number <= idx.last_match) skip++;
+            if ((skip < n && seal_block(bin_path, &idx, rows + skip, n - skip) != 0) || index_write(idx_path, &idx) != 0 || tail_write(tail_path, NULL, 0) != 0) rc = -1;
+        }
+    }
+    if (bin) fclose(bin);
+    if (loaded) index_free(&idx);
+    free(rows);
+    return rc;
+}
+
+int persist_append_match(const char* base, const Match* m) {
+    HistoryMatch h;
+    memset(&h, 0, sizeof(h));
+    h.match_number = m->match_number;
+    h.mode = (uint8_t)m->mode;
+    h.hall = m->hall;
+    h.ended_at = (int64_t)time(NULL);
+    h.card_cost = m->card_cost;
+    h.buyers = m->entry_count;
+    for (uint32_t e = 0; e < m->entry_count; ++e) h.cards += m->entries[e].cards;
+    // every card sold at the match's cost; m->pot is cleared by a full house payout
+    h.pot = m->card_cost * (Money)h.cards;
+    h.saved = m->saved_for_fullhouse;
+    h.paid = m->paid_out;
+    h.winner_count = m->winner_count;
+    memcpy(h.winners, m->winners, sizeof(uint32_t) * m->winner_count);
+    return history_append(base, &h);
+}
+
+// ---- queries ----
+
+MatchHistory* persist_history_open(const char* base) {
+    char bin_path[HIST_PATH_LEN], idx_path[HIST_PATH_LEN], tail_path[HIST_PATH_LEN];
+    if (hist_path(bin_path, base, ".bin") || hist_path(idx_path, base, ".idx") || hist_path(tail_path, base, ".tail")) return NULL;
+    MatchHistory* h = (MatchHistory*)calloc(1, sizeof(MatchHistory));
+    if (!h) return NULL;
+    h->cached = UINT32_MAX;
+    int clean;
+    if (index_load(bin_path, idx_path, &h->idx, &h->bin) < 0 || tail_read(tail_path, &h->tail, &h->tail_count, &clean) != 0) {
+        persist_history_close(h);
+        return NULL;
+    }
+    index_sort(&h->idx);
+    // rows a crash left behind after they were sealed
+    uint32_t skip = 0;
+    while (skip < h->tail_count && h->tail[skip].match_number <= h->idx.last_match) skip++;
+    memmove(h->tail, h->tail + skip, sizeof(HistoryMatch) * (h->tail_count - skip));
+    h->tail_count -= skip;
+    return h;
+}
+
+void persist_history_close(MatchHistory* h) {
+    if (!h) return;
+    if (h->bin) fclose(h->bin);
+    index_free(&h->idx);
+    free(h->tail);
+    free(h->block);
+    free(h);
+}
+
+uint64_t persist_history_count(const MatchHistory* h) {
+    return h->idx.sealed + h->tail_count;
+}
+
+// Block b of the directory, read once and kept for the next query. 0 ok, -1 unreadable.
+static int load_block(MatchHistory* h, uint32_t b) {
+    if (h->cached == b) return 0;
+    h->cached = UINT32_MAX;
+    if (!h->bin || block_read(h->bin, h->idx.blocks[b].offset, &h->block, &h->block_cap, &h->view) != 0) return -1;
+    h->cached = b;
+    return 0;
+}
+
+int persist_history_find(MatchHistory* h, uint32_t match_number, HistoryMatch* out) {
+    if (match_number > h->idx.last_match || h->idx.block_count == 0) {
+        for (uint32_t i = 0; i < h->tail_count; ++i)
+            if (h->tail[i].match_number == match_number) { *out = h->tail[i]; return 0; }
+        return -1;
+    }
+    // first block whose last match is >= match_number
+    uint32_t lo = 0, hi = h->idx.block_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (h->idx.blocks[mid].last_match < match_number) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == h->idx.block_count || h->idx.blocks[lo].first_match > match_number) return -1;
+    if (load_block(h, lo) != 0) return -2;
+    uint32_t a = 0, z = h->view.count;
+    while (a < z) {
+        uint32_t mid = a + (z - a) / 2;
+        if (view_match(&h->view, mid) < match_number) a = mid + 1;
+        else z = mid;
+    }
+    if (a == h->view.count || view_match(&h->view, a) != match_number) return -1;
+    view_row(&h->view, a, out);
+    return 0;
+}
+
+int persist_history_between(MatchHistory* h, int64_t from, int64_t to, HistoryFn fn, void* ctx) {
+    int visited = 0;
+    // first block that ends at or after `from`
+    uint32_t lo = 0, hi = h->idx.block_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (h->idx.blocks[mid].last_time < from) lo = mid + 1;
+        else hi = mid;
+    }
+    HistoryMatch m;
+    for (uint32_t b = lo; b < h->idx.block_count && h->idx.blocks[b].first_time < to; ++b) {
+        if (load_block(h, b) != 0) return -2;
+        uint32_t a = 0, z = h->view.count;
+        while (a < z) {
+            uint32_t mid = a + (z - a) / 2;
+            if (view_time(&h->view, mid) < from) a = mid + 1;
+            else z = mid;
+        }
+        for (; a < h->view.count && view_time(&h->view, a) < to; ++a) {
+            view_row(&h->view, a, &m);
+            visited++;
+            if (fn(ctx, &m) != 0) return visited;
+        }
+    }
+    for (uint32_t i = 0; i < h->tail_count; ++i) {
+        if (h->tail[i].ended_at < from || h->tail[i].ended_at >= to) continue;
+        visited++;
+        if (fn(ctx, &h->tail[i]) != 0) break;
+    }
+    return visited;
+}
+
+int persist_history_player_wins(MatchHistory* h, uint32_t player_id, int64_t from, int64_t to, HistoryFn fn, void* ctx) {
+    int visited = 0;
+    const HistPosting* p = h->idx.postings;
+    uint32_t lo = 0, hi = h->idx.posting_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (p[mid].player_id < player_id || (p[mid].player_id == player_id && p[mid].ended_at < from)) lo = mid + 1;
+        else hi = mid;
+    }
+    HistoryMatch m;
+    for (; lo < h->idx.posting_count && p[lo].player_id == player_id && p[lo].ended_at < to; ++lo) {
+        int rc = persist_history_find(h, p[lo].match_number, &m);
+        if (rc == -2) return -2;
+        if (rc != 0) continue;
+        visited++;
+        if (fn(ctx, &m) != 0) return visited;
+    }
+    for (uint32_t i = 0; i < h->tail_count; ++i) {
+        const HistoryMatch* t = &h->tail[i];
+        if (t->ended_at < from || t->ended_at >= to) continue;
+        for (uint32_t k = 0; k < t->winner_count; ++k) {
+            if (t->winners[k] != player_id) continue;
+            visited++;
+            if (fn(ctx, t) != 0) return visited;
+            break;
+        }
+    }
+    return visited;
+}
+
+// ---- converting matches.csv ----
+
+typedef struct {
+    uint32_t match_number;
+    uint32_t buyers;
+    uint32_t cards;
+} LedgerTotal;
+
+static int cmp_ledger_total(const void* a, const void* b) {
+    uint32_t x = ((const LedgerTotal*)a)->match_number, y = ((const LedgerTotal*)b)->match_number;
+    return x < y ? -1 : x > y;
+}
+
+// Buyers and cards per match from match_ledger.csv rows `match,player,cards,spend`, sorted by match.
+static LedgerTotal* read_ledger_totals(const char* path, uint32_t* count) {
+    *count = 0;
+    FILE* f = path ? fopen(path, "r") : NULL;
+    if (!f) return NULL;
+    LedgerTotal* t = NULL;
+    uint32_t cap = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long match, player, cards;
+        if (sscanf(line, "%lu,%lu,%lu", &match, &player, &cards) != 3) continue;
+        if (*count == 0 || t[*count - 1].match_number != (uint32_t)match) {
+            if (*count == cap) {
+                uint32_t grown_cap = cap ? cap * 2 : 256;
+                LedgerTotal* grown = (LedgerTotal*)realloc(t, sizeof(LedgerTotal) * grown_cap);
+                if (!grown) break;
+                t = grown;
+                cap = grown_cap;
+            }
+            t[(*count)++] = (LedgerTotal){(uint32_t)match, 0, 0};
+        }
+        t[*count - 1].buyers++;
+        t[*count - 1].cards += (uint32_t)cards;
+    }
+    fclose(f);
+    if (t) qsort(t, *count, sizeof(LedgerTotal), cmp_ledger_total);
+    return t;
+}
+
+int persist_import_match_csv(const char* csv_path, const char* ledger_path, const char* base) {
+    char bin_path[HIST_PATH_LEN], idx_path[HIST_PATH_LEN], tail_path[HIST_PATH_LEN];
+    if (hist_path(bin_path, base, ".bin") || hist_path(idx_path, base, ".idx") || hist_path(tail_path, base, ".tail")) return -3;
+    FILE* probe = fopen(bin_path, "rb");
+    if (!probe) probe = fopen(tail_path, "rb");
+    if (probe) {
+        long long size = file_size(probe);
+        fclose(probe);
+        if (size != 0) return -2;
+    }
+    FILE* f = fopen(csv_path, "r");
+    if (!f) return -1;
+    uint32_t ledger_count;
+    LedgerTotal* ledger = read_ledger_totals(ledger_path, &ledger_count);
+    HistIndex idx;
+    memset(&idx, 0, sizeof(idx));
+    idx.sorted = 1;
+    HistoryMatch rows[HISTORY_BLOCK_MATCHES];
+    uint32_t n = 0;
+    int imported = 0, rc = 0;
+    Money pending_saved = 0; // saved by normal matches since the last full house payout
+    char line[1024];
+    while (rc == 0 && fgets(line, sizeof(line), f)) {
+        // match_number,mode,card_cost,pot,saved_for_fullhouse,winner_count,winners...
+        HistoryMatch* h = &rows[n];
+        memset(h, 0, sizeof(*h));
+        char* p = line;
+        char* end;
+        unsigned long match = strtoul(p, &end, 10);
+        if (end == p || *end != ',') continue;
+        p = end + 1;
+        long mode = strtol(p, &end, 10);
+        if (end == p || *end != ',') continue;
+        double cost = strtod(p = end + 1, &end);
+        if (end == p || *end != ',') continue;
+        double pot = strtod(p = end + 1, &end);
+        if (end == p || *end != ',') continue;
+        double saved = strtod(p = end + 1, &end);
+        if (end == p || *end != ',') continue;
+        unsigned long winners = strtoul(p = end + 1, &end, 10);
+        if (end == p || winners > HISTORY_MAX_WINNERS) continue;
+        for (uint32_t k = 0; k < winners && *end == ','; ++k) h->winners[h->winner_count++] = (uint32_t)strtoul(end + 1, &end, 10);
+        if (h->winner_count != winners) continue;
+        uint32_t last = n ? rows[n - 1].match_number : idx.last_match;
+        if ((uint32_t)match <= last) continue; // numbers restarted: keep the first run
+        h->match_number = (uint32_t)match;
+        h->mode = (uint8_t)mode;
+        h->flags = HISTORY_IMPORTED;
+        h->card_cost = money_from_units(cost);
+        h->pot = money_from_units(pot);
+        h->saved = money_from_units(saved);
+        LedgerTotal key = {h->match_number, 0, 0};
+        const LedgerTotal* lt = ledger ? (const LedgerTotal*)bsearch(&key, ledger, ledger_count, sizeof(LedgerTotal), cmp_ledger_total) : NULL;
+        if (lt) {
+            h->buyers = lt->buyers;
+            h->cards = lt->cards;
+            h->pot = h->card_cost * (Money)lt->cards; // the CSV wrote 0 for a full house pot
+        }
+        if (h->mode == GAME_FULL_HOUSE) {
+            h->paid = h->winner_count ? pending_saved + h->pot : 0;
+            if (h->winner_count) pending_saved = 0;
+        } else {
+            h->paid = h->winner_count ? h->pot - h->saved : 0;
+            pending_saved += h->saved;
+        }
+        imported++;
+        if (++n == HISTORY_BLOCK_MATCHES) {
+            if (seal_block(bin_path, &idx, rows, n) != 0) rc = -3;
+            n = 0;
+        }
+    }
+    fclose(f);
+    free(ledger);
+    if (rc == 0 && idx.block_count && index_write(idx_path, &idx) != 0) rc = -3;
+    if (rc == 0 && tail_write(tail_path, rows, n) != 0) rc = -3;
+    index_free(&idx);
+    return rc == 0 ? imported : rc;
+}
@@ -0,0 +1,358 @@
+// Bulk text input: the player import CSV and the transaction log (transactions.csv). Files are
+// mapped and scanned in place; fields point into the mapping and are never copied, except
+// quoted names, which are unescaped into the roster. Lines are split with one pass that finds
+// the next ',' or '\n' sixteen bytes at a time where SSE2 is available.
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // pthread_rwlock_t (platform.h)
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "persist.h"
+#include "bingo.h"
+#include "config.h"
+#include "platform.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMPORT_SSE2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+static unsigned first_bit(unsigned v) { unsigned long i; _BitScanForward(&i, v); return (unsigned)i; }
+#else
+static unsigned first_bit(unsigned v) { return (unsigned)__builtin_ctz(v); }
+#endif
+#endif
+
+#define PLAYER_FIELDS 3                 // name,balance and one more to catch extra columns
+#define IMPORT_UNITS_MAX 1000000000000000ULL // amounts up to 1e15 units, as the batch commands accept
+
+#ifdef _WIN32
+static int i_open(const char* path) { return _open(path, _O_RDONLY | _O_BINARY); }
+static long long i_size(int fd) { return _lseeki64(fd, 0, SEEK_END); }
+static long long i_pread(int fd, void* p, size_t n, long long off) { return _lseeki64(fd, off, SEEK_SET) < 0 ? -1 : _read(fd, p, (unsigned)n); }
+static int i_close(int fd) { return _close(fd); }
+#else
+static int i_open(const char* path) { return open(path, O_RDONLY); }
+static long long i_size(int fd) { return (long long)lseek(fd, 0, SEEK_END); }
+static long long i_pread(int fd, void* p, size_t n, long long off) { return (long long)pread(fd, p, n, (off_t)off); }
+static int i_close(int fd) { return close(fd); }
+#endif
+
+// ---- mapped file ----
+
+typedef struct {
+    const char* data;
+    size_t size;
+    void* map;                 // plat_map_private mapping, or NULL
+    char* copy;                // the file read into memory where it cannot be mapped
+} TextFile;
+
+static int text_open(TextFile* t, const char* path) {
+    memset(t, 0, sizeof(*t));
+    int fd = i_open(path);
+    if (fd < 0) return -1;
+    long long size = i_size(fd);
+    int rc = size < 0 || (unsigned long long)size > (size_t)-1 ? -1 : 0;
+    if (rc == 0 && size > 0) {
+        t->size = (size_t)size;
+        t->map = plat_map_private(fd, t->size);
+        if (t->map) {
+            t->data = (const char*)t->map;
+        } else {
+            t->copy = (char*)malloc(t->size);
+            size_t got = 0;
+            while (t->copy && got < t->size) {
+                long long n = i_pread(fd, t->copy + got, t->size - got, (long long)got);
+                if (n <= 0) break;
+                got += (size_t)n;
+            }
+            if (!t->copy || got != t->size) { free(t->copy); t->copy = NULL; rc = -1; }
+            t->data = t->copy;
+        }
+    }
+    i_close(fd);
+    return rc;
+}
+
+static void text_close(TextFile* t) {
+    if (t->map) plat_unmap(t->map, t->size);
+    free(t->copy);
+    memset(t, 0, sizeof(*t));
+}
+
+// ---- line scanner ----
+
+typedef struct {
+    const char* p;
+    uint32_t len;
+} Field;
+
+typedef struct {
+    const char* p;
+    const char* end;
+    uint64_t line;             // number of the line last returned, from 1
+} Scanner;
+
+// First ',' or '\n' in [p, end), or end.
+static const char* next_delim(const char* p, const char* end) {
+#ifdef IMPORT_SSE2
+    const __m128i comma = _mm_set1_epi8(','), nl = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, comma), _mm_cmpeq_epi8(v, nl)));
+        if (m) return p + first_bit(m);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != ',' && *p != '\n') ++p;
+    return p;
+}
+
+// Splits the next line into fields. A field starting with '"' runs to its closing quote
+// ("" inside is an escaped quote). Past `max` fields the last one keeps the rest of the line,
+// commas included. Returns the field count (an empty line has one empty field), 0 at the end
+// of the file, -1 for an unterminated quote; the scanner then continues at the next line.
+static int scan_line(Scanner* s, Field* f, int max) {
+    if (s->p >= s->end) return 0;
+    s->line++;
+    const char* p = s->p;
+    int n = 0, bad = 0;
+    for (;;) {
+        const char* start = p;
+        const char* q;
+        if (p < s->end && *p == '"') {
+            q = p + 1;
+            for (;;) {
+                while (q < s->end && *q != '"' && *q != '\n') ++q;
+                if (q + 1 < s->end && q[0] == '"' && q[1] == '"') { q += 2; continue; }
+                break;
+            }
+            if (q >= s->end || *q != '"') bad = 1;
+            else q = next_delim(q + 1, s->end);
+        } else {
+            q = n == max - 1 ? (const char*)memchr(p, '\n', (size_t)(s->end - p)) : next_delim(p, s->end);
+            if (!q) q = s->end;
+        }
+        if (bad) break;
+        const char* stop = q;
+        if ((q == s->end || *q == '\n') && stop > start && stop[-1] == '\r') --stop;
+        if (n < max) { f[n].p = start; f[n].len = (uint32_t)(stop - start); }
+        ++n;
+        if (q == s->end || *q == '\n') { p = q; break; }
+        p = q + 1;
+    }
+    if (bad) {
+        const char* nl = (const char*)memchr(p, '\n', (size_t)(s->end - p));
+        s->p = nl ? nl + 1 : s->end;
+        return -1;
+    }
+    s->p = p < s->end ? p + 1 : s->end;
+    return n;
+}
+
+static int field_is(const Field* f, const char* s) {
+    size_t n = strlen(s);
+    return f->len == n && memcmp(f->p, s, n) == 0;
+}
+
+static int field_u64(const Field* f, uint64_t max, uint64_t* out) {
+    if (f->len == 0 || f->len > 20) return -1;
+    uint64_t v = 0;
+    for (uint32_t i = 0; i < f->len; ++i) {
+        unsigned d = (unsigned)(f->p[i] - '0');
+        if (d > 9 || v > (max - d) / 10) return -1;
+        v = v * 10 + d;
+    }
+    *out = v;
+    return 0;
+}
+
+static int field_u32(const Field* f, uint32_t* out) {
+    uint64_t v;
+    if (field_u64(f, UINT32_MAX, &v) != 0) return -1;
+    *out = (uint32_t)v;
+    return 0;
+}
+
+// Units with at most two decimals ("12", "-3.5", "0.25") as exact cents.
+static int field_money(const Field* f, Money* out) {
+    Field w = *f;
+    int neg = w.len && w.p[0] == '-';
+    if (neg) { w.p++; w.len--; }
+    const char* dot = (const char*)memchr(w.p, '.', w.len);
+    uint32_t whole_len = dot ? (uint32_t)(dot - w.p) : w.len;
+    uint32_t frac_len = dot ? w.len - whole_len - 1 : 0;
+    if (frac_len > 2 || (dot && frac_len == 0)) return -1;
+    Field whole = { w.p, whole_len };
+    uint64_t units, frac = 0;
+    if (field_u64(&whole, IMPORT_UNITS_MAX, &units) != 0) return -1;
+    for (uint32_t i = 0; i < frac_len; ++i) {
+        unsigned d = (unsigned)(dot[1 + i] - '0');
+        if (d > 9) return -1;
+        frac = frac * 10 + d;
+    }
+    if (frac_len == 1) frac *= 10;
+    Money cents = (Money)(units * MONEY_SCALE + frac);
+    *out = neg ? -cents : cents;
+    return 0;
+}
+
+// `key=value` with the given key; value into *v.
+static int field_value(const Field* f, const char* key, Field* v) {
+    size_t n = strlen(key);
+    if (f->len <= n || memcmp(f->p, key, n) != 0 || f->p[n] != '=') return -1;
+    v->p = f->p + n + 1;
+    v->len = f->len - (uint32_t)n - 1;
+    return 0;
+}
+
+static void report(CsvErrorFn on_error, void* ctx, uint64_t line, const char* reason) {
+    if (on_error) on_error(ctx, line, reason);
+}
+
+// ---- player import ----
+
+// Name field: quoted names are unescaped; out gets at most PLAYER_NAME_LEN - 1 bytes.
+static const char* player_name(const Field* f, char* out) {
+    const char* p = f->p;
+    uint32_t len = f->len;
+    if (len == 0) return "empty name";
+    size_t n = 0;
+    if (p[0] == '"') {
+        if (len < 2 || p[len - 1] != '"') return "bad quoting";
+        for (uint32_t i = 1; i + 1 < len; ++i) {
+            if (p[i] == '"' && ++i + 1 >= len) return "bad quoting";
+            if (n == PLAYER_NAME_LEN - 1) return "name too long";
+            out[n++] = p[i];
+        }
+        if (n == 0) return "empty name";
+    } else {
+        if (memchr(p, '"', len)) return "bad quoting";
+        if (len > PLAYER_NAME_LEN - 1) return "name too long";
+        memcpy(out, p, len);
+        n = len;
+    }
+    if (memchr(out, '\0', n)) return "NUL in name";
+    out[n] = '\0';
+    return NULL;
+}
+
+// Checks one data row; NULL if it is valid.
+static const char* player_row(const Field* f, int n, char* name, Money* balance) {
+    if (n < 0) return "unterminated quote";
+    if (n != 2) return "expected name,balance";
+    const char* err = player_name(&f[0], name);
+    if (err) return err;
+    if (field_money(&f[1], balance) != 0) return "bad balance";
+    if (*balance < 0) return "negative balance";
+    return NULL;
+}
+
+int persist_import_players_csv(const char* path, Roster* r, CsvErrorFn on_error, void* ctx, uint32_t* first_id) {
+    TextFile t;
+    if (text_open(&t, path) != 0) return -1;
+    Scanner s = { t.data, t.data + t.size, 0 };
+    Field f[PLAYER_FIELDS];
+    char name[PLAYER_NAME_LEN];
+    Money balance;
+    // pass 1: every row is checked before the roster changes
+    uint64_t rows = 0, bad = 0;
+    int n;
+    while ((n = scan_line(&s, f, PLAYER_FIELDS)) != 0) {
+        if (n == 1 && f[0].len == 0) continue; // blank line
+        if (s.line == 1 && n == 2 && field_is(&f[0], "name")) continue; // header
+        const char* err = player_row(f, n, name, &balance);
+        if (err) { report(on_error, ctx, s.line, err); ++bad; continue; }
+        ++rows;
+    }
+    int rc = 0;
+    if (bad) rc = -2;
+    else if (rows > cfg_get_max_players() || r->count > cfg_get_max_players() - rows) rc = -3;
+    else if (rows && roster_reserve(r, r->slot_count + (uint32_t)rows) != 0) rc = -4;
+    if (rc != 0) { text_close(&t); return rc; }
+    // pass 2: add them
+    if (first_id) *first_id = r->next_id;
+    s.p = t.data;
+    s.line = 0;
+    uint32_t added = 0;
+    while (added < rows && (n = scan_line(&s, f, PLAYER_FIELDS)) != 0) {
+        if (n == 1 && f[0].len == 0) continue;
+        if (s.line == 1 && n == 2 && field_is(&f[0], "name")) continue;
+        player_row(f, n, name, &balance);
+        if (engine_add_player(r, name, balance) < 0) { rc = -4; break; }
+        ++added;
+    }
+    text_close(&t);
+    return rc != 0 ? rc : (int)added;
+}
+
+// ---- transaction log ----
+
+#define TXN_FIELDS 6 // type, time, then the details: type again, id, and two more (an add row's name keeps the rest)
+
+static TxnType transaction_type(const Field* f) {
+    if (field_is(f, "add")) return TXN_ADD;
+    if (field_is(f, "remove")) return TXN_REMOVE;
+    if (field_is(f, "recharge")) return TXN_RECHARGE;
+    if (field_is(f, "buy")) return TXN_BUY;
+    return TXN_OTHER;
+}
+
+// Decodes `type,time,details`. The details of the rows that move money repeat the type, then
+// hold `key=value` fields. NULL if the row is valid.
+static const char* transaction_row(const Field* f, int n, TxnRow* row) {
+    uint64_t at;
+    Field v;
+    if (n < 0) return "unterminated quote";
+    if (n < 2 || field_u64(&f[1], INT64_MAX, &at) != 0) return "bad time";
+    row->at = (int64_t)at;
+    row->type = transaction_type(&f[0]);
+    if (row->type == TXN_OTHER) return NULL;
+    if (n < 4 || transaction_type(&f[2]) != row->type) return "details do not match the type";
+    if (field_value(&f[3], "id", &v) != 0 || field_u32(&v, &row->player_id) != 0 || row->player_id == 0) return "bad id";
+    switch (row->type) {
+        case TXN_REMOVE:
+            return n == 4 ? NULL : "expected remove,id";
+        case TXN_RECHARGE:
+            if (n != 5 || field_value(&f[4], "amount", &v) != 0 || field_money(&v, &row->amount) != 0 || row->amount <= 0) return "bad amount";
+            return NULL;
+        case TXN_BUY:
+            if (n != 6 || field_value(&f[4], "count", &v) != 0 || field_u32(&v, &row->count) != 0 || row->count == 0) return "bad count";
+            if (field_value(&f[5], "cost", &v) != 0 || field_money(&v, &row->amount) != 0 || row->amount < 0) return "bad cost";
+            return NULL;
+        default: // TXN_ADD
+            if (n != 6 || field_value(&f[4], "balance", &v) != 0 || field_money(&v, &row->amount) != 0 || row->amount < 0) return "bad balance";
+            if (field_value(&f[5], "name", &v) != 0 || v.len == 0 || v.len > PLAYER_NAME_LEN - 1 || memchr(v.p, '\0', v.len)) return "bad name";
+            row->name = v.p;
+            row->name_len = v.len;
+            return NULL;
+    }
+}
+
+int persist_read_transactions(const char* path, TxnFn fn, void* ctx, CsvErrorFn on_error, void* ectx) {
+    TextFile t;
+    if (text_open(&t, path) != 0) return -1;
+    Scanner s = { t.data, t.data + t.size, 0 };
+    Field f[TXN_FIELDS];
+    int visited = 0, n;
+    while ((n = scan_line(&s, f, TXN_FIELDS)) != 0) {
+        if (n == 1 && f[0].len == 0) continue;
+        TxnRow row;
+        memset(&row, 0, sizeof(row));
+        row.line = s.line;
+        const char* err = transaction_row(f, n, &row);
+        if (err) { report(on_error, ectx, s.line, err); continue; }
+        ++visited;
+        if (fn && fn(ctx, &row) != 0) break;
+    }
+    text_close(&t);
+    return visited;
+}
@@ -0,0 +1,401 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // fsync, ftruncate, strnlen
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "journal.h"
+#include "bingo.h"
+#include "persist.h"
+#include "platform.h"
+
+#define JOURNAL_MAGIC 0x42474F4A /* 'BGOJ' */
+#define JOURNAL_VERSION 1
+#define JOURNAL_HEADER_SIZE 16
+#define JOURNAL_BUFFER_SIZE (64 * 1024)
+// seq(8) type(1) reserved(3) match(4) player(4) count(4) flags(4) amount(8) aux(8) name_len(2)
+#define RECORD_FIXED_SIZE 46
+#define RECORD_MAX_SIZE (8 + RECORD_FIXED_SIZE + PLAYER_NAME_LEN)
+
+struct Journal {
+    plat_mutex lock;           // appends come from the engine thread, trims from the persistence writer
+    int fd;
+    long long file_size;       // bytes in the file (header + written records)
+    char* path;
+    long long trimmed;         // record bytes dropped by trims; marks hold logical offsets
+    uint64_t base_seq;         // sequence before the first record in the file
+    uint64_t last_seq;         // last sequence appended (buffered or written)
+    uint8_t* buf;              // records waiting for journal_sync
+    size_t used;
+    uint32_t unsynced;         // records written but not yet fsynced
+    int failed;                // sticky I/O error, reported by the next sync
+};
+
+#ifdef _WIN32
+static int j_open(const char* path) { return _open(path, _O_RDWR | _O_CREAT | _O_BINARY, 0644); }
+static long long j_read(int fd, void* p, size_t n) { return _read(fd, p, (unsigned)n); }
+static long long j_write(int fd, const void* p, size_t n) { return _write(fd, p, (unsigned)n); }
+static int j_fsync(int fd) { return _commit(fd); }
+static int j_truncate(int fd, long long len) { return _chsize_s(fd, len) == 0 ? 0 : -1; }
+static long long j_seek(int fd, long long off) { return _lseeki64(fd, off, SEEK_SET); }
+static int j_close(int fd) { return _close(fd); }
+static int j_create(const char* path) { return _open(path, _O_RDWR | _O_CREAT | _O_TRUNC | _O_BINARY, 0644); }
+static int j_replace(const char* from, const char* to) { return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : -1; }
+#else
+static int j_open(const char* path) { return open(path, O_RDWR | O_CREAT, 0644); }
+static long long j_read(int fd, void* p, size_t n) { return (long long)read(fd, p, n); }
+static long long j_write(int fd, const void* p, size_t n) { return (long long)write(fd, p, n); }
+static int j_fsync(int fd) { return fsync(fd); }
+static int j_truncate(int fd, long long len) { return ftruncate(fd, (off_t)len); }
+static long long j_seek(int fd, long long off) { return (long long)lseek(fd, (off_t)off, SEEK_SET); }
+static int j_close(int fd) { return close(fd); }
+static int j_create(const char* path) { return open(path, O_RDWR | O_CREAT | O_TRUNC, 0644); }
+static int j_replace(const char* from, const char* to) { return rename(from, to); }
+#endif
+
+static uint32_t CRC_TABLE[256];
+
+static uint32_t crc32(const uint8_t* p, size_t n) {
+    if (!CRC_TABLE[1]) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            CRC_TABLE[i] = c;
+        }
+    }
+    uint32_t c = 0xFFFFFFFFu;
+    while (n--) c = CRC_TABLE[(c ^ *p++) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+// Explicit little-endian encoding so journals move between machines.
+static void put_u16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put_u32(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; ++i) p[i] = (uint8_t)(v >> (8 * i)); }
+static void put_u64(uint8_t* p, uint64_t v) { for (int i = 0; i < 8; ++i) p[i] = (uint8_t)(v >> (8 * i)); }
+static uint16_t get_u16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t get_u32(const uint8_t* p) { uint32_t v = 0; for (int i = 3; i >= 0; --i) v = (v << 8) | p[i]; return v; }
+static uint64_t get_u64(const uint8_t* p) { uint64_t v = 0; for (int i = 7; i >= 0; --i) v = (v << 8) | p[i]; return v; }
+
+typedef struct {
+    uint64_t seq;
+    EngineEvent ev;
+    char name[PLAYER_NAME_LEN];
+} JournalRecord;
+
+// Reads one record. Returns 1 on success, 0 at end of file or at a torn/corrupt record.
+static int read_record(FILE* f, JournalRecord* rec) {
+    uint8_t frame[RECORD_MAX_SIZE];
+    if (fread(frame, 8, 1, f) != 1) return 0;
+    uint32_t len = get_u32(frame);
+    uint32_t crc = get_u32(frame + 4);
+    if (len < RECORD_FIXED_SIZE || len > RECORD_MAX_SIZE - 8) return 0;
+    uint8_t* p = frame + 8;
+    if (fread(p, len, 1, f) != 1) return 0;
+    if (crc32(p, len) != crc) return 0;
+    uint16_t name_len = get_u16(p + 44);
+    if (name_len >= PLAYER_NAME_LEN || RECORD_FIXED_SIZE + (uint32_t)name_len != len) return 0;
+    memset(rec, 0, sizeof(*rec));
+    rec->seq = get_u64(p);
+    rec->ev.type = (EngineEventType)p[8];
+    rec->ev.match_number = get_u32(p + 12);
+    rec->ev.player_id = get_u32(p + 16);
+    rec->ev.count = get_u32(p + 20);
+    rec->ev.flags = get_u32(p + 24);
+    rec->ev.amount = (Money)get_u64(p + 28);
+    rec->ev.aux = (int64_t)get_u64(p + 36);
+    memcpy(rec->name, p + RECORD_FIXED_SIZE, name_len);
+    rec->ev.name = rec->name;
+    return 1;
+}
+
+static int read_header(FILE* f, uint64_t* base_seq) {
+    uint8_t h[JOURNAL_HEADER_SIZE];
+    if (fread(h, sizeof(h), 1, f) != 1) return -1;
+    if (get_u32(h) != JOURNAL_MAGIC || get_u16(h + 4) != JOURNAL_VERSION) return -1;
+    *base_seq = get_u64(h + 8);
+    return 0;
+}
+
+// Encodes one record (length, CRC, body) at `frame`; returns its size.
+static size_t encode_record(uint8_t* frame, uint64_t seq, const EngineEvent* ev) {
+    size_t name_len = (ev->type == EV_PLAYER_ADD && ev->name) ? strnlen(ev->name, PLAYER_NAME_LEN - 1) : 0;
+    size_t len = RECORD_FIXED_SIZE + name_len;
+    uint8_t* p = frame + 8;
+    put_u64(p, seq);
+    p[8] = (uint8_t)ev->type; p[9] = p[10] = p[11] = 0;
+    put_u32(p + 12, ev->match_number);
+    put_u32(p + 16, ev->player_id);
+    put_u32(p + 20, ev->count);
+    put_u32(p + 24, ev->flags);
+    put_u64(p + 28, (uint64_t)ev->amount);
+    put_u64(p + 36, (uint64_t)ev->aux);
+    put_u16(p + 44, (uint16_t)name_len);
+    if (name_len) memcpy(p + RECORD_FIXED_SIZE, ev->name, name_len);
+    put_u32(frame, (uint32_t)len);
+    put_u32(frame + 4, crc32(p, len));
+    return 8 + len;
+}
+
+static int write_header(int fd, uint64_t base_seq) {
+    uint8_t h[JOURNAL_HEADER_SIZE] = {0};
+    put_u32(h, JOURNAL_MAGIC);
+    put_u16(h + 4, JOURNAL_VERSION);
+    put_u64(h + 8, base_seq);
+    if (j_seek(fd, 0) != 0 || j_write(fd, h, sizeof(h)) != (long long)sizeof(h)) return -1;
+    return 0;
+}
+
+Journal* journal_open(const char* path, uint64_t base_seq) {
+    // Scan existing records to find the valid end and the last sequence number.
+    long long valid_end = 0;
+    uint64_t last_seq = base_seq;
+    FILE* f = fopen(path, "rb");
+    if (f) {
+        if (read_header(f, &base_seq) == 0) {
+            JournalRecord rec;
+            last_seq = base_seq;
+            valid_end = JOURNAL_HEADER_SIZE;
+            while (read_record(f, &rec)) { last_seq = rec.seq; valid_end = ftell(f); }
+        }
+        fclose(f);
+    }
+    Journal* j = (Journal*)calloc(1, sizeof(Journal));
+    if (!j) return NULL;
+    j->buf = (uint8_t*)malloc(JOURNAL_BUFFER_SIZE);
+    j->path = (char*)malloc(strlen(path) + 1);
+    j->fd = j_open(path);
+    if (!j->buf || !j->path || j->fd < 0) {
+        if (j->fd >= 0) j_close(j->fd);
+        free(j->buf); free(j->path); free(j);
+        return NULL;
+    }
+    strcpy(j->path, path);
+    plat_mutex_init(&j->lock);
+    j->base_seq = base_seq;
+    j->last_seq = last_seq;
+    j->file_size = valid_end ? valid_end : JOURNAL_HEADER_SIZE;
+    int ok = valid_end ? j_truncate(j->fd, valid_end) == 0 : (j_truncate(j->fd, 0) == 0 && write_header(j->fd, base_seq) == 0);
+    if (!ok || j_seek(j->fd, valid_end ? valid_end : JOURNAL_HEADER_SIZE) < 0) { journal_close(j); return NULL; }
+    return j;
+}
+
+// The helpers below expect j->lock to be held.
+static int write_all(Journal* j, const uint8_t* p, size_t n) {
+    size_t off = 0;
+    while (off < n) {
+        long long w = j_write(j->fd, p + off, n - off);
+        if (w <= 0) { j->failed = 1; return -1; }
+        off += (size_t)w;
+    }
+    return 0;
+}
+
+static int write_buffer(Journal* j) {
+    if (write_all(j, j->buf, j->used) != 0) return -1;
+    j->file_size += (long long)j->used;
+    j->used = 0;
+    return 0;
+}
+
+static int sync_locked(Journal* j) {
+    if (j->used && write_buffer(j) != 0) return -1;
+    if (j->unsynced) {
+        if (j_fsync(j->fd) != 0) { j->failed = 1; return -1; }
+        j->unsynced = 0;
+    }
+    return j->failed ? -1 : 0;
+}
+
+int journal_append(Journal* j, const EngineEvent* ev) {
+    plat_mutex_lock(&j->lock);
+    if (j->used + RECORD_MAX_SIZE > JOURNAL_BUFFER_SIZE && write_buffer(j) != 0) { plat_mutex_unlock(&j->lock); return -1; }
+    j->used += encode_record(j->buf + j->used, ++j->last_seq, ev);
+    j->unsynced++;
+    plat_mutex_unlock(&j->lock);
+    return 0;
+}
+
+int journal_sync(Journal* j) {
+    plat_mutex_lock(&j->lock);
+    int rc = sync_locked(j);
+    plat_mutex_unlock(&j->lock);
+    return rc;
+}
+
+JournalMark journal_mark(Journal* j) {
+    plat_mutex_lock(&j->lock);
+    JournalMark mark;
+    mark.seq = j->last_seq;
+    mark.offset = (uint64_t)(j->trimmed + j->file_size) + j->used;
+    plat_mutex_unlock(&j->lock);
+    return mark;
+}
+
+// Rewrites the file as header(mark.seq) + the records after `mark`. The new file is built
+// beside the journal and renamed over it, so a crash leaves either the old or the new journal.
+static int trim_locked(Journal* j, JournalMark mark) {
+    if (sync_locked(j) != 0) return -1;
+    long long start = (long long)mark.offset - j->trimmed;
+    size_t plen = strlen(j->path);
+    char* tmp = (char*)malloc(plen + 5);
+    if (!tmp) return -1;
+    memcpy(tmp, j->path, plen);
+    memcpy(tmp + plen, ".tmp", 5);
+    int out = j_create(tmp);
+    int ok = out >= 0 && write_header(out, mark.seq) == 0;
+    long long src = start, dst = JOURNAL_HEADER_SIZE;
+    uint8_t chunk[16 * 1024];
+    while (ok && src < j->file_size) {
+        long long n = j->file_size - src < (long long)sizeof(chunk) ? j->file_size - src : (long long)sizeof(chunk);
+        ok = j_seek(j->fd, src) >= 0 && j_read(j->fd, chunk, (size_t)n) == n && j_write(out, chunk, (size_t)n) == n;
+        src += n; dst += n;
+    }
+    ok = ok && j_fsync(out) == 0;
+    if (out >= 0) j_close(out);
+    if (ok) {
+        j_close(j->fd); // Windows cannot replace a file that is still open
+        ok = j_replace(tmp, j->path) == 0;
+        if (!ok) remove(tmp);
+        j->fd = j_open(j->path);
+        if (j->fd < 0) ok = 0;
+    } else {
+        remove(tmp);
+    }
+    free(tmp);
+    if (ok) {
+        j->base_seq = mark.seq;
+        j->file_size = dst;
+        j->trimmed += start - JOURNAL_HEADER_SIZE;
+    }
+    if (j->fd < 0 || j_seek(j->fd, j->file_size) < 0) return -1;
+    return ok ? 0 : -1;
+}
+
+int journal_trim(Journal* j, JournalMark mark) {
+    plat_mutex_lock(&j->lock);
+    int rc = 0;
+    if (mark.seq > j->base_seq && trim_locked(j, mark) != 0) { j->failed = 1; rc = -1; }
+    plat_mutex_unlock(&j->lock);
+    return rc;
+}
+
+int journal_reset(Journal* j) {
+    return journal_trim(j, journal_mark(j));
+}
+
+uint64_t journal_last_seq(Journal* j) {
+    plat_mutex_lock(&j->lock);
+    uint64_t seq = j->last_seq;
+    plat_mutex_unlock(&j->lock);
+    return seq;
+}
+
+void journal_close(Journal* j) {
+    if (!j) return;
+    if (j->fd >= 0) { journal_sync(j); j_close(j->fd); }
+    plat_mutex_destroy(&j->lock);
+    free(j->path);
+    free(j->buf);
+    free(j);
+}
+
+void journal_event_sink(void* ctx, const EngineEvent* ev) {
+    journal_append((Journal*)ctx, ev); // errors stay sticky and surface at the next sync
+}
+
+// The match a record belongs to: a start claims its hall (or, for a hall this process
+// does not have, any idle one); later records follow the match number.
+static Match* replay_match(const EngineEvent* ev, Match* halls, uint32_t hall_count) {
+    if (ev->type == EV_MATCH_START) {
+        uint32_t hall = ev->flags >> 8;
+        if (hall < hall_count && !halls[hall].active) return &halls[hall];
+        for (uint32_t h = 0; h < hall_count; ++h) if (!halls[h].active) return &halls[h];
+        return NULL;
+    }
+    for (uint32_t h = 0; h < hall_count; ++h) {
+        if (halls[h].active && halls[h].match_number == ev->match_number) return &halls[h];
+    }
+    return NULL;
+}
+
+// The history and ledger rows of a match that ended or was cancelled before the crash. They are
+// written by the persistence writer after the journal record, so they may be missing; a match
+// already recorded is refused (-2) by both appends, so replaying twice adds nothing.
+static void replay_record_match(const JournalReplayFiles* files, const Match* m, int cancelled) {
+    if (!files) return;
+    if (!cancelled && files->matches_path) persist_append_match(files->matches_path, m);
+    if (files->ledger_path) persist_append_ledger(files->ledger_path, m, cancelled);
+}
+
+static void replay_record(const JournalRecord* rec, Roster* r, Accounting* acc, Match* halls, uint32_t hall_count,
+                          const JournalReplayFiles* files) {
+    const EngineEvent* ev = &rec->ev;
+    Match* m = NULL;
+    if (ev->type >= EV_MATCH_START) {
+        m = replay_match(ev, halls, hall_count);
+        if (!m) return;
+    }
+    switch (ev->type) {
+        case EV_PLAYER_ADD:
+            if (!engine_find_player(r, ev->player_id)) {
+                uint32_t next = r->next_id;
+                r->next_id = ev->player_id; // reproduce the original ID
+                engine_add_player(r, rec->name, ev->amount);
+                if (next > r->next_id) r->next_id = next;
+            }
+            break;
+        case EV_PLAYER_REMOVE: engine_remove_player(r, ev->player_id); break;
+        case EV_RECHARGE: engine_recharge_player(r, ev->player_id, ev->amount); break;
+        case EV_MATCH_START:
+            m->match_number = ev->match_number;
+            if (ev->match_number >= acc->next_match) acc->next_match = ev->match_number + 1;
+            m->hall = (uint32_t)(m - halls);
+            match_start(m, (GameMode)ev->count, ev->amount);
+            // rules as pinned when the match originally started
+            m->card_cost = ev->amount;
+            m->rules.saved_pot_bp = (uint32_t)ev->aux;
+            m->rules.allow_multi_winners = (uint8_t)(ev->flags & 0xff);
+            break;
+        case EV_BUY: {
+            Player* p = engine_find_player(r, ev->player_id);
+            if (p) match_buy_cards(m, r, p, ev->count);
+        } break;
+        case EV_WINNER_ADD: match_add_winner(m, r, ev->player_id); break;
+        case EV_WINNER_REMOVE: match_remove_winner(m, ev->player_id); break;
+        case EV_PAYOUT: break; // recomputed by match_end from the pinned rules
+        case EV_MATCH_END:
+            match_end(m, acc, r);
+            replay_record_match(files, m, 0);
+            break;
+        case EV_MATCH_CANCEL:
+            match_cancel(m, r);
+            replay_record_match(files, m, 1);
+            break;
+        default: break;
+    }
+}
+
+int journal_replay(const char* path, Roster* r, Accounting* acc, Match* halls, uint32_t hall_count,
+                   const JournalReplayFiles* files) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return -1;
+    uint64_t base_seq;
+    if (read_header(f, &base_seq) != 0) { fclose(f); return -1; }
+    int applied = 0;
+    JournalRecord rec;
+    while (read_record(f, &rec)) {
+        if (rec.seq <= acc->journal_seq) continue; // already in the checkpoint
+        replay_record(&rec, r, acc, halls, hall_count, files);
+        acc->journal_seq = rec.seq;
+        applied++;
+    }
+    fclose(f);
+    return applied;
+}
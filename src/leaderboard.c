@@ -0,0 +1,234 @@
+// Leaderboards: one treap per board over the live players, ordered by score, highest first,
+// then by ID. Nodes live in arrays indexed by player ID (0 = no node), so finding a player's node
+// needs no search, and a node's heap priority is a hash of its ID, so nothing is stored for it.
+// A score change removes the node and inserts it again, O(log N) expected; the top k are an
+// in-order walk from the leftmost node, O(k + log N).
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // pthread_rwlock_t (platform.h)
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include "leaderboard.h"
+#include "bingo.h"
+#include "platform.h"
+
+typedef struct {
+    int64_t score;
+    uint32_t child[2]; // 0: ranks before this node, 1: after
+    uint32_t parent;
+} BoardNode;
+
+struct Leaderboards {
+    BoardNode* nodes[BOARD_COUNT]; // capacity entries each, by player ID
+    uint32_t root[BOARD_COUNT];
+    uint32_t capacity;
+};
+
+static const char* const BOARD_NAMES[BOARD_COUNT] = {"won", "net", "cards", "wins"};
+
+const char* leaderboard_name(BoardKind kind) {
+    return (unsigned)kind < BOARD_COUNT ? BOARD_NAMES[kind] : "?";
+}
+
+int leaderboard_parse(const char* name) {
+    for (int k = 0; k < BOARD_COUNT; ++k)
+        if (strcmp(name, BOARD_NAMES[k]) == 0) return k;
+    return -1;
+}
+
+// Spend and cards are read atomically: sellers add to them under the roster read lock.
+int64_t leaderboard_score(const Player* p, BoardKind kind) {
+    Player* q = (Player*)p;
+    switch (kind) {
+        case BOARD_WON: return p->total_won;
+        case BOARD_NET: return p->total_won - plat_atomic_load64(&q->total_spent);
+        case BOARD_CARDS: return plat_atomic_load32(&q->lifetime_cards);
+        case BOARD_WINS: return p->record.wins;
+        default: return 0;
+    }
+}
+
+// Bijective mix of the ID (the murmur3 finalizer), so no two players share a priority.
+static uint32_t priority(uint32_t id) {
+    id ^= id >> 16;
+    id *= 0x85ebca6bu;
+    id ^= id >> 13;
+    id *= 0xc2b2ae35u;
+    id ^= id >> 16;
+    return id;
+}
+
+// 1 when player a ranks before player b.
+static int ranks_before(const BoardNode* n, uint32_t a, uint32_t b) {
+    return n[a].score > n[b].score || (n[a].score == n[b].score && a < b);
+}
+
+// Moves x above its parent, keeping the in-order sequence.
+static void rotate_up(BoardNode* n, uint32_t* root, uint32_t x) {
+    uint32_t p = n[x].parent;
+    uint32_t g = n[p].parent;
+    int side = n[p].child[1] == x;
+    uint32_t inner = n[x].child[!side];
+    n[p].child[side] = inner;
+    if (inner) n[inner].parent = p;
+    n[x].child[!side] = p;
+    n[p].parent = x;
+    n[x].parent = g;
+    if (!g) *root = x;
+    else n[g].child[n[g].child[1] == p] = x;
+}
+
+static void node_insert(BoardNode* n, uint32_t* root, uint32_t id) {
+    uint32_t parent = 0, cur = *root;
+    int side = 0;
+    while (cur) {
+        parent = cur;
+        side = !ranks_before(n, id, cur);
+        cur = n[cur].child[side];
+    }
+    n[id].child[0] = n[id].child[1] = 0;
+    n[id].parent = parent;
+    if (!parent) *root = id;
+    else n[parent].child[side] = id;
+    uint32_t prio = priority(id);
+    while (n[id].parent && prio > priority(n[id].parent)) rotate_up(n, root, id);
+}
+
+// Rotates the node down to a leaf, then cuts it off.
+static void node_remove(BoardNode* n, uint32_t* root, uint32_t id) {
+    for (;;) {
+        uint32_t l = n[id].child[0], r = n[id].child[1];
+        if (!l && !r) break;
+        rotate_up(n, root, !r || (l && priority(l) > priority(r)) ? l : r);
+    }
+    uint32_t p = n[id].parent;
+    if (!p) *root = 0;
+    else n[p].child[n[p].child[1] == id] = 0;
+    n[id].parent = 0;
+}
+
+int leaderboard_reserve(Leaderboards* b, uint32_t player_id) {
+    if (player_id < b->capacity) return 0;
+    uint32_t cap = b->capacity ? b->capacity : 64;
+    while (cap <= player_id) cap *= 2;
+    for (int k = 0; k < BOARD_COUNT; ++k) {
+        BoardNode* grown = (BoardNode*)realloc(b->nodes[k], (size_t)cap * sizeof(BoardNode));
+        if (!grown) return -1; // boards grown so far keep their larger size; capacity stays the smallest
+        memset(grown + b->capacity, 0, (size_t)(cap - b->capacity) * sizeof(BoardNode));
+        b->nodes[k] = grown;
+    }
+    b->capacity = cap;
+    return 0;
+}
+
+void leaderboard_insert(Leaderboards* b, const Player* p) {
+    for (int k = 0; k < BOARD_COUNT; ++k) {
+        b->nodes[k][p->id].score = leaderboard_score(p, (BoardKind)k);
+        node_insert(b->nodes[k], &b->root[k], p->id);
+    }
+}
+
+void leaderboard_update(Leaderboards* b, const Player* p) {
+    for (int k = 0; k < BOARD_COUNT; ++k) {
+        BoardNode* n = b->nodes[k];
+        int64_t score = leaderboard_score(p, (BoardKind)k);
+        if (n[p->id].score == score) continue;
+        node_remove(n, &b->root[k], p->id);
+        n[p->id].score = score;
+        node_insert(n, &b->root[k], p->id);
+    }
+}
+
+void leaderboard_remove(Leaderboards* b, uint32_t player_id) {
+    if (player_id >= b->capacity) return;
+    for (int k = 0; k < BOARD_COUNT; ++k) node_remove(b->nodes[k], &b->root[k], player_id);
+}
+
+void leaderboard_free(Leaderboards* b) {
+    if (!b) return;
+    for (int k = 0; k < BOARD_COUNT; ++k) free(b->nodes[k]);
+    free(b);
+}
+
+static int cmp_entry(const void* a, const void* b) {
+    const BoardEntry* x = (const BoardEntry*)a;
+    const BoardEntry* y = (const BoardEntry*)b;
+    if (x->score != y->score) return x->score > y->score ? -1 : 1;
+    return x->player_id < y->player_id ? -1 : x->player_id > y->player_id;
+}
+
+// Builds a board from its players in rank order in O(N): the right spine of the treap built so
+// far is kept on a stack, and each new node takes over the spine nodes of lower priority as its
+// left subtree.
+static void build_sorted(BoardNode* n, uint32_t* root, const BoardEntry* order, uint32_t count, uint32_t* spine) {
+    uint32_t top = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t id = order[i].player_id;
+        uint32_t prio = priority(id);
+        uint32_t last = 0;
+        while (top && priority(spine[top - 1]) < prio) last = spine[--top];
+        n[id].score = order[i].score;
+        n[id].child[0] = last;
+        n[id].child[1] = 0;
+        if (last) n[last].parent = id;
+        n[id].parent = top ? spine[top - 1] : 0;
+        if (top) n[spine[top - 1]].child[1] = id;
+        spine[top++] = id;
+    }
+    *root = top ? spine[0] : 0;
+}
+
+int leaderboard_attach(Roster* r) {
+    leaderboard_detach(r);
+    Leaderboards* b = (Leaderboards*)calloc(1, sizeof(Leaderboards));
+    BoardEntry* order = (BoardEntry*)malloc(((size_t)r->count + 1) * sizeof(BoardEntry));
+    uint32_t* spine = (uint32_t*)malloc(((size_t)r->count + 1) * sizeof(uint32_t));
+    int rc = b && order && spine && leaderboard_reserve(b, r->next_id) == 0 ? 0 : -1;
+    for (int k = 0; rc == 0 && k < BOARD_COUNT; ++k) {
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < r->slot_count; ++i) {
+            const Player* p = roster_at(r, i);
+            if (p->id == 0) continue;
+            order[count].player_id = p->id;
+            order[count].score = leaderboard_score(p, (BoardKind)k);
+            count++;
+        }
+        qsort(order, count, sizeof(BoardEntry), cmp_entry);
+        build_sorted(b->nodes[k], &b->root[k], order, count, spine);
+    }
+    free(order);
+    free(spine);
+    if (rc != 0) { leaderboard_free(b); return -1; }
+    r->boards = b;
+    return 0;
+}
+
+void leaderboard_detach(Roster* r) {
+    leaderboard_free(r->boards);
+    r->boards = NULL;
+}
+
+uint32_t leaderboard_top(const Roster* r, BoardKind kind, uint32_t k, BoardEntry* out) {
+    const Leaderboards* b = r->boards;
+    if (!b || (unsigned)kind >= BOARD_COUNT) return 0;
+    const BoardNode* n = b->nodes[kind];
+    uint32_t x = b->root[kind];
+    if (x)
+        while (n[x].child[0]) x = n[x].child[0];
+    uint32_t got = 0;
+    while (x && got < k) {
+        out[got].player_id = x;
+        out[got].score = n[x].score;
+        got++;
+        // in-order successor: leftmost of the right subtree, else the first ancestor reached from the left
+        if (n[x].child[1]) {
+            x = n[x].child[1];
+            while (n[x].child[0]) x = n[x].child[0];
+        } else {
+            uint32_t from = x;
+            x = n[x].parent;
+            while (x && n[x].child[1] == from) { from = x; x = n[x].parent; }
+        }
+    }
+    return got;
+}
@@ -0,0 +1,994 @@
+// Per-player, per-match ledger (layout in docs/persistence.md). Every ended or cancelled match
+// adds one row per buyer to <base>.tail; once the tail holds LEDGER_SEGMENT_ROWS rows they are
+// sealed into one varint segment appended to <base>.bin, and <base>.idx is rewritten with the
+// segment directory (time bounds and money totals) and each player's run offset per segment.
+// Sealing follows the match history: segment synced, index replaced, tail emptied.
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // fsync, fileno
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "persist.h"
+#include "bingo.h"
+
+#define LEDGER_MAGIC 0x42474F4C        /* 'BGOL' */
+#define LEDGER_INDEX_MAGIC 0x42474F4D  /* 'BGOM' */
+#define LEDGER_SEGMENT_MAGIC 0x4C534547 /* 'LSEG' */
+#define LEDGER_TAIL_MAGIC 0x4C54414C   /* 'LTAL' */
+#define LEDGER_VERSION 1
+#define LEDGER_PATH_LEN 512
+
+#define LEDGER_FILE_HEADER 32
+#define LEDGER_TAIL_HEADER 16
+#define LEDGER_SEGMENT_HEADER 64
+#define LEDGER_ROW_BYTES 48
+#define LEDGER_INDEX_HEADER 64
+#define LEDGER_DIR_BYTES 72
+#define LEDGER_POSTING_BYTES 20
+
+#define LEDGER_LAST 0x80               // row flag inside ledger.c and in the tail: last row of its match
+#define LEDGER_FLAG_MASK 3             // flags kept in a segment (LEDGER_CANCELLED, LEDGER_IMPORTED)
+
+// Worst-case encoded bytes (10 per varint): a match table entry, a run row, a run header.
+#define LEDGER_MATCH_MAX 60
+#define LEDGER_RUN_ROW_MAX 50
+#define LEDGER_RUN_HEADER_MAX 20
+
+typedef struct {
+    uint64_t offset;           // of the segment header in <base>.bin
+    uint32_t first_match, last_match;
+    int64_t first_at, last_at;
+    uint32_t rows, matches;
+    uint64_t cards;
+    Money spend, won, refunded;
+} LedgerSegRef;
+
+// Where one player's rows of one segment are.
+typedef struct {
+    uint32_t player_id;
+    uint32_t segment;          // directory index
+    uint32_t offset;           // of the rows, from the segment header
+    uint32_t bytes;
+    uint32_t crc;              // CRC32 of those bytes
+} LedgerPosting;
+
+typedef struct {
+    LedgerSegRef* segments;
+    uint32_t segment_count, segment_cap;
+    LedgerPosting* postings;   // sorted by (player, segment) once `sorted`
+    uint32_t posting_count, posting_cap;
+    int sorted;
+    uint64_t bin_size;         // bytes of <base>.bin holding sealed segments (0: no file yet)
+    uint64_t rows;             // rows in the segments
+    uint32_t last_match;
+    int64_t last_at;
+} LedgerIndex;
+
+// A segment read into memory (whole, or only up to its match table).
+typedef struct {
+    const uint8_t* seg;        // header first
+    uint32_t rows, matches, players;
+    uint32_t match_bytes, run_bytes;
+    uint32_t first_match, last_match;
+    int64_t first_at, last_at;
+} SegView;
+
+// One match table entry: what the match's rows add up to.
+typedef struct {
+    uint32_t match_number;
+    int64_t at;
+    uint32_t rows;
+    uint8_t flags;
+    uint64_t cards;
+    Money spend, payout;
+} MatchTotal;
+
+struct PlayerLedger {
+    LedgerIndex idx;
+    LedgerRow* tail;           // rows not yet sealed, whole matches in match order
+    uint32_t tail_count;
+    FILE* bin;
+    uint8_t* buf;              // segment bytes of the last read
+    size_t buf_cap;
+};
+
+static uint32_t CRC_TABLE[256];
+
+static uint32_t crc32(const uint8_t* p, size_t n) {
+    if (!CRC_TABLE[1]) {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            CRC_TABLE[i] = c;
+        }
+    }
+    uint32_t c = 0xFFFFFFFFu;
+    while (n--) c = CRC_TABLE[(c ^ *p++) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+static void put_u16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put_u32(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; ++i) p[i] = (uint8_t)(v >> (8 * i)); }
+static void put_u64(uint8_t* p, uint64_t v) { for (int i = 0; i < 8; ++i) p[i] = (uint8_t)(v >> (8 * i)); }
+static uint16_t get_u16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t get_u32(const uint8_t* p) { uint32_t v = 0; for (int i = 3; i >= 0; --i) v = (v << 8) | p[i]; return v; }
+static uint64_t get_u64(const uint8_t* p) { uint64_t v = 0; for (int i = 7; i >= 0; --i) v = (v << 8) | p[i]; return v; }
+
+// LEB128: 7 bits per byte, low group first.
+static uint8_t* put_varint(uint8_t* p, uint64_t v) {
+    while (v >= 0x80) { *p++ = (uint8_t)(v | 0x80); v >>= 7; }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+// NULL if the varint runs past `end` or over 64 bits.
+static const uint8_t* get_varint(const uint8_t* p, const uint8_t* end, uint64_t* v) {
+    *v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t b = *p++;
+        *v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return p;
+    }
+    return NULL;
+}
+
+static int ledger_path(char* out, const char* base, const char* ext) {
+    int n = snprintf(out, LEDGER_PATH_LEN, "%s%s", base, ext);
+    return n > 0 && n < LEDGER_PATH_LEN ? 0 : -1;
+}
+
+static long long file_size(FILE* f) {
+    if (fseek(f, 0, SEEK_END) != 0) return -1;
+    long long n = (long long)ftell(f);
+    return fseek(f, 0, SEEK_SET) == 0 ? n : -1;
+}
+
+// fclose after pushing the data to the device.
+static int close_synced(FILE* f) {
+    int rc = fflush(f);
+#ifdef _WIN32
+    if (rc == 0) rc = _commit(_fileno(f));
+#else
+    if (rc == 0) rc = fsync(fileno(f));
+#endif
+    if (fclose(f) != 0) rc = -1;
+    return rc == 0 ? 0 : -1;
+}
+
+// ---- tail rows ----
+
+// The tail starts with the number of rows sealed before it, so rows a crash left in the tail
+// after sealing them are recognised by position; match numbers alone cannot tell, since a
+// cancelled match's number is used again by the next match.
+static int tail_header(FILE* f, uint64_t* first_row) {
+    uint8_t h[LEDGER_TAIL_HEADER];
+    if (fread(h, sizeof(h), 1, f) != 1 || get_u32(h) != LEDGER_TAIL_MAGIC || get_u16(h + 4) != LEDGER_VERSION) return -1;
+    *first_row = get_u64(h + 8);
+    return 0;
+}
+
+static void row_encode(uint8_t* p, const LedgerRow* r) {
+    memset(p, 0, LEDGER_ROW_BYTES);
+    put_u32(p, r->match_number);
+    put_u32(p + 4, r->player_id);
+    put_u32(p + 8, r->cards);
+    p[12] = r->flags & (LEDGER_FLAG_MASK | LEDGER_LAST);
+    put_u64(p + 16, (uint64_t)r->at);
+    put_u64(p + 24, (uint64_t)r->spend);
+    put_u64(p + 32, (uint64_t)r->payout);
+    put_u32(p + 44, crc32(p, 44));
+}
+
+static int row_decode(const uint8_t* p, LedgerRow* r) {
+    if (get_u32(p + 44) != crc32(p, 44)) return -1;
+    r->match_number = get_u32(p);
+    r->player_id = get_u32(p + 4);
+    r->cards = get_u32(p + 8);
+    r->flags = p[12] & (LEDGER_FLAG_MASK | LEDGER_LAST);
+    r->at = (int64_t)get_u64(p + 16);
+    r->spend = (Money)get_u64(p + 24);
+    r->payout = (Money)get_u64(p + 32);
+    return 0;
+}
+
+// Reads the whole matches at the start of the tail: a torn or corrupt row ends it, and rows of
+// a match cut short by a crash are dropped. *first_row is UINT64_MAX without a valid header.
+// *clean is 0 if anything else is in the file; 0 ok, -1 OOM.
+static int tail_read(const char* path, LedgerRow** rows, uint32_t* count, uint64_t* first_row, int* clean) {
+    *rows = NULL;
+    *count = 0;
+    *first_row = UINT64_MAX;
+    *clean = 1;
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+    long long size = file_size(f);
+    if (tail_header(f, first_row) != 0) {
+        fclose(f);
+        *first_row = UINT64_MAX;
+        *clean = 0;
+        return 0;
+    }
+    uint32_t cap = (uint32_t)((size - LEDGER_TAIL_HEADER) / LEDGER_ROW_BYTES);
+    if (cap > 0 && !(*rows = (LedgerRow*)malloc(sizeof(LedgerRow) * cap))) { fclose(f); return -1; }
+    uint8_t row[LEDGER_ROW_BYTES];
+    uint32_t n = 0;
+    while (n < cap && fread(row, LEDGER_ROW_BYTES, 1, f) == 1 && row_decode(row, &(*rows)[n]) == 0)
+        if ((*rows)[n++].flags & LEDGER_LAST) *count = n;
+    fclose(f);
+    *clean = size == LEDGER_TAIL_HEADER + (long long)*count * LEDGER_ROW_BYTES;
+    return 0;
+}
+
+// The row count and last row of an intact tail without reading it all (count 0: no tail or
+// no rows). -1 if the tail needs tail_read (torn, corrupt or a match cut short).
+static int tail_peek(const char* path, uint32_t* count, LedgerRow* last, uint64_t* first_row) {
+    *count = 0;
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+    long long size = file_size(f);
+    uint8_t row[LEDGER_ROW_BYTES];
+    int rc = -1;
+    if (tail_header(f, first_row) == 0 && size >= LEDGER_TAIL_HEADER && (size - LEDGER_TAIL_HEADER) % LEDGER_ROW_BYTES == 0) {
+        if (size == LEDGER_TAIL_HEADER) rc = 0;
+        else if (fseek(f, (long)(size - LEDGER_ROW_BYTES), SEEK_SET) == 0 && fread(row, LEDGER_ROW_BYTES, 1, f) == 1 &&
+                 row_decode(row, last) == 0 && (last->flags & LEDGER_LAST)) {
+            *count = (uint32_t)((size - LEDGER_TAIL_HEADER) / LEDGER_ROW_BYTES);
+            rc = 0;
+        }
+    }
+    fclose(f);
+    return rc;
+}
+
+// Writes rows[0..n) to f. 0 ok, -1 I/O error or OOM.
+static int rows_write(FILE* f, const LedgerRow* rows, uint32_t n) {
+    if (n == 0) return 0;
+    uint8_t* buf = (uint8_t*)malloc((size_t)n * LEDGER_ROW_BYTES);
+    if (!buf) return -1;
+    for (uint32_t i = 0; i < n; ++i) row_encode(buf + (size_t)i * LEDGER_ROW_BYTES, &rows[i]);
+    int rc = fwrite(buf, LEDGER_ROW_BYTES, n, f) == n ? 0 : -1;
+    free(buf);
+    return rc;
+}
+
+// Rewrites the tail with exactly these rows (none: only the header).
+static int tail_write(const char* path, const LedgerRow* rows, uint32_t count, uint64_t first_row) {
+    FILE* f = fopen(path, "wb");
+    if (!f) return -1;
+    uint8_t h[LEDGER_TAIL_HEADER] = {0};
+    put_u32(h, LEDGER_TAIL_MAGIC);
+    put_u16(h + 4, LEDGER_VERSION);
+    put_u64(h + 8, first_row);
+    int rc = fwrite(h, sizeof(h), 1, f) == 1 ? rows_write(f, rows, count) : -1;
+    return close_synced(f) == 0 ? rc : -1;
+}
+
+// Rows of the tail that a crash left behind after sealing them.
+static uint32_t tail_sealed(uint64_t first_row, uint64_t sealed_rows, uint32_t count) {
+    if (first_row == UINT64_MAX || sealed_rows <= first_row) return 0;
+    return sealed_rows - first_row < count ? (uint32_t)(sealed_rows - first_row) : count;
+}
+
+// ---- segments ----
+
+static int cmp_row_player(const void* a, const void* b) {
+    const LedgerRow* x = *(const LedgerRow* const*)a;
+    const LedgerRow* y = *(const LedgerRow* const*)b;
+    if (x->player_id != y->player_id) return x->player_id < y->player_id ? -1 : 1;
+    return x < y ? -1 : x > y; // rows are in match order already
+}
+
+// One row of a player's run; *match and *at hold the previous row's (the segment's first
+// match and time before the first row). NULL if malformed.
+static const uint8_t* run_row(const uint8_t* p, const uint8_t* end, uint32_t* match, int64_t* at, LedgerRow* r) {
+    uint64_t dm, dt, cards, spend, payout;
+    if (!(p = get_varint(p, end, &dm)) || !(p = get_varint(p, end, &dt)) || !(p = get_varint(p, end, &cards)) ||
+        !(p = get_varint(p, end, &spend)) || !(p = get_varint(p, end, &payout)))
+        return NULL;
+    *match += (uint32_t)dm;
+    *at += (int64_t)dt;
+    r->match_number = *match;
+    r->at = *at;
+    r->cards = (uint32_t)(cards >> 2);
+    r->flags = (uint8_t)(cards & LEDGER_FLAG_MASK);
+    r->spend = (Money)spend;
+    r->payout = (Money)payout;
+    return p;
+}
+
+static const uint8_t* match_entry(const uint8_t* p, const uint8_t* end, uint32_t* match, int64_t* at, MatchTotal* t) {
+    uint64_t dm, dt, rows, cards, spend, payout;
+    if (!(p = get_varint(p, end, &dm)) || !(p = get_varint(p, end, &dt)) || !(p = get_varint(p, end, &rows)) ||
+        !(p = get_varint(p, end, &cards)) || !(p = get_varint(p, end, &spend)) || !(p = get_varint(p, end, &payout)))
+        return NULL;
+    *match += (uint32_t)dm;
+    *at += (int64_t)dt;
+    t->match_number = *match;
+    t->at = *at;
+    t->rows = (uint32_t)(rows >> 2);
+    t->flags = (uint8_t)(rows & LEDGER_FLAG_MASK);
+    t->cards = cards;
+    t->spend = (Money)spend;
+    t->payout = (Money)payout;
+    return p;
+}
+
+// Header, match table and player runs of a segment holding rows[0..n) (whole matches in match
+// order, each ending with a LEDGER_LAST row). Deltas run from the segment's first match and time, so every run decodes on its own.
+// NULL on OOM.
+static uint8_t* segment_encode(const LedgerRow* rows, uint32_t n, size_t* size) {
+    uint32_t matches = 0;
+    for (uint32_t i = 0; i < n; ++i) matches += (rows[i].flags & LEDGER_LAST) != 0;
+    const LedgerRow** order = (const LedgerRow**)malloc(sizeof(LedgerRow*) * n);
+    uint8_t* b = (uint8_t*)malloc(LEDGER_SEGMENT_HEADER + (size_t)matches * LEDGER_MATCH_MAX + (size_t)n * (LEDGER_RUN_ROW_MAX + LEDGER_RUN_HEADER_MAX));
+    if (!order || !b) { free(order); free(b); return NULL; }
+    uint32_t first_match = rows[0].match_number;
+    int64_t first_at = rows[0].at;
+
+    // match table: one entry per match, in match order
+    uint8_t* p = b + LEDGER_SEGMENT_HEADER;
+    uint32_t prev_match = first_match;
+    int64_t prev_at = first_at;
+    for (uint32_t i = 0; i < n;) {
+        uint32_t j = i;
+        uint64_t cards = 0;
+        Money spend = 0, payout = 0;
+        while (j < n) {
+            cards += rows[j].cards;
+            spend += rows[j].spend;
+            payout += rows[j].payout;
+            if (rows[j++].flags & LEDGER_LAST) break;
+        }
+        p = put_varint(p, rows[i].match_number - prev_match);
+        p = put_varint(p, (uint64_t)(rows[i].at - prev_at));
+        p = put_varint(p, (uint64_t)(j - i) << 2 | (rows[i].flags & LEDGER_FLAG_MASK));
+        p = put_varint(p, cards);
+        p = put_varint(p, (uint64_t)spend);
+        p = put_varint(p, (uint64_t)payout);
+        prev_match = rows[i].match_number;
+        prev_at = rows[i].at;
+        i = j;
+    }
+    uint8_t* runs = p;
+
+    // player runs: player delta and row count, then the player's rows in match order
+    for (uint32_t i = 0; i < n; ++i) order[i] = &rows[i];
+    qsort(order, n, sizeof(LedgerRow*), cmp_row_player);
+    uint32_t players = 0, prev_player = 0;
+    for (uint32_t i = 0; i < n;) {
+        uint32_t j = i;
+        while (j < n && order[j]->player_id == order[i]->player_id) j++;
+        p = put_varint(p, order[i]->player_id - prev_player);
+        p = put_varint(p, j - i);
+        prev_player = order[i]->player_id;
+        players++;
+        prev_match = first_match;
+        prev_at = first_at;
+        for (; i < j; ++i) {
+            const LedgerRow* r = order[i];
+            p = put_varint(p, r->match_number - prev_match);
+            p = put_varint(p, (uint64_t)(r->at - prev_at));
+            p = put_varint(p, (uint64_t)r->cards << 2 | (r->flags & LEDGER_FLAG_MASK));
+            p = put_varint(p, (uint64_t)r->spend);
+            p = put_varint(p, (uint64_t)r->payout);
+            prev_match = r->match_number;
+            prev_at = r->at;
+        }
+    }
+    free(order);
+    uint32_t match_bytes = (uint32_t)(runs - (b + LEDGER_SEGMENT_HEADER));
+    uint32_t run_bytes = (uint32_t)(p - runs);
+    memset(b, 0, LEDGER_SEGMENT_HEADER);
+    put_u32(b, LEDGER_SEGMENT_MAGIC);
+    put_u32(b + 4, n);
+    put_u32(b + 8, matches);
+    put_u32(b + 12, players);
+    put_u32(b + 16, match_bytes);
+    put_u32(b + 20, run_bytes);
+    put_u32(b + 24, first_match);
+    put_u32(b + 28, rows[n - 1].match_number);
+    put_u64(b + 32, (uint64_t)first_at);
+    put_u64(b + 40, (uint64_t)rows[n - 1].at);
+    put_u32(b + 48, crc32(b + LEDGER_SEGMENT_HEADER, match_bytes));
+    put_u32(b + 52, crc32(runs, run_bytes));
+    put_u32(b + 60, crc32(b, 60));
+    *size = LEDGER_SEGMENT_HEADER + (size_t)match_bytes + run_bytes;
+    return b;
+}
+
+static int segment_header(const uint8_t* h, SegView* v) {
+    if (get_u32(h) != LEDGER_SEGMENT_MAGIC || get_u32(h + 60) != crc32(h, 60)) return -1;
+    v->rows = get_u32(h + 4);
+    v->matches = get_u32(h + 8);
+    v->players = get_u32(h + 12);
+    v->match_bytes = get_u32(h + 16);
+    v->run_bytes = get_u32(h + 20);
+    v->first_match = get_u32(h + 24);
+    v->last_match = get_u32(h + 28);
+    v->first_at = (int64_t)get_u64(h + 32);
+    v->last_at = (int64_t)get_u64(h + 40);
+    if (v->rows == 0 || v->matches == 0 || v->matches > v->rows || v->players == 0 || v->players > v->rows) return -1;
+    return 0;
+}
+
+// Reads and checks the segment at `offset` into *buf (grown as needed): the whole segment, or
+// with `whole` 0 only the header and match table. 0 ok, -1 torn or corrupt, -2 OOM.
+static int segment_read(FILE* f, uint64_t offset, int whole, uint8_t** buf, size_t* cap, SegView* v) {
+    uint8_t h[LEDGER_SEGMENT_HEADER];
+    if (fseek(f, (long)offset, SEEK_SET) != 0 || fread(h, sizeof(h), 1, f) != 1 || segment_header(h, v) != 0) return -1;
+    size_t bytes = LEDGER_SEGMENT_HEADER + (size_t)v->match_bytes + (whole ? v->run_bytes : 0);
+    if (bytes > *cap) {
+        uint8_t* grown = (uint8_t*)realloc(*buf, bytes);
+        if (!grown) return -2;
+        *buf = grown;
+        *cap = bytes;
+    }
+    memcpy(*buf, h, sizeof(h));
+    size_t body = bytes - LEDGER_SEGMENT_HEADER;
+    if (fread(*buf + LEDGER_SEGMENT_HEADER, 1, body, f) != body) return -1;
+    if (crc32(*buf + LEDGER_SEGMENT_HEADER, v->match_bytes) != get_u32(h + 48)) return -1;
+    if (whole && crc32(*buf + LEDGER_SEGMENT_HEADER + v->match_bytes, v->run_bytes) != get_u32(h + 52)) return -1;
+    v->seg = *buf;
+    return 0;
+}
+
+// ---- index ----
+
+static void index_free(LedgerIndex* idx) {
+    free(idx->segments);
+    free(idx->postings);
+    memset(idx, 0, sizeof(*idx));
+}
+
+static int cmp_posting(const void* a, const void* b) {
+    const LedgerPosting* x = (const LedgerPosting*)a;
+    const LedgerPosting* y = (const LedgerPosting*)b;
+    if (x->player_id != y->player_id) return x->player_id < y->player_id ? -1 : 1;
+    return x->segment < y->segment ? -1 : x->segment > y->segment;
+}
+
+static void index_sort(LedgerIndex* idx) {
+    if (!idx->sorted) qsort(idx->postings, idx->posting_count, sizeof(LedgerPosting), cmp_posting);
+    idx->sorted = 1;
+}
+
+static void summary_add(LedgerSummary* s, const MatchTotal* t) {
+    s->matches++;
+    s->rows += t->rows;
+    s->cards += t->cards;
+    s->spend += t->spend;
+    if (t->flags & LEDGER_CANCELLED) s->refunded += t->payout;
+    else s->won += t->payout;
+}
+
+// Adds a whole segment found at `offset`: its directory entry from the match table and one
+// posting per player run. -1 malformed, -2 OOM.
+static int index_add_segment(LedgerIndex* idx, uint64_t offset, const SegView* v) {
+    if (idx->segment_count == idx->segment_cap) {
+        uint32_t cap = idx->segment_cap ? idx->segment_cap * 2 : 64;
+        LedgerSegRef* segments = (LedgerSegRef*)realloc(idx->segments, sizeof(LedgerSegRef) * cap);
+        if (!segments) return -2;
+        idx->segments = segments;
+        idx->segment_cap = cap;
+    }
+    if (idx->posting_count + v->players > idx->posting_cap) {
+        uint32_t cap = idx->posting_cap ? idx->posting_cap : 1024;
+        while (cap < idx->posting_count + v->players) cap *= 2;
+        LedgerPosting* postings = (LedgerPosting*)realloc(idx->postings, sizeof(LedgerPosting) * cap);
+        if (!postings) return -2;
+        idx->postings = postings;
+        idx->posting_cap = cap;
+    }
+    LedgerSummary totals = {0, 0, 0, 0, 0, 0};
+    const uint8_t* p = v->seg + LEDGER_SEGMENT_HEADER;
+    const uint8_t* end = p + v->match_bytes;
+    uint32_t match = v->first_match;
+    int64_t at = v->first_at;
+    MatchTotal t;
+    for (uint32_t i = 0; i < v->matches; ++i) {
+        if (!(p = match_entry(p, end, &match, &at, &t))) return -1;
+        summary_add(&totals, &t);
+    }
+    if (p != end || totals.rows != v->rows || match != v->last_match || at != v->last_at) return -1;
+
+    end = p + v->run_bytes;
+    uint32_t player = 0, rows = 0;
+    LedgerPosting* out = idx->postings + idx->posting_count;
+    for (uint32_t k = 0; k < v->players; ++k) {
+        uint64_t dp, n;
+        if (!(p = get_varint(p, end, &dp)) || !(p = get_varint(p, end, &n)) || n == 0 || n > v->rows - rows) return -1;
+        player += (uint32_t)dp;
+        const uint8_t* start = p;
+        match = v->first_match;
+        at = v->first_at;
+        LedgerRow r;
+        for (uint64_t i = 0; i < n; ++i)
+            if (!(p = run_row(p, end, &match, &at, &r))) return -1;
+        rows += (uint32_t)n;
+        out[k] = (LedgerPosting){player, idx->segment_count, (uint32_t)(start - v->seg), (uint32_t)(p - start), crc32(start, (size_t)(p - start))};
+    }
+    if (p != end || rows != v->rows) return -1;
+    LedgerSegRef* ref = &idx->segments[idx->segment_count++];
+    *ref = (LedgerSegRef){offset, v->first_match, v->last_match, v->first_at, v->last_at, v->rows, v->matches,
+                          totals.cards, totals.spend, totals.won, totals.refunded};
+    idx->posting_count += v->players;
+    idx->sorted = 0;
+    idx->rows += v->rows;
+    idx->last_match = v->last_match;
+    idx->last_at = v->last_at;
+    return 0;
+}
+
+// Loads <base>.idx. -1 if missing or damaged (idx is left empty), -2 OOM.
+static int index_read(const char* path, LedgerIndex* idx) {
+    memset(idx, 0, sizeof(*idx));
+    idx->sorted = 1;
+    FILE* f = fopen(path, "rb");
+    if (!f) return -1;
+    uint8_t h[LEDGER_INDEX_HEADER];
+    int rc = -1, bad = 0;
+    if (fread(h, sizeof(h), 1, f) == 1 && get_u32(h) == LEDGER_INDEX_MAGIC && get_u16(h + 4) == LEDGER_VERSION && get_u32(h + 52) == crc32(h, 52)) {
+        uint32_t segments = get_u32(h + 8), postings = get_u32(h + 12);
+        size_t bytes = (size_t)segments * LEDGER_DIR_BYTES + (size_t)postings * LEDGER_POSTING_BYTES;
+        uint8_t* body = (uint8_t*)malloc(bytes ? bytes : 1);
+        idx->segments = (LedgerSegRef*)malloc(sizeof(LedgerSegRef) * (segments ? segments : 1));
+        idx->postings = (LedgerPosting*)malloc(sizeof(LedgerPosting) * (postings ? postings : 1));
+        if (!body || !idx->segments || !idx->postings) {
+            rc = -2;
+        } else if (fread(body, 1, bytes, f) == bytes && crc32(body, bytes) == get_u32(h + 48)) {
+            idx->segment_cap = idx->segment_count = segments;
+            idx->posting_cap = idx->posting_count = postings;
+            for (uint32_t i = 0; i < segments; ++i) {
+                const uint8_t* p = body + (size_t)i * LEDGER_DIR_BYTES;
+                idx->segments[i] = (LedgerSegRef){get_u64(p), get_u32(p + 8), get_u32(p + 12), (int64_t)get_u64(p + 16), (int64_t)get_u64(p + 24),
+                                                  get_u32(p + 32), get_u32(p + 36), get_u64(p + 40), (Money)get_u64(p + 48),
+                                                  (Money)get_u64(p + 56), (Money)get_u64(p + 64)};
+            }
+            for (uint32_t i = 0; i < postings; ++i) {
+                const uint8_t* p = body + (size_t)segments * LEDGER_DIR_BYTES + (size_t)i * LEDGER_POSTING_BYTES;
+                idx->postings[i] = (LedgerPosting){get_u32(p), get_u32(p + 4), get_u32(p + 8), get_u32(p + 12), get_u32(p + 16)};
+                if (idx->postings[i].segment >= segments) bad = 1;
+            }
+            idx->bin_size = get_u64(h + 16);
+            idx->last_match = get_u32(h + 24);
+            idx->last_at = (int64_t)get_u64(h + 32);
+            idx->rows = get_u64(h + 40);
+            rc = bad ? -1 : 0;
+        }
+        free(body);
+    }
+    fclose(f);
+    if (rc != 0) {
+        index_free(idx);
+        idx->sorted = 1;
+    }
+    return rc;
+}
+
+// Replaces <base>.idx (temp file + rename). -1 on I/O error or OOM.
+static int index_write(const char* path, LedgerIndex* idx) {
+    index_sort(idx);
+    size_t bytes = (size_t)idx->segment_count * LEDGER_DIR_BYTES + (size_t)idx->posting_count * LEDGER_POSTING_BYTES;
+    uint8_t* body = (uint8_t*)malloc(bytes ? bytes : 1);
+    if (!body) return -1;
+    for (uint32_t i = 0; i < idx->segment_count; ++i) {
+        uint8_t* p = body + (size_t)i * LEDGER_DIR_BYTES;
+        const LedgerSegRef* s = &idx->segments[i];
+        put_u64(p, s->offset);
+        put_u32(p + 8, s->first_match);
+        put_u32(p + 12, s->last_match);
+        put_u64(p + 16, (uint64_t)s->first_at);
+        put_u64(p + 24, (uint64_t)s->last_at);
+        put_u32(p + 32, s->rows);
+        put_u32(p + 36, s->matches);
+        put_u64(p + 40, s->cards);
+        put_u64(p + 48, (uint64_t)s->spend);
+        put_u64(p + 56, (uint64_t)s->won);
+        put_u64(p + 64, (uint64_t)s->refunded);
+    }
+    for (uint32_t i = 0; i < idx->posting_count; ++i) {
+        uint8_t* p = body + (size_t)idx->segment_count * LEDGER_DIR_BYTES + (size_t)i * LEDGER_POSTING_BYTES;
+        const LedgerPosting* q = &idx->postings[i];
+        put_u32(p, q->player_id);
+        put_u32(p + 4, q->segment);
+        put_u32(p + 8, q->offset);
+        put_u32(p + 12, q->bytes);
+        put_u32(p + 16, q->crc);
+    }
+    uint8_t h[LEDGER_INDEX_HEADER] = {0};
+    put_u32(h, LEDGER_INDEX_MAGIC);
+    put_u16(h + 4, LEDGER_VERSION);
+    put_u32(h + 8, idx->segment_count);
+    put_u32(h + 12, idx->posting_count);
+    put_u64(h + 16, idx->bin_size);
+    put_u32(h + 24, idx->last_match);
+    put_u64(h + 32, (uint64_t)idx->last_at);
+    put_u64(h + 40, idx->rows);
+    put_u32(h + 48, crc32(body, bytes));
+    put_u32(h + 52, crc32(h, 52));
+    char tmp[LEDGER_PATH_LEN + 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = fopen(tmp, "wb");
+    int ok = f && fwrite(h, sizeof(h), 1, f) == 1 && fwrite(body, 1, bytes, f) == bytes;
+    free(body);
+    if (f && close_synced(f) != 0) ok = 0;
+#ifdef _WIN32
+    if (ok) remove(path); // rename does not replace on Windows
+#endif
+    ok = ok && rename(tmp, path) == 0;
+    if (!ok) remove(tmp);
+    return ok ? 0 : -1;
+}
+
+// Loads the index and adds any segments past its end that made it to <base>.bin (a seal cut
+// short by a crash, or a missing or damaged index rebuilt from scratch). *bin is the open
+// segment file, or NULL if there is none yet. 1 if segments were added, 0 if not, -2 OOM,
+// -3 bad segment file.
+static int index_load(const char* bin_path, const char* idx_path, LedgerIndex* idx, FILE** bin) {
+    if (index_read(idx_path, idx) == -2) return -2;
+    *bin = fopen(bin_path, "rb");
+    if (!*bin) {
+        if (idx->segment_count) index_free(idx);
+        idx->sorted = 1;
+        return 0;
+    }
+    long long size = file_size(*bin);
+    uint8_t fh[LEDGER_FILE_HEADER];
+    if (size < LEDGER_FILE_HEADER || fread(fh, sizeof(fh), 1, *bin) != 1 || get_u32(fh) != LEDGER_MAGIC || get_u16(fh + 4) != LEDGER_VERSION) return -3;
+    if (idx->bin_size < LEDGER_FILE_HEADER || idx->bin_size > (uint64_t)size) {
+        // the index does not describe this file: rebuild it
+        index_free(idx);
+        idx->sorted = 1;
+        idx->bin_size = LEDGER_FILE_HEADER;
+    }
+    uint8_t* buf = NULL;
+    size_t cap = 0;
+    SegView v;
+    int added = 0, rc;
+    while ((rc = segment_read(*bin, idx->bin_size, 1, &buf, &cap, &v)) == 0) {
+        if (v.first_match < idx->last_match && idx->segment_count) break; // not a continuation
+        if ((rc = index_add_segment(idx, idx->bin_size, &v)) != 0) break;
+        idx->bin_size += LEDGER_SEGMENT_HEADER + (uint64_t)v.match_bytes + v.run_bytes;
+        added = 1;
+    }
+    free(buf);
+    return rc == -2 ? -2 : added;
+}
+
+// Appends rows[0..n) as one segment at idx->bin_size (creating the file if needed), syncs it and
+// adds it to idx; the index file is not written. -1 I/O error, -2 OOM.
+static int seal_segment(const char* bin_path, LedgerIndex* idx, const LedgerRow* rows, uint32_t n) {
+    size_t size;
+    uint8_t* seg = segment_encode(rows, n, &size);
+    if (!seg) return -2;
+    FILE* f = idx->bin_size ? fopen(bin_path, "r+b") : fopen(bin_path, "wb");
+    int ok = f != NULL;
+    if (ok && idx->bin_size == 0) {
+        uint8_t fh[LEDGER_FILE_HEADER] = {0};
+        put_u32(fh, LEDGER_MAGIC);
+        put_u16(fh + 4, LEDGER_VERSION);
+        put_u32(fh + 8, LEDGER_SEGMENT_ROWS);
+        ok = fwrite(fh, sizeof(fh), 1, f) == 1;
+        idx->bin_size = LEDGER_FILE_HEADER;
+    }
+    ok = ok && fseek(f, (long)idx->bin_size, SEEK_SET) == 0 && fwrite(seg, size, 1, f) == 1;
+    if (f && close_synced(f) != 0) ok = 0;
+    int rc = ok ? 0 : -1;
+    if (ok) {
+        SegView v;
+        segment_header(seg, &v);
+        v.seg = seg;
+        if (index_add_segment(idx, idx->bin_size, &v) != 0) rc = -2;
+        else idx->bin_size += size;
+    }
+    free(seg);
+    return rc;
+}
+
+// ---- appending ----
+
+// Adds the rows of one match (the last flagged LEDGER_LAST); the caller fills everything but
+// the clamped time.
+static int ledger_append(const char* base, LedgerRow* add, uint32_t n) {
+    char bin_path[LEDGER_PATH_LEN], idx_path[LEDGER_PATH_LEN], tail_path[LEDGER_PATH_LEN];
+    if (ledger_path(bin_path, base, ".bin") || ledger_path(idx_path, base, ".idx") || ledger_path(tail_path, base, ".tail")) return -1;
+    LedgerRow* rows = NULL;
+    LedgerRow last;
+    uint32_t count;
+    uint64_t first_row = UINT64_MAX;
+    int clean = 1;
+    if (tail_peek(tail_path, &count, &last, &first_row) != 0) {
+        // a crash tore the tail: read what is whole, rewritten below
+        if (tail_read(tail_path, &rows, &count, &first_row, &clean) != 0) return -1;
+        if (count) last = rows[count - 1];
+    }
+    LedgerIndex idx;
+    FILE* bin = NULL;
+    int loaded = 0, rc = 0;
+    uint32_t last_match = 0;
+    int64_t last_at = 0;
+    if (count > 0) {
+        last_match = last.match_number;
+        last_at = last.at;
+    } else {
+        // empty tail: the index is current up to its last seal; the tail is restarted after it
+        if (index_load(bin_path, idx_path, &idx, &bin) < 0) { free(rows); if (bin) fclose(bin); index_free(&idx); return -1; }
+        loaded = 1;
+        last_match = idx.last_match;
+        last_at = idx.last_at;
+        first_row = idx.rows;
+        clean = 0;
+    }
+    // match numbers only grow (a cancelled match's number is not reused); times never run backwards
+    if (add[0].match_number <= last_match) rc = -2;
+    for (uint32_t i = 0; i < n; ++i) if (add[i].at < last_at) add[i].at = last_at;
+
+    if (rc == 0 && count + n < LEDGER_SEGMENT_ROWS) {
+        if (!clean && tail_write(tail_path, rows, count, first_row) != 0) rc = -1;
+        FILE* f = rc == 0 ? fopen(tail_path, "ab") : NULL;
+        if (!f || rows_write(f, add, n) != 0) rc = -1;
+        if (f && fclose(f) != 0) rc = -1;
+    } else if (rc == 0) {
+        // the segment is full: seal the rows not sealed already, then empty the tail
+        if (!rows && count && tail_read(tail_path, &rows, &count, &first_row, &clean) != 0) rc = -1;
+        if (rc == 0 && !loaded) {
+            if (index_load(bin_path, idx_path, &idx, &bin) < 0) rc = -1;
+            loaded = 1;
+        }
+        if (bin) { fclose(bin); bin = NULL; }
+        LedgerRow* grown = rc == 0 ? (LedgerRow*)realloc(rows, sizeof(LedgerRow) * ((size_t)count + n)) : NULL;
+        if (rc == 0 && !grown) rc = -1;
+        if (rc == 0) {
+            rows = grown;
+            uint32_t skip = tail_sealed(first_row, idx.rows, count);
+            memcpy(rows + count, add, sizeof(LedgerRow) * n);
+            count += n;
+            if (seal_segment(bin_path, &idx, rows + skip, count - skip) != 0 || index_write(idx_path, &idx) != 0 || tail_write(tail_path, NULL, 0, idx.rows) != 0) rc = -1;
+        }
+    }
+    if (bin) fclose(bin);
+    if (loaded) index_free(&idx);
+    free(rows);
+    return rc;
+}
+
+int persist_append_ledger(const char* base, const Match* m, int cancelled) {
+    if (m->entry_count == 0) return 0;
+    LedgerRow* rows = (LedgerRow*)malloc(sizeof(LedgerRow) * m->entry_count);
+    if (!rows) return -1;
+    int64_t at = (int64_t)time(NULL);
+    for (uint32_t e = 0; e < m->entry_count; ++e) {
+        const MatchEntry* me = &m->entries[e];
+        LedgerRow* r = &rows[e];
+        r->match_number = m->match_number;
+        r->player_id = me->player_id;
+        r->flags = cancelled ? LEDGER_CANCELLED : 0;
+        r->at = at;
+        r->cards = me->cards;
+        r->spend = m->card_cost * (Money)me->cards;
+        // a cancelled match refunded the spend; otherwise the winner's share, as pay_winner paid it
+        if (cancelled) r->payout = r->spend;
+        else r->payout = me->winner_pos ? money_share(m->paid_out, m->winner_count, me->winner_pos - 1) : 0;
+    }
+    rows[m->entry_count - 1].flags |= LEDGER_LAST;
+    int rc = ledger_append(base, rows, m->entry_count);
+    free(rows);
+    return rc;
+}
+
+// ---- queries ----
+
+PlayerLedger* persist_ledger_open(const char* base) {
+    char bin_path[LEDGER_PATH_LEN], idx_path[LEDGER_PATH_LEN], tail_path[LEDGER_PATH_LEN];
+    if (ledger_path(bin_path, base, ".bin") || ledger_path(idx_path, base, ".idx") || ledger_path(tail_path, base, ".tail")) return NULL;
+    PlayerLedger* l = (PlayerLedger*)calloc(1, sizeof(PlayerLedger));
+    if (!l) return NULL;
+    uint64_t first_row;
+    int clean;
+    if (index_load(bin_path, idx_path, &l->idx, &l->bin) < 0 || tail_read(tail_path, &l->tail, &l->tail_count, &first_row, &clean) != 0) {
+        persist_ledger_close(l);
+        return NULL;
+    }
+    index_sort(&l->idx);
+    // rows a crash left behind after they were sealed
+    uint32_t skip = tail_sealed(first_row, l->idx.rows, l->tail_count);
+    if (skip) {
+        memmove(l->tail, l->tail + skip, sizeof(LedgerRow) * (l->tail_count - skip));
+        l->tail_count -= skip;
+    }
+    return l;
+}
+
+void persist_ledger_close(PlayerLedger* l) {
+    if (!l) return;
+    if (l->bin) fclose(l->bin);
+    index_free(&l->idx);
+    free(l->tail);
+    free(l->buf);
+    free(l);
+}
+
+uint64_t persist_ledger_rows(const PlayerLedger* l) {
+    return l->idx.rows + l->tail_count;
+}
+
+// Reads a posting's run into l->buf and checks it. 0 ok, -1 unreadable, -2 OOM.
+static int read_run(PlayerLedger* l, const LedgerPosting* q) {
+    if (!l->bin) return -1;
+    if (q->bytes > l->buf_cap) {
+        uint8_t* grown = (uint8_t*)realloc(l->buf, q->bytes);
+        if (!grown) return -2;
+        l->buf = grown;
+        l->buf_cap = q->bytes;
+    }
+    uint64_t offset = l->idx.segments[q->segment].offset + q->offset;
+    if (fseek(l->bin, (long)offset, SEEK_SET) != 0 || fread(l->buf, 1, q->bytes, l->bin) != q->bytes || crc32(l->buf, q->bytes) != q->crc) return -1;
+    return 0;
+}
+
+int persist_ledger_statement(PlayerLedger* l, uint32_t player_id, int64_t from, int64_t to, LedgerFn fn, void* ctx) {
+    int visited = 0;
+    const LedgerPosting* q = l->idx.postings;
+    const LedgerSegRef* seg = l->idx.segments;
+    // the player's first segment that ends at or after `from`
+    uint32_t lo = 0, hi = l->idx.posting_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (q[mid].player_id < player_id || (q[mid].player_id == player_id && seg[q[mid].segment].last_at < from)) lo = mid + 1;
+        else hi = mid;
+    }
+    LedgerRow r;
+    r.player_id = player_id;
+    for (; lo < l->idx.posting_count && q[lo].player_id == player_id && seg[q[lo].segment].first_at < to; ++lo) {
+        int rc = read_run(l, &q[lo]);
+        if (rc != 0) return -2;
+        const uint8_t* p = l->buf;
+        const uint8_t* end = p + q[lo].bytes;
+        uint32_t match = seg[q[lo].segment].first_match;
+        int64_t at = seg[q[lo].segment].first_at;
+        while (p < end) {
+            if (!(p = run_row(p, end, &match, &at, &r))) return -2;
+            if (r.at < from || r.at >= to) continue;
+            visited++;
+            if (fn(ctx, &r) != 0) return visited;
+        }
+    }
+    for (uint32_t i = 0; i < l->tail_count; ++i) {
+        const LedgerRow* t = &l->tail[i];
+        if (t->player_id != player_id || t->at < from || t->at >= to) continue;
+        r = *t;
+        r.flags &= LEDGER_FLAG_MASK;
+        visited++;
+        if (fn(ctx, &r) != 0) break;
+    }
+    return visited;
+}
+
+int persist_ledger_summary(PlayerLedger* l, int64_t from, int64_t to, LedgerSummary* out) {
+    memset(out, 0, sizeof(*out));
+    const LedgerSegRef* seg = l->idx.segments;
+    uint32_t lo = 0, hi = l->idx.segment_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (seg[mid].last_at < from) lo = mid + 1;
+        else hi = mid;
+    }
+    for (uint32_t s = lo; s < l->idx.segment_count && seg[s].first_at < to; ++s) {
+        if (seg[s].first_at >= from && seg[s].last_at < to) {
+            // wholly inside: the directory totals, no read
+            out->matches += seg[s].matches;
+            out->rows += seg[s].rows;
+            out->cards += seg[s].cards;
+            out->spend += seg[s].spend;
+            out->won += seg[s].won;
+            out->refunded += seg[s].refunded;
+            continue;
+        }
+        // a boundary segment: only its match table
+        SegView v;
+        if (!l->bin || segment_read(l->bin, seg[s].offset, 0, &l->buf, &l->buf_cap, &v) != 0) return -2;
+        const uint8_t* p = v.seg + LEDGER_SEGMENT_HEADER;
+        const uint8_t* end = p + v.match_bytes;
+        uint32_t match = v.first_match;
+        int64_t at = v.first_at;
+        MatchTotal t;
+        for (uint32_t i = 0; i < v.matches; ++i) {
+            if (!(p = match_entry(p, end, &match, &at, &t))) return -2;
+            if (t.at >= from && t.at < to) summary_add(out, &t);
+        }
+    }
+    for (uint32_t i = 0; i < l->tail_count;) {
+        const LedgerRow* r = &l->tail[i];
+        MatchTotal t = {r->match_number, r->at, 0, (uint8_t)(r->flags & LEDGER_FLAG_MASK), 0, 0, 0};
+        while (i < l->tail_count) {
+            t.rows++;
+            t.cards += l->tail[i].cards;
+            t.spend += l->tail[i].spend;
+            t.payout += l->tail[i].payout;
+            if (l->tail[i++].flags & LEDGER_LAST) break;
+        }
+        if (t.at >= from && t.at < to) summary_add(out, &t);
+    }
+    return 0;
+}
+
+// ---- converting match_ledger.csv ----
+
+int persist_import_ledger_csv(const char* csv_path, const char* history_base, const char* base) {
+    char bin_path[LEDGER_PATH_LEN], idx_path[LEDGER_PATH_LEN], tail_path[LEDGER_PATH_LEN];
+    if (ledger_path(bin_path, base, ".bin") || ledger_path(idx_path, base, ".idx") || ledger_path(tail_path, base, ".tail")) return -3;
+    FILE* probe = fopen(bin_path, "rb");
+    if (!probe) probe = fopen(tail_path, "rb");
+    if (probe) {
+        long long size = file_size(probe);
+        fclose(probe);
+        if (size != 0) return -2;
+    }
+    FILE* f = fopen(csv_path, "r");
+    if (!f) return -1;
+    // payouts and end times come from the match history, converted before the ledger
+    MatchHistory* h = history_base ? persist_history_open(history_base) : NULL;
+    LedgerIndex idx;
+    memset(&idx, 0, sizeof(idx));
+    idx.sorted = 1;
+    LedgerRow* rows = NULL;
+    uint32_t n = 0, cap = 0, group = 0; // rows[group..n) belong to the match being read
+    int64_t last_at = 0;
+    HistoryMatch hm;
+    int have_match = 0, imported = 0, rc = 0;
+    char line[256];
+    while (rc == 0) {
+        unsigned long match = 0, player, cards;
+        double spend;
+        int more = fgets(line, sizeof(line), f) != NULL;
+        if (more && sscanf(line, "%lu,%lu,%lu,%lf", &match, &player, &cards, &spend) != 4) continue;
+        if (n > group && (!more || rows[group].match_number != (uint32_t)match)) {
+            // the previous match is complete: seal once the segment is full
+            rows[n - 1].flags |= LEDGER_LAST;
+            if (n >= LEDGER_SEGMENT_ROWS) {
+                if (seal_segment(bin_path, &idx, rows, n) != 0) rc = -3;
+                n = 0;
+            }
+            group = n;
+        }
+        if (!more || rc != 0) break;
+        uint32_t last = n ? rows[n - 1].match_number : idx.last_match;
+        if (n == group) {
+            if ((uint32_t)match <= last) continue; // numbers restarted: keep the first run
+            have_match = h && persist_history_find(h, (uint32_t)match, &hm) == 0;
+            if (have_match && hm.ended_at > last_at) last_at = hm.ended_at;
+        }
+        if (n == cap) {
+            uint32_t grown_cap = cap ? cap * 2 : 1024;
+            LedgerRow* grown = (LedgerRow*)realloc(rows, sizeof(LedgerRow) * grown_cap);
+            if (!grown) { rc = -3; break; }
+            rows = grown;
+            cap = grown_cap;
+        }
+        LedgerRow* r = &rows[n++];
+        r->match_number = (uint32_t)match;
+        r->player_id = (uint32_t)player;
+        r->flags = LEDGER_IMPORTED;
+        r->at = last_at;
+        r->cards = (uint32_t)cards;
+        r->spend = money_from_units(spend);
+        r->payout = 0;
+        for (uint32_t k = 0; have_match && k < hm.winner_count; ++k)
+            if (hm.winners[k] == r->player_id) { r->payout = money_share(hm.paid, hm.winner_count, k); break; }
+        imported++;
+    }
+    fclose(f);
+    persist_history_close(h);
+    if (rc == 0 && idx.segment_count && index_write(idx_path, &idx) != 0) rc = -3;
+    if (rc == 0 && tail_write(tail_path, rows, n, idx.rows) != 0) rc = -3;
+    index_free(&idx);
+    free(rows);
+    return rc == 0 ? imported : rc;
+}
@@ -4,19 +4,28 @@
 #include <stdlib.h>
 #include "bingo.h"
 #include "config.h"
+#include "audit.h"
+#include "leaderboard.h"
 #include "persist.h"
+#include "session.h"
+#include "command.h"
+#include "server.h"
 
-#define MAX_ROSTER 512
+// Engine state, journal and background writer of this process.
+static Session session;
 
 static void clear_screen(void) {
 #ifdef _WIN32
     system("cls");
 #else
-    system("clear");
+    // ANSI clear + home instead of forking clear(1) on every menu loop
+    fputs("\033[2J\033[H", stdout);
 #endif
 }
 
 static void wait_for_enter(void) {
+    // have the writer make the operation just shown durable while the operator reads
+    writer_sync_journal(session.writer);
     printf("\nPress Enter to continue...");
     int c;
     // Consume leftover characters up to newline
@@ -37,7 +46,7 @@ static void print_menu(void) {
     printf("106- Remove winner\n");
     printf("7  - End match\n");
     printf("107- Cancel match (refund purchases)\n");
-    printf("8  - Show accounting / saved pot\n");
+    printf("8  - Show accounting / saved pot / audit\n");
     printf("9  - Set normal card cost\n");
     printf("10 - Set full house card cost\n");
     printf("11 - Set saved pot percentage\n");
@@ -47,18 +56,79 @@ static void print_menu(void) {
     printf("15 - Recharge player balance\n");
     printf("16 - Export players CSV (financial summary)\n");
     printf("17 - Save now (checkpoint)\n");
+    printf("18 - Import players CSV (name,balance)\n");
+    printf("19 - Leaderboards (top 10)\n");
     printf("0  - Exit\n");
     printf("Select: ");
 }
 
-static void list_players(Player* roster, uint32_t roster_count) {
-    printf("\nPlayers (%u):\n", roster_count);
-    for (uint32_t i = 0; i < roster_count; ++i) {
-        Player* p = &roster[i];
-        printf("ID:%u Name:%s Bal:%.2f W:%u L:%u D:%u CardsThisMatch:%u\n", p->id, p->name, p->balance, p->record.wins, p->record.losses, p->record.draws, p->cards_owned);
+// Lists the first malformed rows of an import; ctx counts them all.
+static void print_import_error(void* ctx, uint64_t line, const char* reason) {
+    uint32_t* bad = (uint32_t*)ctx;
+    if (++*bad <= 20) printf("line %llu: %s\n", (unsigned long long)line, reason);
+    else if (*bad == 21) printf("...\n");
+}
+
+static void list_players(const Roster* r) {
+    printf("\nPlayers (%u):\n", r->count);
+    for (uint32_t i = 0; i < r->slot_count; ++i) {
+        const Player* p = roster_at(r, i);
+        if (p->id == 0) continue;
+        printf("ID:%u Name:%s Bal:%.2f W:%u L:%u D:%u CardsThisMatch:%u\n", p->id, roster_name_at(r, i), money_units(p->balance), p->record.wins, p->record.losses, p->record.draws, p->cards_owned);
+    }
+}
+
+static void print_leaderboards(Roster* r) {
+    static const char* const titles[BOARD_COUNT] = {"Total won", "Net gain", "Cards bought", "Wins"};
+    BoardEntry top[10];
+    for (int k = 0; k < BOARD_COUNT; ++k) {
+        uint32_t n = leaderboard_top(r, (BoardKind)k, 10, top);
+        printf("\n%s:\n", titles[k]);
+        for (uint32_t i = 0; i < n; ++i) {
+            if (k == BOARD_WON || k == BOARD_NET) printf("%2u. %s (ID %u) %.2f\n", i + 1, engine_player_name(r, top[i].player_id), top[i].player_id, money_units(top[i].score));
+            else printf("%2u. %s (ID %u) %lld\n", i + 1, engine_player_name(r, top[i].player_id), top[i].player_id, (long long)top[i].score);
+        }
     }
 }
 
+// Participation remembered between matches: (player ID, cards) lines for match_buy_cards_batch,
+// with room for one status per line.
+typedef struct {
+    MatchPurchase* items;
+    int* status;
+    uint32_t count;
+    uint32_t capacity;
+} Participation;
+
+static int participation_reserve(Participation* pt, uint32_t n) {
+    if (n <= pt->capacity) return 0;
+    MatchPurchase* items = (MatchPurchase*)realloc(pt->items, (size_t)n * sizeof(MatchPurchase));
+    if (!items) return -1;
+    pt->items = items;
+    int* status = (int*)realloc(pt->status, (size_t)n * sizeof(int));
+    if (!status) return -1;
+    pt->status = status;
+    pt->capacity = n;
+    return 0;
+}
+
+// Buys the remembered lines and reports the skipped ones. Lines of removed players are dropped;
+// with `keep_bought` set, so is every line that could not be bought.
+static void participation_buy(Session* s, Participation* pt, int keep_bought) {
+    uint32_t n = pt->count;
+    int bought = match_buy_cards_batch(&s->match, &s->roster, pt->items, pt->count, pt->status);
+    if (bought < 0) { printf("Out of memory; no cards bought.\n"); return; }
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < pt->count; ++i) {
+        const MatchPurchase* it = &pt->items[i];
+        if (pt->status[i] == -3) printf("Player %u is no longer on the roster. Skipped.\n", it->player_id);
+        else if (pt->status[i] == -4) printf("Player %s lacks balance for %u cards (needs %.2f). Skipped.\n", engine_player_name(&s->roster, it->player_id), it->count, money_units(s->match.card_cost * (Money)it->count));
+        if (pt->status[i] == 0 || (!keep_bought && pt->status[i] != -3)) pt->items[kept++] = *it;
+    }
+    pt->count = kept;
+    printf("%d of %u players bought cards.\n", bought, n);
+}
+
 static GameMode ask_game_mode(void) {
     printf("Game Modes: 1-Normal (line/diagonal/corners) 2-FullHouse\nEnter mode number: ");
     int m = 0; if (scanf("%d", &m) != 1) { while (getchar()!='\n'); return GAME_NORMAL; }
@@ -69,22 +139,56 @@ static GameMode ask_game_mode(void) {
     }
 }
 
-int main(void) {
-    Accounting acc; engine_init(&acc);
-    // Attempt to load previous accounting
-    persist_load_accounting("data/accounting.bin", &acc);
-    Player roster[MAX_ROSTER];
-    uint32_t roster_count = 0;
-    // Attempt to load previous roster
-    persist_load_roster("data/roster.bin", roster, &roster_count, MAX_ROSTER);
-    Match current_match; memset(&current_match, 0, sizeof(current_match));
-    int has_active_match = 0;
+static void usage(void) {
+    printf("Usage: bingo [--max-players N]               interactive menu\n");
+    printf("       bingo [--max-players N] --batch [file] run commands from file or stdin (see docs/cli.md)\n");
+    printf("       bingo [--max-players N] --serve <unix:path|tcp:port> serve the same commands to local clients\n");
+    printf("       --max-players N: roster cap for this run (default %u)\n", cfg_get_max_players());
+}
+
+int main(int argc, char** argv) {
+    // leading option, applied before the roster is loaded; the mode arguments follow it
+    uint32_t max_players = 0;
+    if (argc > 1 && strcmp(argv[1], "--max-players") == 0) {
+        char* end = NULL;
+        unsigned long v = argc > 2 ? strtoul(argv[2], &end, 10) : 0;
+        if (!end || *end || v == 0 || v > UINT32_MAX - 1) { usage(); return 2; }
+        max_players = (uint32_t)v;
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+    int batch = argc > 1 && strcmp(argv[1], "--batch") == 0;
+    int serve = argc == 3 && strcmp(argv[1], "--serve") == 0;
+    if (argc > 1 && !serve && (!batch || argc > 3)) { usage(); return 2; }
+    FILE* script = stdin;
+    if (batch && argc == 3 && !(script = fopen(argv[2], "r"))) { fprintf(stderr, "Cannot open %s\n", argv[2]); return 1; }
+    Session* s = &session;
+    int opened = session_open(s, max_players);
+    if (opened < 0) {
+        if (opened == -2) fprintf(stderr, "%s is damaged; not starting, so it is not overwritten.\n", SESSION_ROSTER_PATH);
+        else if (opened == -3) fprintf(stderr, "%s is damaged; not starting, so it is not overwritten.\n", SESSION_ACCOUNTING_PATH);
+        else if (opened == -4) fprintf(stderr, "%s holds more than %u players; start with --max-players to raise the cap.\n", SESSION_ROSTER_PATH, cfg_get_max_players());
+        else fprintf(stderr, "Out of memory starting the session.\n");
+        return 1;
+    }
+    if (opened == 1) fprintf(batch || serve ? stderr : stdout, "Warning: journal unavailable (%s); changes are saved only at checkpoints.\n", SESSION_JOURNAL_PATH);
+    if (batch) {
+        int rc = command_run_stream(s, script, stdout);
+        if (script != stdin) fclose(script);
+        if (session_close(s) != 0) { fprintf(stderr, "Final save failed; the journal still holds the changes.\n"); rc = 1; }
+        return rc;
+    }
+    if (serve) {
+        int rc = server_run(s, argv[2]) == 0 ? 0 : 1;
+        if (rc) fprintf(stderr, "Cannot listen on %s\n", argv[2]);
+        if (session_close(s) != 0) { fprintf(stderr, "Final save failed; the journal still holds the changes.\n"); rc = 1; }
+        return rc;
+    }
+    int has_active_match = s->match.active;
 
     // Persistent participation configuration between matches
-    int last_participate[MAX_ROSTER];
-    uint32_t last_cards[MAX_ROSTER];
-    memset(last_participate, 0, sizeof(last_participate));
-    memset(last_cards, 0, sizeof(last_cards));
+    Participation last = {0};
 
     // Removed automatic seed players (Alice, Bob) to keep tests deterministic.
 
@@ -97,7 +201,7 @@ int main(void) {
         switch (choice) {
             case 1: // list players
                 clear_screen();
-                list_players(roster, roster_count);
+                list_players(&s->roster);
                 wait_for_enter();
                 break;
             case 2: { // add player
@@ -108,17 +212,20 @@ int main(void) {
                 scanf("%63s", name);
                 printf("Initial balance: ");
                 if (scanf("%lf", &bal) != 1) { bal = 0.0; }
-                int id = engine_add_player(roster, &roster_count, name, bal);
+                int id = engine_add_player(&s->roster, name, money_from_units(bal));
                 if (id < 0) printf("Failed to add player (max reached).\n");
-                else printf("Added player ID %d.\n", id);
+                else { printf("Added player ID %d.\n", id); session_log_add(s, (uint32_t)id); }
                 wait_for_enter();
             } break;
             case 3: { // remove
                 clear_screen();
                 uint32_t id; printf("Player ID to remove: ");
                 if (scanf("%u", &id) == 1) {
-                    if (engine_remove_player(roster, &roster_count, id) == 0) printf("Removed player %u.\n", id);
-                    else printf("Player not found.\n");
+                    if (engine_remove_player(&s->roster, id) == 0) {
+                        printf("Removed player %u.\n", id);
+                        char details[64]; snprintf(details, sizeof(details), "remove,id=%u", id);
+                        session_log(s, "remove", details);
+                    } else printf("Player not found.\n");
                 }
                 wait_for_enter();
             } break;
@@ -129,61 +236,47 @@ int main(void) {
                 double override_cost = 0.0;
                 printf("Override card cost (0 to use default): ");
                 scanf("%lf", &override_cost);
-                match_start(&current_match, gm, override_cost);
+                s->match.match_number = s->acc.next_match++;
+                match_start(&s->match, gm, money_from_units(override_cost));
                 has_active_match = 1;
-                printf("Match started (mode=%d, card_cost=%.2f).\n", gm, current_match.card_cost);
+                printf("Match started (mode=%d, card_cost=%.2f).\n", gm, money_units(s->match.card_cost));
 
                 // Ask to reuse last configuration for participation & card counts
-                if (roster_count > 0) {
-                    printf("Reuse last participation & card counts? (y/n): ");
+                if (s->roster.count > 0) {
                     char ans = 'n';
-                    scanf(" %c", &ans);
+                    if (last.count > 0) {
+                        printf("Reuse last participation & card counts? (y/n): ");
+                        scanf(" %c", &ans);
+                    }
                     if (ans == 'y' || ans == 'Y') {
-                        for (uint32_t i = 0; i < roster_count; ++i) {
-                            if (last_participate[i] && last_cards[i] > 0) {
-                                Player* p = &roster[i];
-                                double total_cost = current_match.card_cost * (double)last_cards[i];
-                                if (p->balance >= total_cost) {
-                                    match_buy_cards(&current_match, p, last_cards[i]);
-                                } else {
-                                    printf("Player %s lacks balance for %u cards (needs %.2f). Skipped.\n", p->name, last_cards[i], total_cost);
-                                }
-                            }
-                        }
+                        // one batch; removed players simply fail their line
+                        participation_buy(s, &last, 0);
+                    } else if (participation_reserve(&last, s->roster.count) != 0) {
+                        printf("Out of memory; skipping participation setup.\n");
                     } else {
                         // Gather new participation config
-                        for (uint32_t i = 0; i < roster_count; ++i) {
-                            Player* p = &roster[i];
-                            printf("Include player %s (ID:%u)? (y/n): ", p->name, p->id);
+                        last.count = 0;
+                        for (uint32_t i = 0; i < s->roster.slot_count; ++i) {
+                            Player* p = roster_at(&s->roster, i);
+                            if (p->id == 0) continue;
+                            const char* name = roster_name_at(&s->roster, i);
+                            printf("Include player %s (ID:%u)? (y/n): ", name, p->id);
                             char inc = 'n';
                             scanf(" %c", &inc);
-                            if (inc == 'y' || inc == 'Y') {
-                                last_participate[i] = 1;
-                                uint32_t cc = 0;
-                                printf("Cards to buy for %s: ", p->name);
-                                if (scanf("%u", &cc) != 1) cc = 0;
-                                last_cards[i] = cc;
-                                if (cc > 0) {
-                                    double total_cost = current_match.card_cost * (double)cc;
-                                    if (p->balance >= total_cost) {
-                                        match_buy_cards(&current_match, p, cc);
-                                    } else {
-                                        printf("Insufficient balance (needs %.2f). Purchase skipped.\n", total_cost);
-                                        last_cards[i] = 0; // revert
-                                    }
-                                }
-                            } else {
-                                last_participate[i] = 0; last_cards[i] = 0;
-                            }
+                            if (inc != 'y' && inc != 'Y') continue;
+                            uint32_t cc = 0;
+                            printf("Cards to buy for %s: ", name);
+                            if (scanf("%u", &cc) != 1) cc = 0;
+                            if (cc > 0) last.items[last.count++] = (MatchPurchase){p->id, cc};
                         }
+                        participation_buy(s, &last, 1);
                     }
                 }
                 // Show quick summary
-                printf("Match pot so far: %.2f\n", current_match.pot);
-                double save_pct = (gm == GAME_FULL_HOUSE) ? 0.0 : cfg_get_saved_pot_percentage();
-                double to_save = current_match.pot * save_pct;
-                double distributable = current_match.pot - to_save;
-                printf("Projected save: %.2f, distributable (before winners): %.2f\n", to_save, distributable);
+                printf("Match pot so far: %.2f\n", money_units(s->match.pot));
+                Money to_save = match_saved_share(&s->match);
+                Money distributable = s->match.pot - to_save;
+                printf("Projected save: %.2f, distributable (before winners): %.2f\n", money_units(to_save), money_units(distributable));
                 wait_for_enter();
             } break;
             case 5: { // buy cards
@@ -193,15 +286,16 @@ int main(void) {
                 if (scanf("%u", &id) != 1) break;
                 printf("Cards to buy: ");
                 if (scanf("%u", &count) != 1) break;
-                Player* p = engine_find_player(roster, roster_count, id);
+                Player* p = engine_find_player(&s->roster, id);
                 if (!p) { printf("Player not found.\n"); break; }
-                double total_cost = current_match.card_cost * (double)count;
-                if (p->balance < total_cost) { printf("Insufficient balance (need %.2f).\n", total_cost); break; }
-                match_buy_cards(&current_match, p, count);
+                Money total_cost = s->match.card_cost * (Money)count;
+                if (p->balance < total_cost) { printf("Insufficient balance (need %.2f).\n", money_units(total_cost)); break; }
+                int bought = match_buy_cards(&s->match, &s->roster, p, count);
+                if (bought != 0) { printf(bought == -2 ? "Out of memory; nothing bought.\n" : "Nothing bought (at least 1 card).\n"); break; }
                 printf("Player %u bought %u cards.\n", id, count);
                 {
-                    char details[128]; snprintf(details, sizeof(details), "buy,id=%u,count=%u,cost=%.2f", id, count, total_cost);
-                    persist_append_transaction("data/transactions.csv", "buy", details);
+                    char details[128]; snprintf(details, sizeof(details), "buy,id=%u,count=%u,cost=%.2f", id, count, money_units(total_cost));
+                    session_log(s, "buy", details);
                 }
                 wait_for_enter();
             } break;
@@ -210,7 +304,7 @@ int main(void) {
                 if (!has_active_match) { printf("No active match.\n"); break; }
                 uint32_t id; printf("Winner player ID: ");
                 if (scanf("%u", &id) != 1) break;
-                int r = match_add_winner(&current_match, roster, roster_count, id);
+                int r = match_add_winner(&s->match, &s->roster, id);
                 switch (r) {
                     case 0: printf("Added winner %u.\n", id); break;
                     case -1: printf("Match inactive.\n"); break;
@@ -228,7 +322,7 @@ int main(void) {
                 if (!has_active_match) { printf("No active match.\n"); break; }
                 uint32_t id; printf("Winner player ID to remove: ");
                 if (scanf("%u", &id) != 1) break;
-                int r = match_remove_winner(&current_match, id);
+                int r = match_remove_winner(&s->match, id);
                 if (r == 0) printf("Removed winner %u.\n", id);
                 else printf("Winner not found in current match.\n");
                 wait_for_enter();
@@ -237,57 +331,67 @@ int main(void) {
                 clear_screen();
                 if (!has_active_match) { printf("No active match.\n"); break; }
                 // Enforce at least one winner if there were participants (any cards bought)
-                int had_participants = 0;
-                for (uint32_t i = 0; i < roster_count; ++i) { if (roster[i].cards_owned > 0) { had_participants = 1; break; } }
-                if (had_participants && current_match.winner_count == 0) {
+                if (s->match.entry_count > 0 && s->match.winner_count == 0) {
                     printf("Cannot end match: at least one winner required (participants detected).\n");
                     wait_for_enter();
                     break;
                 }
-                match_end(&current_match, &acc, roster, roster_count);
+                match_end(&s->match, &s->acc, &s->roster);
                 has_active_match = 0;
-                printf("Match ended. Saved pot total: %.2f\n", acc.saved_pot);
-                // Ensure data directory exists (best-effort via system call omitted); save state
-                persist_save_roster("data/roster.bin", roster, roster_count);
-                persist_save_accounting("data/accounting.bin", &acc);
-                // Append match history (CSV-like)
-                persist_append_match("data/matches.csv", &current_match);
+                printf("Match ended. Saved pot total: %.2f\n", money_units(s->acc.saved_pot));
+                if (session_verify(s) != 0) printf("WARNING: books do not balance (see transactions.csv).\n");
+                // history and ledger rows first: the checkpoint trims the journal records they replay from
+                session_record_match(s);
+                session_checkpoint(s);
                 wait_for_enter();
             } break;
             case 107: { // cancel match
                 clear_screen();
                 if (!has_active_match) { printf("No active match.\n"); break; }
-                match_cancel(&current_match, roster, roster_count);
+                match_cancel(&s->match, &s->roster);
                 has_active_match = 0;
                 printf("Match cancelled. Purchases refunded.\n");
-                persist_save_roster("data/roster.bin", roster, roster_count);
-                persist_save_accounting("data/accounting.bin", &acc);
-                persist_append_transaction("data/transactions.csv", "cancel_match", "refunds issued");
+                if (session_verify(s) != 0) printf("WARNING: books do not balance (see transactions.csv).\n");
+                session_record_cancel(s);
+                session_checkpoint(s);
+                session_log(s, "cancel_match", "refunds issued");
                 wait_for_enter();
             } break;
             case 8: { // show accounting
                 clear_screen();
-                printf("Total matches: %u\n", acc.total_matches);
-                printf("Saved pot (for full house): %.2f\n", acc.saved_pot);
-                list_players(roster, roster_count);
+                printf("Total matches: %u\n", s->acc.total_matches);
+                printf("Saved pot (for full house): %.2f\n", money_units(s->acc.saved_pot));
+                const RosterTotals* tot = &s->roster.totals;
+                printf("Balances: %.2f = recharged %.2f - spent %.2f + won %.2f\n", money_units(tot->balances), money_units(tot->recharged), money_units(tot->spent), money_units(tot->won));
+                printf("Books: %s\n", audit_verify(&s->roster, &s->acc, &s->match, 1) == 0 ? "balanced" : "DO NOT BALANCE");
+                // full pass over every player, also a cross-check of the running totals above
+                AuditTotals t;
+                if (audit_roster(&s->roster, &t) != 0) printf("RECONCILIATION FAILED: %u player(s) off, %u negative (first: ID %u).\n", t.mismatched, t.negative, t.first_bad_id);
+                else if (audit_recount(&s->roster, &t) != 0) printf("RECONCILIATION FAILED: running totals differ from a recount (balances %.2f).\n", money_units(t.balance));
+                else printf("Reconciled: every balance matches its history.\n");
+                list_players(&s->roster);
                 wait_for_enter();
             } break;
             case 9: { // set normal cost
                 clear_screen();
                 double c; printf("New normal card cost: ");
-                if (scanf("%lf", &c) == 1) { cfg_set_normal_card_cost(c); printf("Updated normal card cost to %.2f\n", cfg_get_normal_card_cost()); }
+                if (scanf("%lf", &c) == 1) { cfg_set_normal_card_cost(money_from_units(c)); printf("Updated normal card cost to %.2f\n", money_units(cfg_get_normal_card_cost())); }
                 wait_for_enter();
             } break;
             case 10: { // set full house cost
                 clear_screen();
                 double c; printf("New full house card cost: ");
-                if (scanf("%lf", &c) == 1) { cfg_set_fullhouse_card_cost(c); printf("Updated full house card cost to %.2f\n", cfg_get_fullhouse_card_cost()); }
+                if (scanf("%lf", &c) == 1) { cfg_set_fullhouse_card_cost(money_from_units(c)); printf("Updated full house card cost to %.2f\n", money_units(cfg_get_fullhouse_card_cost())); }
                 wait_for_enter();
             } break;
             case 11: { // set saved pct
                 clear_screen();
                 double p; printf("New saved pot percentage (0-1): ");
-                if (scanf("%lf", &p) == 1) { cfg_set_saved_pot_percentage(p); printf("Saved pot percentage now %.2f\n", cfg_get_saved_pot_percentage()); }
+                if (scanf("%lf", &p) == 1) {
+                    // stored in basis points; a negative entry clamps to 0
+                    cfg_set_saved_pot_bp(p > 0.0 ? (uint32_t)(p < 1.0 ? p * MONEY_BP_SCALE + 0.5 : MONEY_BP_SCALE) : 0);
+                    printf("Saved pot percentage now %.2f\n", (double)cfg_get_saved_pot_bp() / MONEY_BP_SCALE);
+                }
                 wait_for_enter();
             } break;
             case 12: { // toggle multi winners
@@ -299,67 +403,89 @@ int main(void) {
             } break;
             case 13: { // show config
                 clear_screen();
-                printf("Normal card cost: %.2f\n", cfg_get_normal_card_cost());
-                printf("Full house card cost: %.2f\n", cfg_get_fullhouse_card_cost());
-                printf("Saved pot percentage: %.2f\n", cfg_get_saved_pot_percentage());
-                printf("Allow multi winners: %d\n", cfg_get_allow_multi_winners());
-                printf("Max players: %u\n", cfg_get_max_players());
+                const ConfigSnapshot* cfg = cfg_snapshot();
+                printf("Normal card cost: %.2f\n", money_units(cfg->normal_card_cost));
+                printf("Full house card cost: %.2f\n", money_units(cfg->fullhouse_card_cost));
+                printf("Saved pot percentage: %.2f\n", (double)cfg->saved_pot_bp / MONEY_BP_SCALE);
+                printf("Allow multi winners: %d\n", cfg->allow_multi_winners);
+                printf("Max players: %u\n", cfg->max_players);
                 wait_for_enter();
             } break;
             case 14: { // preview distribution
                 clear_screen();
                 if (!has_active_match) { printf("No active match.\n"); break; }
-                double save_pct = (current_match.mode == GAME_FULL_HOUSE) ? 0.0 : cfg_get_saved_pot_percentage();
-                double to_save = current_match.pot * save_pct;
-                double distributable = current_match.pot - to_save;
-                printf("Pot: %.2f SavePct: %.2f Saved: %.2f Distributable: %.2f WinnersSoFar:%u\n", current_match.pot, save_pct, to_save, distributable, current_match.winner_count);
-                if (current_match.winner_count > 0 && current_match.mode != GAME_FULL_HOUSE) {
-                    double per_winner = distributable / (double)current_match.winner_count;
-                    printf("Per winner payout (if ended now): %.2f\n", per_winner);
-                } else if (current_match.mode == GAME_FULL_HOUSE) {
-                    printf("Full house uses accumulated saved pot: %.2f (not current match pot unless configured).\n", acc.saved_pot);
+                double save_pct = (s->match.mode == GAME_FULL_HOUSE) ? 0.0 : (double)s->match.rules.saved_pot_bp / MONEY_BP_SCALE;
+                Money to_save = match_saved_share(&s->match);
+                Money distributable = s->match.pot - to_save;
+                printf("Pot: %.2f SavePct: %.2f Saved: %.2f Distributable: %.2f WinnersSoFar:%u\n", money_units(s->match.pot), save_pct, money_units(to_save), money_units(distributable), s->match.winner_count);
+                if (s->match.winner_count > 0 && s->match.mode != GAME_FULL_HOUSE) {
+                    uint32_t n = s->match.winner_count;
+                    printf("Per winner payout (if ended now): %.2f", money_units(money_share(distributable, n, n - 1)));
+                    if (distributable % n) printf(" (+0.01 for the first %u winners)", (uint32_t)(distributable % n));
+                    printf("\n");
+                } else if (s->match.mode == GAME_FULL_HOUSE) {
+                    printf("Full house uses accumulated saved pot: %.2f (not current match pot unless configured).\n", money_units(s->acc.saved_pot));
                 }
                 wait_for_enter();
             } break;
             case 15: { // recharge player balance
                 clear_screen();
-                uint32_t id; double amount;
+                uint32_t id; double units;
                 printf("Player ID to recharge: ");
                 if (scanf("%u", &id) != 1) break;
                 printf("Amount to add: ");
-                if (scanf("%lf", &amount) != 1) break;
-                if (amount <= 0.0) { printf("Amount must be positive.\n"); break; }
-                Player* p = engine_find_player(roster, roster_count, id);
-                if (!p) { printf("Player not found.\n"); break; }
-                p->balance += amount;
-                p->total_recharged += amount;
-                printf("Added %.2f to %s. New balance: %.2f\n", amount, p->name, p->balance);
-                // Persist immediately
-                persist_save_roster("data/roster.bin", roster, roster_count);
-                persist_save_accounting("data/accounting.bin", &acc);
+                if (scanf("%lf", &units) != 1) break;
+                Money amount = money_from_units(units);
+                if (amount <= 0) { printf("Amount must be positive.\n"); break; }
+                if (engine_recharge_player(&s->roster, id, amount) != 0) { printf("Player not found.\n"); break; }
+                printf("Added %.2f to %s. New balance: %.2f\n", money_units(amount), engine_player_name(&s->roster, id), money_units(engine_find_player(&s->roster, id)->balance));
+                // Persist in the background
+                session_checkpoint(s);
                 {
                     char details[128];
-                    snprintf(details, sizeof(details), "recharge,id=%u,amount=%.2f", id, amount);
-                    persist_append_transaction("data/transactions.csv", "recharge", details);
+                    snprintf(details, sizeof(details), "recharge,id=%u,amount=%.2f", id, money_units(amount));
+                    session_log(s, "recharge", details);
                 }
                 wait_for_enter();
             } break;
             case 16: { // export CSV
                 clear_screen();
-                if (persist_export_players_csv("data/players_summary.csv", roster, roster_count) == 0) {
+                if (persist_export_players_csv("data/players_summary.csv", &s->roster, 0) == 0) {
                     printf("Exported players summary to data/players_summary.csv\n");
                 } else {
                     printf("Failed to export CSV.\n");
                 }
-                persist_append_transaction("data/transactions.csv", "export_players", "players_summary.csv written");
+                session_log(s, "export_players", "players_summary.csv written");
                 wait_for_enter();
             } break;
             case 17: { // manual checkpoint save
                 clear_screen();
-                persist_save_roster("data/roster.bin", roster, roster_count);
-                persist_save_accounting("data/accounting.bin", &acc);
-                printf("Checkpoint saved.\n");
-                persist_append_transaction("data/transactions.csv", "checkpoint", "manual save");
+                int full = session_checkpoint(s);
+                session_log(s, "checkpoint", "manual save");
+                // barrier: report only once everything queued so far is on disk
+                if (writer_flush(s->writer) != 0) printf("Save failed; check the data directory.\n");
+                else if (full) printf("Checkpoint saved.\n");
+                else printf("Match in progress: journal synced; full checkpoint after the match ends.\n");
+                wait_for_enter();
+            } break;
+            case 18: { // bulk import
+                clear_screen();
+                char path[256];
+                printf("CSV file (name,balance rows): ");
+                if (scanf("%255s", path) != 1) break;
+                uint32_t bad = 0, first = 0;
+                int added = session_import_players(s, path, print_import_error, &bad, &first);
+                if (added >= 0) printf("Imported %d players (IDs %u-%u).\n", added, first, first + (uint32_t)added - (added > 0));
+                else if (added == -1) printf("Cannot read %s.\n", path);
+                else if (added == -2) printf("%u malformed rows; nothing imported.\n", bad);
+                else if (added == -3) printf("Too many players (max %u).\n", cfg_get_max_players());
+                else printf("Out of memory; only some players were imported.\n");
+                wait_for_enter();
+            } break;
+            case 19: { // leaderboards
+                clear_screen();
+                if (!s->roster.boards) printf("Leaderboards unavailable (out of memory at startup).\n");
+                else print_leaderboards(&s->roster);
                 wait_for_enter();
             } break;
             case 0:
@@ -370,8 +496,10 @@ int main(void) {
     }
 
     // Save on exit
-    persist_save_roster("data/roster.bin", roster, roster_count);
-    persist_save_accounting("data/accounting.bin", &acc);
+    if (s->match.active) printf("Active match kept in the journal; it resumes on next start.\n");
+    if (session_close(s) != 0) printf("Warning: final save failed; the journal still holds the changes.\n");
+    free(last.items);
+    free(last.status);
     printf("Exiting.\n");
     return 0;
 }
@@ -1,12 +1,43 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // fsync, fileno, pread, pwrite
+#endif
+#include <errno.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include "persist.h"
+#include "bingo.h"
 #include "types.h"
+#include "platform.h"
 
 #define ROSTER_MAGIC 0x42474F50 /* 'BGOP' */
-#define ROSTER_VERSION 2
+#define ROSTER_VERSION 3
 
+// v3 layout (little-endian): a 128-byte header, the chunk checksum table, then one page-aligned
+// block per roster chunk holding its Player array followed by its names (see docs/persistence.md).
+// Money fields are int64 cents, and total_recharged counts the opening balance. The header also
+// holds the Accounting checkpoint, so roster, accounting and journal position change together.
+#define ROSTER_PAGE 4096
+#define V3_HEADER_SIZE 128
+#define V3_PLAYERS_BYTES ((size_t)ROSTER_CHUNK_SIZE * sizeof(Player))
+#define V3_CHUNK_BYTES (V3_PLAYERS_BYTES + (size_t)ROSTER_CHUNK_SIZE * PLAYER_NAME_LEN)
+#define V3_TABLE_SLACK 64 // spare checksum entries, so the roster can grow 64 chunks between full rewrites
+
+// Chunk blocks are used in place, so Player must have exactly the file's record layout.
+_Static_assert(sizeof(Player) == 56, "v3 roster record is 56 bytes");
+_Static_assert(offsetof(Player, record) == 12 && offsetof(Player, balance) == 24 && offsetof(Player, total_won) == 48, "v3 roster record layout");
+_Static_assert(V3_PLAYERS_BYTES % ROSTER_PAGE == 0, "v3 name blocks start on a page");
+
+// v2 header (host byte order); v2 records follow field by field, 120 bytes each.
 typedef struct {
     uint32_t magic;
     uint16_t version;
@@ -17,114 +48,589 @@ typedef struct {
 /* Legacy player (v1) layout used for backward load (no monetary tracking) */
 typedef struct {
     uint32_t id;
-    char name[64];
+    char name[PLAYER_NAME_LEN];
     double balance;
     uint32_t wins; uint32_t losses; uint32_t draws;
     uint32_t cards_owned; uint32_t lifetime_cards;
 } PlayerLegacy;
 
-int persist_save_roster(const char* path, Player* roster, uint32_t roster_count) {
-    FILE* f = fopen(path, "wb");
+// Redo file of an incremental checkpoint (<roster>.redo, little-endian): a 24-byte header (magic,
+// uint16 version, uint16 reserved, uint32 patch count, uint32 reserved, uint64 file size), then
+// per patch a uint64 file offset, a uint64 length and the bytes, then a page_sum of all of it.
+#define REDO_MAGIC 0x44524742 /* 'BGRD' */
+#define REDO_VERSION 1
+#define REDO_HEADER_SIZE 24
+
+/* Legacy accounting (headerless raw struct, accounting.bin) */
+typedef struct {
+    double total_bank;
+    double saved_pot;
+    uint32_t total_matches;
+} AccountingLegacy;
+
+// fclose after pushing the data to the device, so a completed checkpoint survives power loss.
+static int close_synced(FILE* f) {
+    int rc = fflush(f);
+#ifdef _WIN32
+    if (rc == 0) rc = _commit(_fileno(f));
+#else
+    if (rc == 0) rc = fsync(fileno(f));
+#endif
+    if (fclose(f) != 0) rc = -1;
+    return rc == 0 ? 0 : -1;
+}
+
+static void put_u32(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; ++i) p[i] = (uint8_t)(v >> (8 * i)); }
+static void put_u64(uint8_t* p, uint64_t v) { for (int i = 0; i < 8; ++i) p[i] = (uint8_t)(v >> (8 * i)); }
+static uint32_t get_u32(const uint8_t* p) { return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24; }
+static uint64_t get_u64(const uint8_t* p) { return (uint64_t)get_u32(p) | (uint64_t)get_u32(p + 4) << 32; }
+
+static int host_le(void) { const uint16_t one = 1; return *(const uint8_t*)&one == 1; }
+static uint32_t swap32(uint32_t v) { return v >> 24 | (v >> 8 & 0xff00u) | (v << 8 & 0xff0000u) | v << 24; }
+static uint64_t swap64(uint64_t v) { return (uint64_t)swap32((uint32_t)v) << 32 | swap32((uint32_t)(v >> 32)); }
+static Money swap_money(Money m) { return (Money)swap64((uint64_t)m); }
+
+// Converts a Player between host order and the file's little-endian order (no-op on little-endian hosts).
+static void player_le(Player* p) {
+    if (host_le()) return;
+    p->id = swap32(p->id);
+    p->cards_owned = swap32(p->cards_owned);
+    p->lifetime_cards = swap32(p->lifetime_cards);
+    p->record.wins = swap32(p->record.wins);
+    p->record.losses = swap32(p->record.losses);
+    p->record.draws = swap32(p->record.draws);
+    p->balance = swap_money(p->balance);
+    p->total_recharged = swap_money(p->total_recharged);
+    p->total_spent = swap_money(p->total_spent);
+    p->total_won = swap_money(p->total_won);
+}
+
+// Fletcher-style sum over little-endian 32-bit words (n a multiple of 4); seed with PAGE_SUM_SEED.
+#define PAGE_SUM_SEED 1u
+static uint64_t page_sum(uint64_t sum, const uint8_t* p, size_t n) {
+    uint32_t a = (uint32_t)sum, b = (uint32_t)(sum >> 32);
+    for (size_t i = 0; i < n; i += 4) { a += get_u32(p + i); b += a; }
+    return (uint64_t)b << 32 | a;
+}
+
+static void accounting_fresh(Accounting* acc) {
+    memset(acc, 0, sizeof(*acc));
+    acc->next_match = 1;
+}
+
+// Slots of chunk c below slot_count.
+static uint32_t chunk_used(uint32_t slot_count, uint32_t c) {
+    uint32_t base = c << ROSTER_CHUNK_SHIFT;
+    return slot_count - base >= ROSTER_CHUNK_SIZE ? ROSTER_CHUNK_SIZE : slot_count - base;
+}
+
+// Checksum of the used part of chunk c as stored in the file.
+static uint64_t chunk_sum(const Roster* r, uint32_t c, uint32_t used) {
+    uint64_t sum = PAGE_SUM_SEED;
+    if (host_le()) {
+        sum = page_sum(sum, (const uint8_t*)r->chunks[c], (size_t)used * sizeof(Player));
+    } else {
+        for (uint32_t i = 0; i < used; ++i) {
+            Player p = r->chunks[c][i];
+            player_le(&p);
+            sum = page_sum(sum, (const uint8_t*)&p, sizeof(p));
+        }
+    }
+    return page_sum(sum, (const uint8_t*)r->name_chunks[c], (size_t)used * PLAYER_NAME_LEN);
+}
+
+typedef struct {
+    uint32_t slot_count;
+    uint32_t count;
+    uint32_t next_id;
+    uint32_t chunk_count;
+    uint32_t table_capacity;   // checksum entries reserved before the first chunk
+    uint32_t data_offset;      // first chunk block, page-aligned
+    Accounting acc;            // checkpoint saved with the roster
+} RosterV3Info;
+
+// Header area for `chunks` chunks plus growth slack, rounded up to whole pages.
+static void v3_layout(RosterV3Info* info, uint32_t chunks) {
+    size_t bytes = V3_HEADER_SIZE + ((size_t)chunks + V3_TABLE_SLACK) * 8;
+    info->data_offset = (uint32_t)((bytes + ROSTER_PAGE - 1) / ROSTER_PAGE * ROSTER_PAGE);
+    info->table_capacity = (info->data_offset - V3_HEADER_SIZE) / 8;
+}
+
+static void v3_encode_header(uint8_t* h, const RosterV3Info* info) {
+    memset(h, 0, V3_HEADER_SIZE);
+    put_u32(h, ROSTER_MAGIC);
+    h[4] = ROSTER_VERSION; // uint16 version, little-endian
+    put_u32(h + 8, info->slot_count);
+    put_u32(h + 12, info->count);
+    put_u32(h + 16, info->next_id);
+    put_u32(h + 20, info->chunk_count);
+    put_u32(h + 24, info->table_capacity);
+    put_u32(h + 28, info->data_offset);
+    put_u64(h + 32, info->acc.journal_seq);
+    put_u64(h + 40, (uint64_t)info->acc.total_bank);
+    put_u64(h + 48, (uint64_t)info->acc.saved_pot);
+    put_u32(h + 56, info->acc.total_matches);
+    put_u32(h + 60, info->acc.next_match);
+}
+
+static uint64_t v3_header_sum(const uint8_t* h, const uint8_t* table, uint32_t chunk_count) {
+    return page_sum(page_sum(PAGE_SUM_SEED, h, V3_HEADER_SIZE - 8), table, (size_t)chunk_count * 8);
+}
+
+// Decodes and sanity-checks a v3 header; the table sum is checked separately. -3 if malformed.
+static int v3_decode_header(const uint8_t* h, RosterV3Info* info) {
+    if (get_u32(h) != ROSTER_MAGIC || h[4] != ROSTER_VERSION || h[5] != 0) return -3;
+    info->slot_count = get_u32(h + 8);
+    info->count = get_u32(h + 12);
+    info->next_id = get_u32(h + 16);
+    info->chunk_count = get_u32(h + 20);
+    info->table_capacity = get_u32(h + 24);
+    info->data_offset = get_u32(h + 28);
+    info->acc.journal_seq = get_u64(h + 32);
+    info->acc.total_bank = (Money)get_u64(h + 40);
+    info->acc.saved_pot = (Money)get_u64(h + 48);
+    info->acc.total_matches = get_u32(h + 56);
+    info->acc.next_match = get_u32(h + 60);
+    if (info->acc.next_match <= info->acc.total_matches) return -3;
+    uint32_t chunks = (uint32_t)(((uint64_t)info->slot_count + ROSTER_CHUNK_SIZE - 1) >> ROSTER_CHUNK_SHIFT);
+    if (info->chunk_count != chunks || info->count > info->slot_count || info->table_capacity < chunks) return -3;
+    if (info->data_offset % ROSTER_PAGE != 0 || (uint64_t)info->data_offset < V3_HEADER_SIZE + (uint64_t)info->table_capacity * 8) return -3;
+    return 0;
+}
+
+static int replace_file(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : -1;
+#else
+    return rename(from, to) == 0 ? 0 : -1;
+#endif
+}
+
+// `path` with `ext` appended (malloc'd), for the temp and redo files beside the roster.
+static char* side_path(const char* path, const char* ext) {
+    size_t plen = strlen(path), elen = strlen(ext);
+    char* s = (char*)malloc(plen + elen + 1);
+    if (s) { memcpy(s, path, plen); memcpy(s + plen, ext, elen + 1); }
+    return s;
+}
+
+// Makes a new file's directory entry durable, so a crash cannot lose the file after its data
+// was synced. Windows commits the entry with the file.
+static int sync_dir(const char* path) {
+#ifdef _WIN32
+    (void)path;
+    return 0;
+#else
+    const char* slash = strrchr(path, '/');
+    char* dir = slash ? side_path(path, "") : NULL;
+    if (slash && !dir) return -1;
+    if (dir) dir[slash == path ? 1 : slash - path] = '\0';
+    int fd = open(dir ? dir : ".", O_RDONLY);
+    free(dir);
+    if (fd < 0) return -1;
+    int rc = fsync(fd);
+    if (close(fd) != 0) rc = -1;
+    return rc == 0 ? 0 : -1;
+#endif
+}
+
+static int remove_if_present(const char* path) {
+    return remove(path) == 0 || errno == ENOENT ? 0 : -1;
+}
+
+static int write_zeros(FILE* f, size_t n) {
+    static const uint8_t zeros[ROSTER_PAGE];
+    while (n) {
+        size_t k = n < sizeof(zeros) ? n : sizeof(zeros);
+        if (fwrite(zeros, 1, k, f) != k) return -1;
+        n -= k;
+    }
+    return 0;
+}
+
+int persist_save_roster(const char* path, Roster* r, const Accounting* acc) {
+    roster_compact(r);
+    RosterV3Info info;
+    if (acc) info.acc = *acc;
+    else accounting_fresh(&info.acc);
+    info.slot_count = r->slot_count;
+    info.count = r->count;
+    info.next_id = r->next_id;
+    info.chunk_count = (r->slot_count + ROSTER_CHUNK_SIZE - 1) >> ROSTER_CHUNK_SHIFT;
+    v3_layout(&info, info.chunk_count);
+    // the new file is built beside the old one, which may still be mapped by a loaded roster
+    char* tmp = side_path(path, ".tmp");
+    char* redo = side_path(path, ".redo");
+    uint8_t* head = (uint8_t*)calloc(info.data_offset, 1);
+    FILE* f = tmp && redo ? fopen(tmp, "wb") : NULL;
+    if (!head || !f) { if (f) { fclose(f); remove(tmp); } free(tmp); free(redo); free(head); return -1; }
+    int ok = fwrite(head, info.data_offset, 1, f) == 1;
+    for (uint32_t c = 0; ok && c < info.chunk_count; ++c) {
+        uint32_t used = chunk_used(r->slot_count, c);
+        if (host_le()) {
+            ok = fwrite(r->chunks[c], sizeof(Player), used, f) == used;
+        } else {
+            for (uint32_t i = 0; ok && i < used; ++i) {
+                Player p = r->chunks[c][i];
+                player_le(&p);
+                ok = fwrite(&p, sizeof(p), 1, f) == 1;
+            }
+        }
+        ok = ok && write_zeros(f, (size_t)(ROSTER_CHUNK_SIZE - used) * sizeof(Player)) == 0;
+        ok = ok && fwrite(r->name_chunks[c], PLAYER_NAME_LEN, used, f) == used;
+        ok = ok && write_zeros(f, (size_t)(ROSTER_CHUNK_SIZE - used) * PLAYER_NAME_LEN) == 0;
+        put_u64(head + V3_HEADER_SIZE + (size_t)c * 8, chunk_sum(r, c, used));
+    }
+    v3_encode_header(head, &info);
+    put_u64(head + V3_HEADER_SIZE - 8, v3_header_sum(head, head + V3_HEADER_SIZE, info.chunk_count));
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(head, V3_HEADER_SIZE + (size_t)info.chunk_count * 8, 1, f) == 1;
+    if (close_synced(f) != 0) ok = 0;
+    // a redo file left by a failed incremental save belongs to the file being replaced
+    ok = ok && remove_if_present(redo) == 0 && replace_file(tmp, path) == 0;
+    if (!ok) remove(tmp);
+    free(tmp);
+    free(redo);
+    free(head);
+    if (!ok) return -1;
+    r->needs_rewrite = 0; // slots now match the file
+    return 0;
+}
+
+static int cmp_slot(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+int persist_roster_delta(RosterDelta* d, Roster* r, const Accounting* acc) {
+    memset(d, 0, sizeof(*d));
+    d->acc = *acc;
+    d->slot_count = r->slot_count;
+    d->live_count = r->count;
+    d->next_id = r->next_id;
+    d->chunk_count = (r->slot_count + ROSTER_CHUNK_SIZE - 1) >> ROSTER_CHUNK_SHIFT;
+    uint32_t n = r->dirty_count;
+    if (n) {
+        d->slots = (uint32_t*)malloc((size_t)n * sizeof(uint32_t));
+        d->players = (Player*)malloc((size_t)n * sizeof(Player));
+        d->names = (char*)malloc((size_t)n * PLAYER_NAME_LEN);
+        d->sum_chunks = (uint32_t*)malloc((size_t)n * sizeof(uint32_t));
+        d->sums = (uint64_t*)malloc((size_t)n * sizeof(uint64_t));
+        if (!d->slots || !d->players || !d->names || !d->sum_chunks || !d->sums) { persist_roster_delta_free(d); return -1; }
+        memcpy(d->slots, r->dirty_slots, (size_t)n * sizeof(uint32_t));
+        d->count = n;
+        // ascending slots so adjacent records go out in one write
+        qsort(d->slots, n, sizeof(uint32_t), cmp_slot);
+        for (uint32_t i = 0; i < n; ++i) {
+            uint32_t slot = d->slots[i];
+            d->players[i] = *roster_at(r, slot);
+            player_le(&d->players[i]);
+            memcpy(d->names + (size_t)i * PLAYER_NAME_LEN, roster_name_at(r, slot), PLAYER_NAME_LEN);
+            uint32_t c = slot >> ROSTER_CHUNK_SHIFT;
+            if (d->sum_count && d->sum_chunks[d->sum_count - 1] == c) continue;
+            d->sum_chunks[d->sum_count] = c;
+            d->sums[d->sum_count++] = chunk_sum(r, c, chunk_used(r->slot_count, c));
+        }
+    }
+    roster_clear_dirty(r);
+    return 0;
+}
+
+void persist_roster_delta_free(RosterDelta* d) {
+    free(d->slots);
+    free(d->players);
+    free(d->names);
+    free(d->sum_chunks);
+    free(d->sums);
+    memset(d, 0, sizeof(*d));
+}
+
+#ifdef _WIN32
+static int r_open(const char* path, int writable) { return _open(path, (writable ? _O_RDWR : _O_RDONLY) | _O_BINARY); }
+static long long r_size(int fd) { return _lseeki64(fd, 0, SEEK_END); }
+static long long r_pread(int fd, void* p, size_t n, long long off) { return _lseeki64(fd, off, SEEK_SET) < 0 ? -1 : _read(fd, p, (unsigned)n); }
+static long long r_pwrite(int fd, const void* p, size_t n, long long off) { return _lseeki64(fd, off, SEEK_SET) < 0 ? -1 : _write(fd, p, (unsigned)n); }
+static int r_truncate(int fd, long long len) { return _chsize_s(fd, len) == 0 ? 0 : -1; }
+static int r_fsync(int fd) { return _commit(fd); }
+static int r_close(int fd) { return _close(fd); }
+#else
+static int r_open(const char* path, int writable) { return open(path, writable ? O_RDWR : O_RDONLY); }
+static long long r_size(int fd) { return (long long)lseek(fd, 0, SEEK_END); }
+static long long r_pread(int fd, void* p, size_t n, long long off) { return (long long)pread(fd, p, n, (off_t)off); }
+static long long r_pwrite(int fd, const void* p, size_t n, long long off) { return (long long)pwrite(fd, p, n, (off_t)off); }
+static int r_truncate(int fd, long long len) { return ftruncate(fd, (off_t)len); }
+static int r_fsync(int fd) { return fsync(fd); }
+static int r_close(int fd) { return close(fd); }
+#endif
+
+// One write of an incremental checkpoint.
+typedef struct {
+    long long offset;
+    const void* data;
+    size_t len;                // a multiple of 4, as page_sum needs
+} RosterPatch;
+
+static int redo_write(const char* redo, const RosterPatch* patches, uint32_t n, long long size) {
+    FILE* f = fopen(redo, "wb");
     if (!f) return -1;
-    RosterHeader hdr; hdr.magic = ROSTER_MAGIC; hdr.version = ROSTER_VERSION; hdr.reserved = 0; hdr.count = roster_count;
-    fwrite(&hdr, sizeof(hdr), 1, f);
-    for (uint32_t i = 0; i < roster_count; ++i) {
-        Player* p = &roster[i];
-        fwrite(&p->id, sizeof(p->id), 1, f);
-        fwrite(p->name, sizeof(p->name), 1, f);
-        fwrite(&p->balance, sizeof(p->balance), 1, f);
-        fwrite(&p->record.wins, sizeof(p->record.wins), 1, f);
-        fwrite(&p->record.losses, sizeof(p->record.losses), 1, f);
-        fwrite(&p->record.draws, sizeof(p->record.draws), 1, f);
-        fwrite(&p->cards_owned, sizeof(p->cards_owned), 1, f);
-        fwrite(&p->lifetime_cards, sizeof(p->lifetime_cards), 1, f);
-        fwrite(&p->total_recharged, sizeof(p->total_recharged), 1, f);
-        fwrite(&p->total_spent, sizeof(p->total_spent), 1, f);
-        fwrite(&p->total_won, sizeof(p->total_won), 1, f);
+    uint8_t h[REDO_HEADER_SIZE] = {0};
+    put_u32(h, REDO_MAGIC);
+    h[4] = REDO_VERSION;
+    put_u32(h + 8, n);
+    put_u64(h + 16, (uint64_t)size);
+    uint64_t sum = page_sum(PAGE_SUM_SEED, h, sizeof(h));
+    int ok = fwrite(h, sizeof(h), 1, f) == 1;
+    for (uint32_t i = 0; ok && i < n; ++i) {
+        uint8_t ph[16];
+        put_u64(ph, (uint64_t)patches[i].offset);
+        put_u64(ph + 8, patches[i].len);
+        sum = page_sum(page_sum(sum, ph, sizeof(ph)), (const uint8_t*)patches[i].data, patches[i].len);
+        ok = fwrite(ph, sizeof(ph), 1, f) == 1 && fwrite(patches[i].data, 1, patches[i].len, f) == patches[i].len;
     }
+    uint8_t t[8];
+    put_u64(t, sum);
+    ok = ok && fwrite(t, sizeof(t), 1, f) == 1;
+    if (close_synced(f) != 0) ok = 0;
+    ok = ok && sync_dir(redo) == 0;
+    if (!ok) remove(redo);
+    return ok ? 0 : -1;
+}
+
+// Grows the file to `size` (new chunks get their full block, so a mapping covers every slot),
+// writes the patches and fsyncs.
+static int patches_apply(int fd, const RosterPatch* patches, uint32_t n, long long size) {
+    if (r_size(fd) < size && r_truncate(fd, size) != 0) return -1;
+    for (uint32_t i = 0; i < n; ++i)
+        if (r_pwrite(fd, patches[i].data, patches[i].len, patches[i].offset) != (long long)patches[i].len) return -1;
+    return r_fsync(fd) == 0 ? 0 : -1;
+}
+
+// Finishes an incremental checkpoint that stopped after its redo file was complete: the patches
+// are written again (whole records, so writing twice is harmless). A torn redo file was cut
+// short before the roster was touched and is dropped. 0 ok, -3 the roster could not be repaired.
+static int redo_recover(const char* path) {
+    char* redo = side_path(path, ".redo");
+    if (!redo) return -4;
+    FILE* f = fopen(redo, "rb");
+    if (!f) { free(redo); return 0; }
+    long size = fseek(f, 0, SEEK_END) == 0 ? ftell(f) : -1;
+    uint8_t* buf = size >= REDO_HEADER_SIZE + 8 && size % 4 == 0 ? (uint8_t*)malloc((size_t)size) : NULL;
+    int whole = buf && fseek(f, 0, SEEK_SET) == 0 && fread(buf, (size_t)size, 1, f) == 1;
     fclose(f);
+    size_t body = whole ? (size_t)size - 8 : 0;
+    uint32_t n = whole ? get_u32(buf + 8) : 0;
+    int valid = whole && get_u32(buf) == REDO_MAGIC && buf[4] == REDO_VERSION && buf[5] == 0
+        && page_sum(PAGE_SUM_SEED, buf, body) == get_u64(buf + body) && n <= body / 16;
+    RosterPatch* patches = valid ? (RosterPatch*)malloc(((size_t)n + 1) * sizeof(RosterPatch)) : NULL;
+    int rc = valid && !patches ? -4 : 0;
+    size_t at = REDO_HEADER_SIZE;
+    for (uint32_t i = 0; patches && i < n; ++i) {
+        // the sum matched, so a bad length means a malformed file rather than a torn one
+        if (at + 16 > body || get_u64(buf + at + 8) > body - at - 16 || get_u64(buf + at + 8) % 4 != 0) { rc = -3; break; }
+        patches[i].offset = (long long)get_u64(buf + at);
+        patches[i].len = (size_t)get_u64(buf + at + 8);
+        patches[i].data = buf + at + 16;
+        at += 16 + patches[i].len;
+    }
+    if (rc == 0 && patches && at != body) rc = -3;
+    if (rc == 0 && patches) {
+        int fd = r_open(path, 1);
+        if (fd < 0 || patches_apply(fd, patches, n, (long long)get_u64(buf + 16)) != 0) rc = -3;
+        if (fd >= 0 && r_close(fd) != 0) rc = -3;
+    }
+    // kept while the roster is not repaired, so the next start tries again
+    if (rc == 0 && remove(redo) != 0) rc = -3;
+    free(patches);
+    free(buf);
+    free(redo);
+    return rc;
+}
+
+int persist_write_roster_delta(const char* path, const RosterDelta* d) {
+    int fd = r_open(path, 1);
+    if (fd < 0) return -2;
+    uint8_t h[V3_HEADER_SIZE];
+    RosterV3Info info;
+    // a v2 or legacy file fails to decode: the roster was loaded with needs_rewrite set
+    if (r_pread(fd, h, sizeof(h), 0) != (long long)sizeof(h) || v3_decode_header(h, &info) != 0
+        || info.slot_count > d->slot_count || d->chunk_count > info.table_capacity) { r_close(fd); return -2; }
+    size_t table_bytes = (size_t)d->chunk_count * 8;
+    uint8_t* table = (uint8_t*)calloc(table_bytes ? table_bytes : 1, 1);
+    RosterPatch* patches = (RosterPatch*)malloc(((size_t)d->count * 2 + 2) * sizeof(RosterPatch));
+    char* redo = side_path(path, ".redo");
+    int rc = table && patches && redo ? 0 : -1;
+    if (rc == 0 && r_pread(fd, table, (size_t)info.chunk_count * 8, V3_HEADER_SIZE) != (long long)info.chunk_count * 8) rc = -1;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < d->count && rc == 0;) {
+        // one write for the players and one for the names of each run of adjacent slots
+        uint32_t slot = d->slots[i], run = 1;
+        while (i + run < d->count && d->slots[i + run] == slot + run && (slot + run) & (ROSTER_CHUNK_SIZE - 1)) run++;
+        long long chunk = (long long)info.data_offset + (long long)(slot >> ROSTER_CHUNK_SHIFT) * V3_CHUNK_BYTES;
+        uint32_t pos = slot & (ROSTER_CHUNK_SIZE - 1);
+        patches[n].offset = chunk + (long long)pos * (long long)sizeof(Player);
+        patches[n].data = &d->players[i];
+        patches[n++].len = (size_t)run * sizeof(Player);
+        patches[n].offset = chunk + (long long)V3_PLAYERS_BYTES + (long long)pos * PLAYER_NAME_LEN;
+        patches[n].data = d->names + (size_t)i * PLAYER_NAME_LEN;
+        patches[n++].len = (size_t)run * PLAYER_NAME_LEN;
+        i += run;
+    }
+    if (rc == 0) {
+        for (uint32_t i = 0; i < d->sum_count; ++i) put_u64(table + (size_t)d->sum_chunks[i] * 8, d->sums[i]);
+        info.slot_count = d->slot_count;
+        info.count = d->live_count;
+        info.next_id = d->next_id;
+        info.chunk_count = d->chunk_count;
+        info.acc = d->acc;
+        v3_encode_header(h, &info);
+        put_u64(h + V3_HEADER_SIZE - 8, v3_header_sum(h, table, d->chunk_count));
+        patches[n].offset = V3_HEADER_SIZE;
+        patches[n].data = table;
+        patches[n++].len = table_bytes;
+        patches[n].offset = 0;
+        patches[n].data = h;
+        patches[n++].len = sizeof(h);
+        // The patches are durable in the redo file before the roster changes: a crash while
+        // patching is finished by the next load, a torn redo file leaves the old checkpoint.
+        long long end = (long long)info.data_offset + (long long)d->chunk_count * V3_CHUNK_BYTES;
+        if (redo_write(redo, patches, n, end) != 0 || patches_apply(fd, patches, n, end) != 0) rc = -1;
+    }
+    if (r_close(fd) != 0) rc = -1;
+    // on failure a complete redo file stays, for the next full save or load to settle
+    if (rc == 0 && remove(redo) != 0) rc = -1;
+    free(redo);
+    free(patches);
+    free(table);
+    return rc;
+}
+
+// v3 load: map the file and use its chunk blocks as roster storage (POSIX, little-endian hosts),
+// otherwise read each block straight into heap chunks. Every chunk checksum is verified.
+static int load_roster_v3(int fd, Roster* r, uint32_t max_players, Accounting* acc) {
+    long long size = r_size(fd);
+    uint8_t h[V3_HEADER_SIZE];
+    RosterV3Info info;
+    if (size < V3_HEADER_SIZE || r_pread(fd, h, sizeof(h), 0) != (long long)sizeof(h) || v3_decode_header(h, &info) != 0) return -3;
+    if (info.slot_count > max_players) return -2;
+    if ((uint64_t)size < (uint64_t)info.data_offset + (uint64_t)info.chunk_count * V3_CHUNK_BYTES) return -3;
+    uint8_t* map = host_le() ? (uint8_t*)plat_map_private(fd, (size_t)size) : NULL;
+    uint8_t* table = map ? map + V3_HEADER_SIZE : (uint8_t*)malloc((size_t)info.chunk_count * 8 + 1);
+    Player** chunks = (Player**)malloc(((size_t)info.chunk_count + 1) * sizeof(Player*));
+    char** names = (char**)malloc(((size_t)info.chunk_count + 1) * sizeof(char*));
+    int rc = table && chunks && names ? 0 : -4;
+    if (rc == 0 && !map && r_pread(fd, table, (size_t)info.chunk_count * 8, V3_HEADER_SIZE) != (long long)info.chunk_count * 8) rc = -3;
+    if (rc == 0 && get_u64(h + V3_HEADER_SIZE - 8) != v3_header_sum(h, table, info.chunk_count)) rc = -3;
+    uint32_t ready = 0; // heap chunks allocated so far (read path)
+    for (uint32_t c = 0; rc == 0 && c < info.chunk_count; ++c) {
+        uint32_t used = chunk_used(info.slot_count, c);
+        long long off = (long long)info.data_offset + (long long)c * V3_CHUNK_BYTES;
+        if (map) {
+            chunks[c] = (Player*)(map + off);
+            names[c] = (char*)(map + off + V3_PLAYERS_BYTES);
+        } else {
+            chunks[c] = (Player*)malloc(V3_PLAYERS_BYTES);
+            names[c] = (char*)malloc((size_t)ROSTER_CHUNK_SIZE * PLAYER_NAME_LEN);
+            ready = c + 1;
+            if (!chunks[c] || !names[c]) { rc = -4; break; }
+            if (r_pread(fd, chunks[c], (size_t)used * sizeof(Player), off) != (long long)used * (long long)sizeof(Player)
+                || r_pread(fd, names[c], (size_t)used * PLAYER_NAME_LEN, off + V3_PLAYERS_BYTES) != (long long)used * PLAYER_NAME_LEN) { rc = -3; break; }
+        }
+        uint64_t sum = page_sum(PAGE_SUM_SEED, (const uint8_t*)chunks[c], (size_t)used * sizeof(Player));
+        sum = page_sum(sum, (const uint8_t*)names[c], (size_t)used * PLAYER_NAME_LEN);
+        if (sum != get_u64(table + (size_t)c * 8)) { rc = -3; break; }
+        if (!map) for (uint32_t i = 0; i < used; ++i) player_le(&chunks[c][i]);
+    }
+    if (rc == 0 && roster_adopt_chunks(r, chunks, names, info.chunk_count, map, map ? (size_t)size : 0) != 0) rc = -4;
+    if (!map) free(table);
+    if (rc != 0) {
+        for (uint32_t c = 0; c < ready; ++c) { free(chunks[c]); free(names[c]); }
+        free(chunks);
+        free(names);
+        if (map) plat_unmap(map, (size_t)size);
+        return rc;
+    }
+    r->slot_count = info.slot_count;
+    if (roster_reindex(r) != 0) return -4;
+    if (info.next_id > r->next_id) r->next_id = info.next_id; // IDs of removed players stay retired
+    r->needs_rewrite = 0;
+    if (acc) *acc = info.acc;
     return 0;
 }
 
-int persist_load_roster(const char* path, Player* roster, uint32_t* roster_count, uint32_t max_players) {
+int persist_load_roster(const char* path, Roster* r, uint32_t max_players, Accounting* acc) {
+    int rc = redo_recover(path);
+    if (rc != 0) return rc;
     FILE* f = fopen(path, "rb");
     if (!f) return -1;
-    RosterHeader hdr; size_t rh = fread(&hdr, sizeof(hdr), 1, f);
-    if (rh == 1 && hdr.magic == ROSTER_MAGIC && hdr.version >= 2) {
+    uint8_t raw[sizeof(RosterHeader)];
+    size_t rh = fread(raw, sizeof(raw), 1, f);
+    RosterHeader hdr; memcpy(&hdr, raw, sizeof(hdr));
+    if (rh == 1 && get_u32(raw) == ROSTER_MAGIC && raw[4] == ROSTER_VERSION && raw[5] == 0) {
+        fclose(f);
+        int fd = r_open(path, 0);
+        if (fd < 0) return -1;
+        rc = load_roster_v3(fd, r, max_players, acc);
+        r_close(fd); // a mapping stays valid after the descriptor is closed
+        return rc;
+    }
+    // v2 and legacy files are migration paths: decoded field by field, rewritten as v3 on the next checkpoint
+    if (rh == 1 && hdr.magic == ROSTER_MAGIC && hdr.version == 2) {
         if (hdr.count > max_players) { fclose(f); return -2; }
+        if (roster_reserve(r, hdr.count) != 0) { fclose(f); return -4; }
         for (uint32_t i = 0; i < hdr.count; ++i) {
-            Player* p = &roster[i]; memset(p, 0, sizeof(Player));
-            fread(&p->id, sizeof(p->id), 1, f);
-            fread(p->name, sizeof(p->name), 1, f);
-            fread(&p->balance, sizeof(p->balance), 1, f);
-            fread(&p->record.wins, sizeof(p->record.wins), 1, f);
-            fread(&p->record.losses, sizeof(p->record.losses), 1, f);
-            fread(&p->record.draws, sizeof(p->record.draws), 1, f);
-            fread(&p->cards_owned, sizeof(p->cards_owned), 1, f);
-            fread(&p->lifetime_cards, sizeof(p->lifetime_cards), 1, f);
-            fread(&p->total_recharged, sizeof(p->total_recharged), 1, f);
-            fread(&p->total_spent, sizeof(p->total_spent), 1, f);
-            fread(&p->total_won, sizeof(p->total_won), 1, f);
+            Player* p = roster_at(r, i); memset(p, 0, sizeof(Player));
+            char* name = roster_name_at(r, i);
+            double money[4] = {0, 0, 0, 0}; // balance, recharged, spent, won in units
+            size_t rd = fread(&p->id, sizeof(p->id), 1, f);
+            rd += fread(name, PLAYER_NAME_LEN, 1, f);
+            rd += fread(&money[0], sizeof(double), 1, f);
+            rd += fread(&p->record.wins, sizeof(p->record.wins), 1, f);
+            rd += fread(&p->record.losses, sizeof(p->record.losses), 1, f);
+            rd += fread(&p->record.draws, sizeof(p->record.draws), 1, f);
+            rd += fread(&p->cards_owned, sizeof(p->cards_owned), 1, f);
+            rd += fread(&p->lifetime_cards, sizeof(p->lifetime_cards), 1, f);
+            rd += fread(&money[1], sizeof(double), 3, f);
+            if (rd != 11) { fclose(f); return -3; } // truncated file
+            name[PLAYER_NAME_LEN - 1] = '\0';
+            p->balance = money_from_units(money[0]);
+            p->total_recharged = money_from_units(money[1]);
+            p->total_spent = money_from_units(money[2]);
+            p->total_won = money_from_units(money[3]);
         }
-        *roster_count = hdr.count;
+        r->slot_count = hdr.count;
         fclose(f);
-        return 0;
+        return roster_reindex(r) == 0 ? 0 : -4; // needs_rewrite stays set: next checkpoint upgrades the file
     }
     // Legacy fallback: rewind and read old format
     fseek(f, 0, SEEK_SET);
-    uint32_t count = 0; fread(&count, sizeof(uint32_t), 1, f);
+    uint32_t count = 0;
+    if (fread(&count, sizeof(uint32_t), 1, f) != 1) { fclose(f); return -3; }
     if (count > max_players) { fclose(f); return -2; }
+    if (roster_reserve(r, count) != 0) { fclose(f); return -4; }
     for (uint32_t i = 0; i < count; ++i) {
         PlayerLegacy lp; size_t rd = fread(&lp, sizeof(lp), 1, f);
         if (rd != 1) { fclose(f); return -3; }
-        Player* p = &roster[i]; memset(p, 0, sizeof(Player));
-        p->id = lp.id; strncpy(p->name, lp.name, sizeof(p->name)); p->name[63] = '\0';
-        p->balance = lp.balance; p->record.wins = lp.wins; p->record.losses = lp.losses; p->record.draws = lp.draws;
+        Player* p = roster_at(r, i); memset(p, 0, sizeof(Player));
+        char* name = roster_name_at(r, i);
+        p->id = lp.id; memcpy(name, lp.name, PLAYER_NAME_LEN); name[PLAYER_NAME_LEN - 1] = '\0';
+        p->balance = money_from_units(lp.balance); p->record.wins = lp.wins; p->record.losses = lp.losses; p->record.draws = lp.draws;
         p->cards_owned = lp.cards_owned; p->lifetime_cards = lp.lifetime_cards;
-        p->total_recharged = 0.0; p->total_spent = 0.0; p->total_won = 0.0; // unknown for legacy
+        p->total_recharged = 0; p->total_spent = 0; p->total_won = 0; // unknown for legacy
     }
-    *roster_count = count;
+    r->slot_count = count;
     fclose(f);
-    return 0;
-}
-
-int persist_save_accounting(const char* path, const Accounting* acc) {
-    FILE* f = fopen(path, "wb");
-    if (!f) return -1;
-    fwrite(acc, sizeof(Accounting), 1, f);
-    fclose(f);
-    return 0;
+    return roster_reindex(r) == 0 ? 0 : -4;
 }
 
+// accounting.bin is only read to migrate a v2 or legacy roster; v3 keeps it in the roster header.
 int persist_load_accounting(const char* path, Accounting* acc) {
     FILE* f = fopen(path, "rb");
     if (!f) return -1;
-    size_t rd = fread(acc, sizeof(Accounting), 1, f);
-    fclose(f);
-    return rd == 1 ? 0 : -2;
-}
-
-int persist_append_match(const char* path, const Match* m) {
-    FILE* f = fopen(path, "ab");
-    if (!f) return -1;
-    // Write a simple CSV-like line: match_number,mode,card_cost,pot,saved_for_fullhouse,winner_count,winners...
-    fprintf(f, "%u,%d,%.2f,%.2f,%.2f,%u", m->match_number, (int)m->mode, m->card_cost, m->pot, m->saved_for_fullhouse, m->winner_count);
-    for (uint32_t i = 0; i < m->winner_count; ++i) fprintf(f, ",%u", m->winners[i]);
-    fprintf(f, "\n");
-    fclose(f);
-    return 0;
-}
-
-int persist_export_players_csv(const char* path, Player* roster, uint32_t roster_count) {
-    FILE* f = fopen(path, "w");
-    if (!f) return -1;
-    fprintf(f, "id,name,balance,total_recharged,total_spent,total_won,wins,losses,draws,lifetime_cards,net_gain\n");
-    for (uint32_t i = 0; i < roster_count; ++i) {
-        Player* p = &roster[i];
-        double net = p->total_won - p->total_spent;
-        fprintf(f, "%u,%s,%.2f,%.2f,%.2f,%.2f,%u,%u,%u,%u,%.2f\n", p->id, p->name, p->balance, p->total_recharged, p->total_spent, p->total_won, p->record.wins, p->record.losses, p->record.draws, p->lifetime_cards, net);
-    }
+    AccountingLegacy la; size_t rd = fread(&la, sizeof(la), 1, f);
     fclose(f);
+    if (rd != 1) return -2;
+    acc->total_bank = money_from_units(la.total_bank); acc->saved_pot = money_from_units(la.saved_pot); acc->total_matches = la.total_matches;
+    acc->journal_seq = 0;
+    acc->next_match = la.total_matches + 1;
     return 0;
 }
 
@@ -137,3 +643,18 @@ int persist_append_transaction(const char* path, const char* type, const char* d
     fclose(f);
     return 0;
 }
+
+int persist_append_transactions(const char* path, const char* type, const char* rows, size_t len) {
+    FILE* f = fopen(path, "ab");
+    if (!f) return -1;
+    time_t t = time(NULL);
+    int ok = 1;
+    for (const char* end = rows + len; ok && rows < end;) {
+        const char* nl = (const char*)memchr(rows, '\n', (size_t)(end - rows));
+        size_t n = nl ? (size_t)(nl - rows) : (size_t)(end - rows);
+        ok = fprintf(f, "%s,%lld,%.*s\n", type, (long long)t, (int)n, rows) > 0;
+        rows += n + 1;
+    }
+    if (fclose(f) != 0) ok = 0;
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,149 @@
+// Thin threading and file-mapping shim over POSIX / Win32 for the engine's background stages,
+// the shared engine handle and the mapped roster. POSIX files including it define
+// _POSIX_C_SOURCE 200809L first (pthread_rwlock_t).
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdint.h>
+#ifdef _WIN32
+#include <windows.h>
+typedef SRWLOCK plat_mutex;
+typedef SRWLOCK plat_rwlock;
+typedef CONDITION_VARIABLE plat_cond;
+typedef HANDLE plat_thread;
+#else
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+typedef pthread_mutex_t plat_mutex;
+typedef pthread_rwlock_t plat_rwlock;
+typedef pthread_cond_t plat_cond;
+typedef pthread_t plat_thread;
+#endif
+
+typedef void (*plat_thread_fn)(void* arg);
+
+#ifdef _WIN32
+static inline void plat_mutex_init(plat_mutex* m) { InitializeSRWLock(m); }
+static inline void plat_mutex_destroy(plat_mutex* m) { (void)m; }
+static inline void plat_mutex_lock(plat_mutex* m) { AcquireSRWLockExclusive(m); }
+static inline void plat_mutex_unlock(plat_mutex* m) { ReleaseSRWLockExclusive(m); }
+static inline void plat_rwlock_init(plat_rwlock* l) { InitializeSRWLock(l); }
+static inline void plat_rwlock_destroy(plat_rwlock* l) { (void)l; }
+static inline void plat_rwlock_rdlock(plat_rwlock* l) { AcquireSRWLockShared(l); }
+static inline void plat_rwlock_rdunlock(plat_rwlock* l) { ReleaseSRWLockShared(l); }
+static inline void plat_rwlock_wrlock(plat_rwlock* l) { AcquireSRWLockExclusive(l); }
+static inline void plat_rwlock_wrunlock(plat_rwlock* l) { ReleaseSRWLockExclusive(l); }
+static inline void plat_cond_init(plat_cond* c) { InitializeConditionVariable(c); }
+static inline void plat_cond_destroy(plat_cond* c) { (void)c; }
+static inline void plat_cond_wait(plat_cond* c, plat_mutex* m) { SleepConditionVariableSRW(c, m, INFINITE, 0); }
+static inline void plat_cond_signal(plat_cond* c) { WakeConditionVariable(c); }
+static inline void plat_cond_broadcast(plat_cond* c) { WakeAllConditionVariable(c); }
+
+typedef struct { plat_thread_fn fn; void* arg; } plat_thread_start_ctx;
+static inline DWORD WINAPI plat_thread_trampoline(LPVOID p) {
+    plat_thread_start_ctx ctx = *(plat_thread_start_ctx*)p;
+    HeapFree(GetProcessHeap(), 0, p);
+    ctx.fn(ctx.arg);
+    return 0;
+}
+static inline int plat_thread_start(plat_thread* t, plat_thread_fn fn, void* arg) {
+    plat_thread_start_ctx* ctx = (plat_thread_start_ctx*)HeapAlloc(GetProcessHeap(), 0, sizeof(*ctx));
+    if (!ctx) return -1;
+    ctx->fn = fn; ctx->arg = arg;
+    *t = CreateThread(NULL, 0, plat_thread_trampoline, ctx, 0, NULL);
+    if (!*t) { HeapFree(GetProcessHeap(), 0, ctx); return -1; }
+    return 0;
+}
+static inline void plat_thread_join(plat_thread t) { WaitForSingleObject(t, INFINITE); CloseHandle(t); }
+static inline unsigned plat_cpu_count(void) {
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors ? (unsigned)si.dwNumberOfProcessors : 1;
+}
+
+// Windows cannot replace a file that has a live mapping, and checkpoints replace roster.bin,
+// so mapped rosters are POSIX-only; callers read the file instead.
+static inline void* plat_map_private(int fd, size_t size) { (void)fd; (void)size; return NULL; }
+static inline void plat_unmap(void* p, size_t size) { (void)p; (void)size; }
+
+// Relaxed atomic read-modify-writes; they return the previous value. cas64 stores `desired`
+// if *p still equals *expected and returns 1, otherwise loads *p into *expected and returns 0.
+static inline uint64_t plat_atomic_or64(uint64_t* p, uint64_t v) { return (uint64_t)InterlockedOr64((volatile LONG64*)p, (LONG64)v); }
+static inline uint32_t plat_atomic_add32(uint32_t* p, uint32_t v) { return (uint32_t)InterlockedExchangeAdd((volatile LONG*)p, (LONG)v); }
+static inline int64_t plat_atomic_add64(int64_t* p, int64_t v) { return (int64_t)InterlockedExchangeAdd64((volatile LONG64*)p, (LONG64)v); }
+static inline int64_t plat_atomic_load64(int64_t* p) { return (int64_t)InterlockedOr64((volatile LONG64*)p, 0); }
+static inline uint32_t plat_atomic_load32(uint32_t* p) { return (uint32_t)InterlockedOr((volatile LONG*)p, 0); }
+static inline int plat_atomic_cas64(int64_t* p, int64_t* expected, int64_t desired) {
+    LONG64 seen = InterlockedCompareExchange64((volatile LONG64*)p, (LONG64)desired, (LONG64)*expected);
+    if (seen == (LONG64)*expected) return 1;
+    *expected = (int64_t)seen;
+    return 0;
+}
+// Pointer publication: the load pairs with the swap, so a reader that sees a new pointer also
+// sees everything written to the object before it was published.
+static inline void* plat_atomic_load_ptr(void** p) { return InterlockedCompareExchangePointer((PVOID volatile*)p, NULL, NULL); }
+static inline int plat_atomic_cas_ptr(void** p, void* expected, void* desired) {
+    return InterlockedCompareExchangePointer((PVOID volatile*)p, desired, expected) == expected;
+}
+#else
+static inline void plat_mutex_init(plat_mutex* m) { pthread_mutex_init(m, NULL); }
+static inline void plat_mutex_destroy(plat_mutex* m) { pthread_mutex_destroy(m); }
+static inline void plat_mutex_lock(plat_mutex* m) { pthread_mutex_lock(m); }
+static inline void plat_mutex_unlock(plat_mutex* m) { pthread_mutex_unlock(m); }
+static inline void plat_rwlock_init(plat_rwlock* l) { pthread_rwlock_init(l, NULL); }
+static inline void plat_rwlock_destroy(plat_rwlock* l) { pthread_rwlock_destroy(l); }
+static inline void plat_rwlock_rdlock(plat_rwlock* l) { pthread_rwlock_rdlock(l); }
+static inline void plat_rwlock_rdunlock(plat_rwlock* l) { pthread_rwlock_unlock(l); }
+static inline void plat_rwlock_wrlock(plat_rwlock* l) { pthread_rwlock_wrlock(l); }
+static inline void plat_rwlock_wrunlock(plat_rwlock* l) { pthread_rwlock_unlock(l); }
+static inline void plat_cond_init(plat_cond* c) { pthread_cond_init(c, NULL); }
+static inline void plat_cond_destroy(plat_cond* c) { pthread_cond_destroy(c); }
+static inline void plat_cond_wait(plat_cond* c, plat_mutex* m) { pthread_cond_wait(c, m); }
+static inline void plat_cond_signal(plat_cond* c) { pthread_cond_signal(c); }
+static inline void plat_cond_broadcast(plat_cond* c) { pthread_cond_broadcast(c); }
+
+typedef struct { plat_thread_fn fn; void* arg; } plat_thread_start_ctx;
+static inline void* plat_thread_trampoline(void* p) {
+    plat_thread_start_ctx ctx = *(plat_thread_start_ctx*)p;
+    free(p);
+    ctx.fn(ctx.arg);
+    return NULL;
+}
+static inline int plat_thread_start(plat_thread* t, plat_thread_fn fn, void* arg) {
+    plat_thread_start_ctx* ctx = (plat_thread_start_ctx*)malloc(sizeof(*ctx));
+    if (!ctx) return -1;
+    ctx->fn = fn; ctx->arg = arg;
+    if (pthread_create(t, NULL, plat_thread_trampoline, ctx) != 0) { free(ctx); return -1; }
+    return 0;
+}
+static inline void plat_thread_join(plat_thread t) { pthread_join(t, NULL); }
+static inline unsigned plat_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 1;
+}
+
+// Copy-on-write mapping of a whole file: writes stay in memory, the file changes only via
+// explicit writes. NULL on failure.
+static inline void* plat_map_private(int fd, size_t size) {
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    return p == MAP_FAILED ? NULL : p;
+}
+static inline void plat_unmap(void* p, size_t size) { munmap(p, size); }
+
+static inline uint64_t plat_atomic_or64(uint64_t* p, uint64_t v) { return __atomic_fetch_or(p, v, __ATOMIC_RELAXED); }
+static inline uint32_t plat_atomic_add32(uint32_t* p, uint32_t v) { return __atomic_fetch_add(p, v, __ATOMIC_RELAXED); }
+static inline int64_t plat_atomic_add64(int64_t* p, int64_t v) { return __atomic_fetch_add(p, v, __ATOMIC_RELAXED); }
+static inline int64_t plat_atomic_load64(int64_t* p) { return __atomic_load_n(p, __ATOMIC_RELAXED); }
+static inline uint32_t plat_atomic_load32(uint32_t* p) { return __atomic_load_n(p, __ATOMIC_RELAXED); }
+static inline int plat_atomic_cas64(int64_t* p, int64_t* expected, int64_t desired) {
+    return __atomic_compare_exchange_n(p, expected, desired, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+static inline void* plat_atomic_load_ptr(void** p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static inline int plat_atomic_cas_ptr(void** p, void* expected, void* desired) {
+    return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+#endif
+
+#endif // PLATFORM_H
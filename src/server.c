@@ -0,0 +1,265 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // open_memstream, sigaction
+#endif
+#include <stdio.h>
+#include "server.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "command.h"
+
+// One terminal. Requests are pipelined: every complete line in `in` is run before the
+// responses, accumulated in the `out` memory stream, are written back in one send, once the
+// journal records of those commands are on disk.
+typedef struct {
+    int fd;
+    char in[SERVER_READ_CHUNK];
+    size_t in_len;
+    int discarding;            // dropping the rest of an over-long line
+    FILE* out;
+    char* out_buf;             // owned by the memory stream
+    size_t out_size;
+    size_t out_sent;
+    int closing;               // `quit` received: close once `out` is drained
+    int peer_done;             // peer shut down its side: finish buffered lines, then close
+    uint32_t events;           // epoll interest currently registered
+    uint32_t index;            // position in the server's client table
+} Client;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static int listen_on(const char* endpoint) {
+    int fd = -1;
+    if (strncmp(endpoint, "unix:", 5) == 0) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(endpoint + 5) == 0 || strlen(endpoint + 5) >= sizeof(addr.sun_path)) return -1;
+        strcpy(addr.sun_path, endpoint + 5);
+        unlink(addr.sun_path); // stale socket from an earlier run
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) { close(fd); return -1; }
+    } else if (strncmp(endpoint, "tcp:", 4) == 0) {
+        char* end;
+        long port = strtol(endpoint + 4, &end, 10);
+        if (*end || port <= 0 || port > 65535) return -1;
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // the hall LAN reaches it through a local proxy, never directly
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) { close(fd); return -1; }
+    } else {
+        return -1;
+    }
+    if (listen(fd, 64) != 0 || set_nonblocking(fd) != 0) { close(fd); return -1; }
+    return fd;
+}
+
+typedef struct {
+    int ep;
+    Client* clients[SERVER_MAX_CLIENTS];
+    uint32_t client_count;
+} Server;
+
+static void client_close(Server* srv, Client* c) {
+    epoll_ctl(srv->ep, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    fclose(c->out);
+    free(c->out_buf);
+    Client* last = srv->clients[--srv->client_count];
+    srv->clients[c->index] = last;
+    last->index = c->index;
+    free(c);
+}
+
+// Sends pending responses. 0 drained or blocked, -1 connection lost.
+static int client_write(Client* c) {
+    fflush(c->out);
+    while (c->out_sent < c->out_size) {
+        ssize_t n = send(c->fd, c->out_buf + c->out_sent, c->out_size - c->out_sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        c->out_sent += (size_t)n;
+    }
+    // fully drained: reuse the stream's buffer from the start
+    rewind(c->out);
+    fflush(c->out);
+    c->out_sent = 0;
+    return 0;
+}
+
+static size_t client_pending(Client* c) {
+    fflush(c->out);
+    return c->out_size - c->out_sent;
+}
+
+// Runs the complete lines buffered in c->in; returns the number of commands run.
+static uint32_t client_run_lines(Session* s, Client* c) {
+    uint32_t ran = 0;
+    size_t start = 0;
+    while (!c->closing && client_pending(c) < SERVER_OUTPUT_LIMIT) {
+        char* nl = (char*)memchr(c->in + start, '\n', c->in_len - start);
+        if (!nl) break;
+        *nl = '\0';
+        if (c->discarding) {
+            c->discarding = 0;
+        } else if ((size_t)(nl - (c->in + start)) >= COMMAND_LINE_LEN) {
+            fputs("err line_too_long\n", c->out);
+        } else {
+            if (command_run(s, c->in + start, c->out) == 1) c->closing = 1;
+            ran++;
+        }
+        start = (size_t)(nl - c->in) + 1;
+    }
+    memmove(c->in, c->in + start, c->in_len - start);
+    c->in_len -= start;
+    if (c->in_len == sizeof(c->in) && !memchr(c->in, '\n', c->in_len)) {
+        // a line longer than the whole buffer: answer once, drop it up to its newline
+        if (!c->discarding) fputs("err line_too_long\n", c->out);
+        c->discarding = 1;
+        c->in_len = 0;
+    }
+    return ran;
+}
+
+// Reads only while there is room for input and the client is not closing; writes while
+// responses are pending. A client held back by backpressure resumes on EPOLLOUT.
+static void client_update_events(int ep, Client* c) {
+    uint32_t want = 0;
+    if (!c->closing && !c->peer_done && c->in_len < sizeof(c->in)) want |= EPOLLIN;
+    if (client_pending(c) > 0) want |= EPOLLOUT;
+    if (want == c->events) return;
+    struct epoll_event ev;
+    ev.events = want;
+    ev.data.ptr = c;
+    epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &ev);
+    c->events = want;
+}
+
+static void accept_clients(Server* srv, int lfd) {
+    for (;;) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0) return; // EAGAIN, or a transient error: retried on the next wakeup
+        Client* c = srv->client_count < SERVER_MAX_CLIENTS ? (Client*)calloc(1, sizeof(Client)) : NULL;
+        if (c) c->out = open_memstream(&c->out_buf, &c->out_size);
+        if (!c || !c->out || set_nonblocking(fd) != 0) {
+            free(c);
+            close(fd);
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // fails harmlessly on unix sockets
+        c->fd = fd;
+        c->events = EPOLLIN;
+        struct epoll_event ev;
+        ev.events = c->events;
+        ev.data.ptr = c;
+        if (epoll_ctl(srv->ep, EPOLL_CTL_ADD, fd, &ev) != 0) { close(fd); fclose(c->out); free(c->out_buf); free(c); continue; }
+        c->index = srv->client_count;
+        srv->clients[srv->client_count++] = c;
+    }
+}
+
+int server_run(Session* s, const char* endpoint) {
+    int lfd = listen_on(endpoint);
+    if (lfd < 0) return -1;
+    Server* srv = (Server*)calloc(1, sizeof(Server));
+    int ep = epoll_create1(0);
+    if (!srv || ep < 0) { free(srv); if (ep >= 0) close(ep); close(lfd); return -1; }
+    srv->ep = ep;
+    struct epoll_event lev;
+    lev.events = EPOLLIN;
+    lev.data.ptr = NULL; // NULL marks the listening socket
+    epoll_ctl(ep, EPOLL_CTL_ADD, lfd, &lev);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    struct epoll_event events[64];
+    Client* ready[64];
+    while (!stop_requested) {
+        int n = epoll_wait(ep, events, 64, -1);
+        if (n < 0 && errno != EINTR) break;
+        // Group commit: run the lines of every ready client, sync the journal once, then answer.
+        // A response never reaches a cashier before the command it confirms is durable.
+        uint32_t ran = 0, ready_count = 0;
+        for (int i = 0; i < n; ++i) {
+            Client* c = (Client*)events[i].data.ptr;
+            if (!c) { accept_clients(srv, lfd); continue; }
+            int lost = (events[i].events & (EPOLLERR | EPOLLHUP)) && !(events[i].events & EPOLLIN);
+            if (!lost && (events[i].events & EPOLLIN) && !c->closing && !c->peer_done && c->in_len < sizeof(c->in)) {
+                ssize_t r = recv(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len, 0);
+                if (r == 0) c->peer_done = 1;
+                else if (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) lost = 1;
+                else if (r > 0) c->in_len += (size_t)r;
+            }
+            if (lost) { client_close(srv, c); continue; }
+            // runs what is buffered, including lines held back by output backpressure
+            ran += client_run_lines(s, c);
+            ready[ready_count++] = c;
+        }
+        // nothing to write (and no fsync) when the pass only read
+        int synced = !ran || !s->journal || journal_sync(s->journal) == 0;
+        if (!synced) fprintf(stderr, "journal sync failed; dropping %u clients without their responses\n", ready_count);
+        for (uint32_t i = 0; i < ready_count; ++i) {
+            Client* c = ready[i];
+            int lost = !synced || client_write(c) != 0;
+            int finished = c->closing || (c->peer_done && !memchr(c->in, '\n', c->in_len));
+            if (lost || (finished && client_pending(c) == 0)) {
+                client_close(srv, c);
+                continue;
+            }
+            client_update_events(ep, c);
+        }
+    }
+    // clients are dropped without their unsent responses; the journal has every applied command
+    while (srv->client_count) client_close(srv, srv->clients[0]);
+    free(srv);
+    close(ep);
+    close(lfd);
+    if (strncmp(endpoint, "unix:", 5) == 0) unlink(endpoint + 5);
+    return 0;
+}
+
+#else
+
+int server_run(Session* s, const char* endpoint) {
+    (void)s;
+    (void)endpoint;
+    fprintf(stderr, "Server mode is only available on Linux.\n");
+    return -1;
+}
+
+#endif
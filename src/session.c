@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "session.h"
+#include "bingo.h"
+#include "config.h"
+#include "persist.h"
+#include "audit.h"
+#include "leaderboard.h"
+
+// `opening` rows of a migrated roster, built before the writer exists.
+typedef struct {
+    char* rows;
+    size_t len;
+    size_t cap;
+} OpeningRows;
+
+static void opening_row(void* ctx, const Player* p, Money opening) {
+    OpeningRows* o = (OpeningRows*)ctx;
+    if (o->cap - o->len < 96) {
+        size_t cap = o->cap ? o->cap * 2 : 4096;
+        char* grown = (char*)realloc(o->rows, cap);
+        if (!grown) return; // the booking still happens; only its row is lost
+        o->rows = grown;
+        o->cap = cap;
+    }
+    int n = snprintf(o->rows + o->len, o->cap - o->len, "id=%u,recharged=%.2f,opening=%.2f\n",
+                     p->id, money_units(p->total_recharged), money_units(opening));
+    if (n > 0) o->len += (size_t)n;
+}
+
+int session_open(Session* s, uint32_t max_players) {
+    memset(s, 0, sizeof(*s));
+    engine_init(&s->acc);
+    if (max_players) cfg_set_max_players(max_players); // engine_init restored the defaults
+    // A file that exists but cannot be read stops the session: starting empty would make the
+    // next checkpoint overwrite it. Only a missing file (-1) starts fresh.
+    roster_init(&s->roster);
+    int rc = persist_load_roster(SESSION_ROSTER_PATH, &s->roster, cfg_get_max_players(), &s->acc);
+    if (rc != 0 && rc != -1) {
+        roster_free(&s->roster);
+        return rc == -2 ? -4 : rc == -4 ? -1 : -2;
+    }
+    // a v3 roster carries the accounting; older rosters came with accounting.bin
+    if (s->roster.needs_rewrite) {
+        rc = persist_load_accounting(SESSION_ACCOUNTING_PATH, &s->acc);
+        if (rc != 0 && rc != -1) { roster_free(&s->roster); return -3; }
+    }
+    // Those rosters also left the opening balance out of total_recharged: book it, keeping the
+    // stored value and logging one row per player adjusted.
+    OpeningRows openings = {NULL, 0, 0};
+    if (s->roster.needs_rewrite) audit_book_openings(&s->roster, opening_row, &openings);
+    audit_rebase(&s->roster, &s->acc, &s->match, 1);
+    // one-time conversion of the CSV history and ledger; a no-op once the binary files have rows
+    persist_import_match_csv(SESSION_MATCHES_CSV_PATH, SESSION_LEDGER_CSV_PATH, SESSION_MATCHES_PATH);
+    persist_import_ledger_csv(SESSION_LEDGER_CSV_PATH, SESSION_MATCHES_PATH, SESSION_LEDGER_PATH);
+    // Roll forward anything journaled after the last checkpoint; an interrupted match resumes.
+    // Matches that ended after it get the history and ledger rows the writer may not have written.
+    JournalReplayFiles files = {SESSION_MATCHES_PATH, SESSION_LEDGER_PATH};
+    journal_replay(SESSION_JOURNAL_PATH, &s->roster, &s->acc, &s->match, 1, &files);
+    // without memory for the boards the session runs on; `top` then reports them unavailable
+    leaderboard_attach(&s->roster);
+    s->journal = journal_open(SESSION_JOURNAL_PATH, s->acc.journal_seq);
+    if (s->journal) engine_set_event_sink(journal_event_sink, s->journal);
+    s->writer = writer_start(s->journal);
+    if (!s->writer) {
+        engine_set_event_sink(NULL, NULL);
+        journal_close(s->journal);
+        match_release(&s->match);
+        roster_free(&s->roster);
+        free(openings.rows);
+        return -1;
+    }
+    if (openings.len) writer_append_transactions(s->writer, SESSION_TRANSACTIONS_PATH, "opening", openings.rows, openings.len);
+    else free(openings.rows);
+    return s->journal ? 0 : 1;
+}
+
+int session_checkpoint(Session* s) {
+    if (s->match.active) { writer_sync_journal(s->writer); return 0; }
+    JournalMark mark = {0, 0};
+    if (s->journal) { mark = journal_mark(s->journal); s->acc.journal_seq = mark.seq; }
+    if (writer_checkpoint(s->writer, SESSION_ROSTER_PATH, &s->roster, &s->acc, s->journal ? &mark : NULL) != 0) {
+        // no memory for a snapshot: wait for queued saves, then write from the live roster
+        writer_flush(s->writer);
+        if (persist_save_roster(SESSION_ROSTER_PATH, &s->roster, &s->acc) == 0 && s->journal) journal_trim(s->journal, mark);
+    }
+    return 1;
+}
+
+void session_record_match(Session* s) {
+    writer_append_match(s->writer, SESSION_MATCHES_PATH, SESSION_LEDGER_PATH, &s->match);
+}
+
+void session_record_cancel(Session* s) {
+    writer_append_cancel(s->writer, SESSION_LEDGER_PATH, &s->match);
+}
+
+void session_log(Session* s, const char* type, const char* details) {
+    writer_append_transaction(s->writer, SESSION_TRANSACTIONS_PATH, type, details);
+}
+
+// The add row replay reads back (persist_read_transactions); the name goes last, commas and all.
+static int add_details(char* out, size_t size, Roster* r, uint32_t id) {
+    const Player* p = engine_find_player(r, id);
+    if (!p) return -1;
+    return snprintf(out, size, "add,id=%u,balance=%.2f,name=%s", id, money_units(p->total_recharged), engine_player_name(r, id));
+}
+
+void session_log_add(Session* s, uint32_t id) {
+    char details[192];
+    if (add_details(details, sizeof(details), &s->roster, id) > 0) session_log(s, "add", details);
+}
+
+int session_import_players(Session* s, const char* path, CsvErrorFn on_error, void* ctx, uint32_t* first_id) {
+    uint32_t first = 0;
+    int added = persist_import_players_csv(path, &s->roster, on_error, ctx, &first);
+    if (first_id) *first_id = first;
+    if (added <= 0 && added != -4) return added;
+    // one add row per player, queued as a single write
+    uint32_t count = added > 0 ? (uint32_t)added : s->roster.next_id - first;
+    size_t cap = (size_t)count * 192, len = 0;
+    char* rows = count ? (char*)malloc(cap) : NULL;
+    for (uint32_t i = 0; rows && i < count; ++i) {
+        int n = add_details(rows + len, cap - len, &s->roster, first + i);
+        if (n > 0) { len += (size_t)n; rows[len++] = '\n'; }
+    }
+    if (rows) writer_append_transactions(s->writer, SESSION_TRANSACTIONS_PATH, "add", rows, len);
+    session_checkpoint(s); // otherwise the journal holds every add until the next match ends
+    return added;
+}
+
+int session_verify(Session* s) {
+    if (audit_verify(&s->roster, &s->acc, &s->match, 1) == 0) return 0;
+    const RosterTotals* t = &s->roster.totals;
+    char details[192];
+    snprintf(details, sizeof(details), "unbalanced,balances=%.2f,recharged=%.2f,spent=%.2f,won=%.2f,retired=%.2f,saved=%.2f",
+             money_units(t->balances), money_units(t->recharged), money_units(t->spent), money_units(t->won),
+             money_units(t->retired), money_units(s->acc.saved_pot));
+    session_log(s, "audit", details);
+    return -1;
+}
+
+int session_close(Session* s) {
+    session_checkpoint(s);
+    int rc = writer_flush(s->writer);
+    writer_stop(s->writer);
+    engine_set_event_sink(NULL, NULL);
+    journal_close(s->journal);
+    match_release(&s->match);
+    roster_free(&s->roster);
+    memset(s, 0, sizeof(*s));
+    return rc;
+}
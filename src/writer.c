@@ -0,0 +1,303 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L // pthread_rwlock_t (platform.h)
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "writer.h"
+#include "bingo.h"
+#include "persist.h"
+#include "platform.h"
+
+typedef enum {
+    JOB_CHECKPOINT,
+    JOB_MATCH,
+    JOB_TRANSACTION,
+    JOB_SYNC
+} JobType;
+
+// A job owns everything it writes, so the engine can keep mutating its state meanwhile.
+typedef struct Job {
+    JobType type;
+    struct Job* next;
+    char path[2][WRITER_PATH_LEN];
+    int full;                  // JOB_CHECKPOINT: rewrite the whole roster file from `roster`
+    Roster roster;             //   packed copy of a compacted roster (roster_copy)
+    RosterDelta delta;         //   or only the changed records
+    Accounting acc;            //   saved in the roster header
+    JournalMark mark;
+    int has_mark;
+    Match match;               // JOB_MATCH: ledger entries copied, no hash table
+    int cancelled;             //   ledger rows only (refunds), no history
+    char kind[32];             // JOB_TRANSACTION
+    char details[192];
+    char* rows;                //   or several details lines (writer_append_transactions)
+    size_t rows_len;
+} Job;
+
+struct Writer {
+    plat_mutex lock;
+    plat_cond work;            // a job was queued or stop was requested
+    plat_cond idle;            // a job finished (queue space and flush progress)
+    Job* head;
+    Job* tail;
+    uint32_t queued;           // jobs in the list plus the one running
+    int busy;
+    int stopping;
+    int threaded;
+    int error;                 // first job error since the last flush
+    int roster_stale;          // an incremental save failed; the next checkpoint rewrites the file
+    Job* queued_checkpoint;    // still waiting in the list; newer snapshots replace it
+    int sync_queued;
+    Journal* journal;
+    plat_thread thread;
+};
+
+static Job* job_new(JobType type) {
+    Job* job = (Job*)calloc(1, sizeof(Job));
+    if (!job) return NULL;
+    job->type = type;
+    roster_init(&job->roster);
+    return job;
+}
+
+static void job_free(Job* job) {
+    roster_free(&job->roster);
+    persist_roster_delta_free(&job->delta);
+    match_release(&job->match);
+    free(job->rows);
+    free(job);
+}
+
+static int job_run(Writer* w, Job* job) {
+    int rc = 0;
+    switch (job->type) {
+        case JOB_CHECKPOINT:
+            if (job->full) rc = persist_save_roster(job->path[0], &job->roster, &job->acc);
+            else rc = persist_write_roster_delta(job->path[0], &job->delta);
+            if (rc != 0) {
+                // the file still holds the previous checkpoint and its journal position
+                plat_mutex_lock(&w->lock);
+                w->roster_stale = 1;
+                plat_mutex_unlock(&w->lock);
+                rc = -1;
+                break;
+            }
+            // journal records are dropped only once the checkpoint that covers them is durable
+            if (job->has_mark && w->journal) rc = journal_trim(w->journal, job->mark);
+            break;
+        case JOB_MATCH:
+            if (!job->cancelled && persist_append_match(job->path[0], &job->match) != 0) rc = -1;
+            if (persist_append_ledger(job->path[1], &job->match, job->cancelled) != 0) rc = -1;
+            break;
+        case JOB_TRANSACTION:
+            if (job->rows) rc = persist_append_transactions(job->path[0], job->kind, job->rows, job->rows_len);
+            else rc = persist_append_transaction(job->path[0], job->kind, job->details);
+            break;
+        case JOB_SYNC:
+            if (w->journal) rc = journal_sync(w->journal);
+            break;
+    }
+    return rc;
+}
+
+static void writer_main(void* arg) {
+    Writer* w = (Writer*)arg;
+    plat_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->head && !w->stopping) plat_cond_wait(&w->work, &w->lock);
+        if (!w->head) break;
+        Job* job = w->head;
+        w->head = job->next;
+        if (!w->head) w->tail = NULL;
+        if (w->queued_checkpoint == job) w->queued_checkpoint = NULL;
+        if (job->type == JOB_SYNC) w->sync_queued = 0;
+        w->busy = 1;
+        plat_mutex_unlock(&w->lock);
+
+        int rc = job_run(w, job);
+        job_free(job);
+
+        plat_mutex_lock(&w->lock);
+        w->busy = 0;
+        w->queued--;
+        if (rc != 0 && w->error == 0) w->error = rc;
+        plat_cond_broadcast(&w->idle);
+    }
+    plat_mutex_unlock(&w->lock);
+}
+
+// Takes ownership of job.
+static int enqueue(Writer* w, Job* job) {
+    if (!w->threaded) {
+        int rc = job_run(w, job);
+        job_free(job);
+        if (rc != 0 && w->error == 0) w->error = rc;
+        return 0;
+    }
+    plat_mutex_lock(&w->lock);
+    while (w->queued >= WRITER_QUEUE_LIMIT) plat_cond_wait(&w->idle, &w->lock);
+    if (w->tail) w->tail->next = job; else w->head = job;
+    w->tail = job;
+    w->queued++;
+    if (job->type == JOB_CHECKPOINT) w->queued_checkpoint = job;
+    if (job->type == JOB_SYNC) w->sync_queued = 1;
+    plat_cond_signal(&w->work);
+    plat_mutex_unlock(&w->lock);
+    return 0;
+}
+
+Writer* writer_start(Journal* journal) {
+    Writer* w = (Writer*)calloc(1, sizeof(Writer));
+    if (!w) return NULL;
+    w->journal = journal;
+    plat_mutex_init(&w->lock);
+    plat_cond_init(&w->work);
+    plat_cond_init(&w->idle);
+    w->threaded = plat_thread_start(&w->thread, writer_main, w) == 0;
+    return w;
+}
+
+void writer_stop(Writer* w) {
+    if (!w) return;
+    if (w->threaded) {
+        plat_mutex_lock(&w->lock);
+        w->stopping = 1;
+        plat_cond_signal(&w->work);
+        plat_mutex_unlock(&w->lock);
+        plat_thread_join(w->thread);
+    }
+    plat_cond_destroy(&w->idle);
+    plat_cond_destroy(&w->work);
+    plat_mutex_destroy(&w->lock);
+    free(w);
+}
+
+int writer_checkpoint(Writer* w, const char* roster_path, Roster* r, const Accounting* acc, const JournalMark* mark) {
+    Job* job = job_new(JOB_CHECKPOINT);
+    if (!job) return -1;
+    plat_mutex_lock(&w->lock);
+    int stale = w->roster_stale;
+    w->roster_stale = 0;
+    plat_mutex_unlock(&w->lock);
+    // Full rewrite when the file's slots no longer match memory or tombstones pile up;
+    // otherwise only the records changed since the last checkpoint.
+    job->full = stale || r->needs_rewrite || r->slot_count - r->count > r->slot_count / WRITER_COMPACT_DIVISOR;
+    int rc;
+    if (job->full) {
+        roster_compact(r);
+        rc = roster_copy(&job->roster, r);
+        if (rc == 0) r->needs_rewrite = 0;
+    } else {
+        rc = persist_roster_delta(&job->delta, r, acc);
+    }
+    if (rc != 0) {
+        job_free(job);
+        if (stale) { plat_mutex_lock(&w->lock); w->roster_stale = 1; plat_mutex_unlock(&w->lock); }
+        return -1;
+    }
+    snprintf(job->path[0], WRITER_PATH_LEN, "%s", roster_path);
+    job->acc = *acc;
+    if (mark) { job->mark = *mark; job->has_mark = 1; }
+    if (w->threaded && job->full) {
+        plat_mutex_lock(&w->lock);
+        // only a checkpoint at the tail: one queued ahead of match rows would trim the
+        // journal records they replay from before they are written
+        Job* queued = w->queued_checkpoint == w->tail ? w->queued_checkpoint : NULL;
+        if (queued) {
+            // the older snapshot was never written and a full one supersedes it; deltas
+            // cannot replace each other, since each holds only its own changes
+            Roster old = queued->roster;
+            queued->roster = job->roster;
+            job->roster = old;
+            RosterDelta old_delta = queued->delta;
+            queued->delta = job->delta;
+            job->delta = old_delta;
+            queued->full = 1;
+            memcpy(queued->path, job->path, sizeof(job->path));
+            queued->acc = job->acc;
+            queued->mark = job->mark;
+            queued->has_mark = job->has_mark;
+        }
+        plat_mutex_unlock(&w->lock);
+        if (queued) { job_free(job); return 0; }
+    }
+    return enqueue(w, job);
+}
+
+// A JOB_MATCH owning a copy of m's ledger entries. NULL on OOM.
+static Job* match_job(const Match* m) {
+    Job* job = job_new(JOB_MATCH);
+    if (!job) return NULL;
+    job->match = *m;
+    job->match.entries = NULL;
+    job->match.entry_slots = NULL;
+    job->match.entry_slot_mask = 0;
+    job->match.entry_capacity = 0;
+    if (m->entry_count) {
+        job->match.entries = (MatchEntry*)malloc((size_t)m->entry_count * sizeof(MatchEntry));
+        if (!job->match.entries) { job->match.entry_count = 0; job_free(job); return NULL; }
+        memcpy(job->match.entries, m->entries, (size_t)m->entry_count * sizeof(MatchEntry));
+        job->match.entry_capacity = m->entry_count;
+    }
+    return job;
+}
+
+int writer_append_match(Writer* w, const char* matches_path, const char* ledger_path, const Match* m) {
+    Job* job = match_job(m);
+    if (!job) return -1;
+    snprintf(job->path[0], WRITER_PATH_LEN, "%s", matches_path);
+    snprintf(job->path[1], WRITER_PATH_LEN, "%s", ledger_path);
+    return enqueue(w, job);
+}
+
+int writer_append_cancel(Writer* w, const char* ledger_path, const Match* m) {
+    Job* job = match_job(m);
+    if (!job) return -1;
+    job->cancelled = 1;
+    snprintf(job->path[1], WRITER_PATH_LEN, "%s", ledger_path);
+    return enqueue(w, job);
+}
+
+int writer_append_transaction(Writer* w, const char* path, const char* type, const char* details) {
+    Job* job = job_new(JOB_TRANSACTION);
+    if (!job) return -1;
+    snprintf(job->path[0], WRITER_PATH_LEN, "%s", path);
+    snprintf(job->kind, sizeof(job->kind), "%s", type);
+    snprintf(job->details, sizeof(job->details), "%s", details ? details : "");
+    return enqueue(w, job);
+}
+
+int writer_append_transactions(Writer* w, const char* path, const char* type, char* rows, size_t len) {
+    Job* job = job_new(JOB_TRANSACTION);
+    if (!job) { free(rows); return -1; }
+    snprintf(job->path[0], WRITER_PATH_LEN, "%s", path);
+    snprintf(job->kind, sizeof(job->kind), "%s", type);
+    job->rows = rows;
+    job->rows_len = len;
+    return enqueue(w, job);
+}
+
+int writer_sync_journal(Writer* w) {
+    if (!w->journal) return 0;
+    if (w->threaded) {
+        plat_mutex_lock(&w->lock);
+        int queued = w->sync_queued;
+        plat_mutex_unlock(&w->lock);
+        if (queued) return 0;
+    }
+    Job* job = job_new(JOB_SYNC);
+    if (!job) return -1;
+    return enqueue(w, job);
+}
+
+int writer_flush(Writer* w) {
+    if (w->threaded) {
+        plat_mutex_lock(&w->lock);
+        while (w->head || w->busy) plat_cond_wait(&w->idle, &w->lock);
+    }
+    int rc = w->error;
+    w->error = 0;
+    if (w->threaded) plat_mutex_unlock(&w->lock);
+    return rc;
+}
@@ -0,0 +1,327 @@
+// Microbenchmarks for the engine and persistence hot paths, at roster sizes from 100 up to
+// 1M players. Every benchmark times samples of a fixed number of operations and reports
+// throughput plus percentiles of the per-operation time; cheap calls are timed in batches so
+// the clock does not dominate them.
+//
+//   bench [-s max players] [-t seconds per benchmark] [-d scratch dir] [-f name prefix]
+//
+// Results go to stdout as CSV, one row per benchmark and roster size, after a version line;
+// the columns and benchmark names only ever grow, so runs of different versions can be
+// diffed. Progress goes to stderr.
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bingo.h"
+#include "config.h"
+#include "leaderboard.h"
+#include "persist.h"
+
+#define BENCH_FORMAT 1
+#define MAX_SAMPLES 4096
+#define BATCH 256                  // operations per sample for calls well under a microsecond
+
+typedef struct {
+    uint32_t players;
+    double budget;                 // seconds per benchmark and size
+    const char* dir;
+    const char* filter;
+    Roster roster;
+    uint32_t* ids;                 // live IDs of roster, for random picks
+    uint32_t id_count;
+    uint32_t seed;
+    char path[512];
+} Bench;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t next_rand(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static uint32_t random_id(Bench* b) {
+    return b->ids[next_rand(&b->seed) % b->id_count];
+}
+
+// Per-operation times of the samples taken so far.
+typedef struct {
+    double ns[MAX_SAMPLES];
+    uint32_t count;
+    uint64_t ops;
+    uint64_t elapsed_ns;
+    uint64_t started_ns;
+} Samples;
+
+static void samples_begin(Samples* s) {
+    s->count = 0;
+    s->ops = 0;
+    s->elapsed_ns = 0;
+    s->started_ns = now_ns();
+}
+
+// Records a sample of `ops` operations that took `ns`.
+static void samples_add(Samples* s, uint64_t ns, uint32_t ops) {
+    if (s->count < MAX_SAMPLES) s->ns[s->count++] = (double)ns / ops;
+    s->ops += ops;
+    s->elapsed_ns += ns;
+}
+
+// Keep sampling until the budget is spent (setup included), with at least 3 samples.
+static int samples_more(const Samples* s, const Bench* b) {
+    if (s->count < 3) return 1;
+    return s->count < MAX_SAMPLES && (double)(now_ns() - s->started_ns) / 1e9 < b->budget;
+}
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile(const Samples* s, double q) {
+    uint32_t i = (uint32_t)(q * (s->count - 1) + 0.5);
+    return s->ns[i];
+}
+
+static void report(Samples* s, const char* name, uint32_t players) {
+    if (s->count == 0) return;
+    qsort(s->ns, s->count, sizeof(double), cmp_double);
+    double secs = (double)s->elapsed_ns / 1e9;
+    printf("%s,%u,%llu,%.6f,%.0f,%.1f,%.1f,%.1f,%.1f\n", name, players, (unsigned long long)s->ops, secs,
+           secs > 0 ? (double)s->ops / secs : 0.0, percentile(s, 0.5), percentile(s, 0.9), percentile(s, 0.99), s->ns[s->count - 1]);
+    fflush(stdout);
+}
+
+static int selected(const Bench* b, const char* name) {
+    return !b->filter || strncmp(name, b->filter, strlen(b->filter)) == 0;
+}
+
+static void die_oom(void) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+}
+
+// A roster of b->players players with plenty of balance, IDs 1..players, with leaderboards
+// attached as a session has them.
+static void roster_setup(Bench* b) {
+    roster_init(&b->roster);
+    if (roster_reserve(&b->roster, b->players) != 0) die_oom();
+    for (uint32_t i = 0; i < b->players; ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "player%u", i + 1);
+        if (engine_add_player(&b->roster, name, 1000000 * (Money)MONEY_SCALE) < 0) die_oom();
+    }
+    if (leaderboard_attach(&b->roster) != 0) die_oom();
+    b->ids = (uint32_t*)malloc(sizeof(uint32_t) * b->players);
+    if (!b->ids) die_oom();
+    b->id_count = 0;
+    for (uint32_t i = 0; i < b->roster.slot_count; ++i)
+        if (roster_at(&b->roster, i)->id) b->ids[b->id_count++] = roster_at(&b->roster, i)->id;
+}
+
+static void roster_teardown(Bench* b) {
+    roster_free(&b->roster);
+    free(b->ids);
+    b->ids = NULL;
+}
+
+static Samples S;
+
+static void bench_find(Bench* b) {
+    uint64_t sink = 0;
+    samples_begin(&S);
+    while (samples_more(&S, b)) {
+        uint64_t t0 = now_ns();
+        for (uint32_t i = 0; i < BATCH; ++i) sink += engine_find_player(&b->roster, random_id(b))->id;
+        samples_add(&S, now_ns() - t0, BATCH);
+    }
+    if (sink == 0) fprintf(stderr, "unexpected\n");
+    report(&S, "find_player", b->players);
+}
+
+// Adds a batch of players, then removes the same batch, so the roster keeps its size.
+static void bench_add_remove(Bench* b) {
+    static Samples removes;
+    uint32_t added[BATCH];
+    samples_begin(&S);
+    samples_begin(&removes);
+    while (samples_more(&S, b)) {
+        uint64_t t0 = now_ns();
+        for (uint32_t i = 0; i < BATCH; ++i) added[i] = (uint32_t)engine_add_player(&b->roster, "bench", 100);
+        uint64_t t1 = now_ns();
+        for (uint32_t i = 0; i < BATCH; ++i) engine_remove_player(&b->roster, added[i]);
+        samples_add(&S, t1 - t0, BATCH);
+        samples_add(&removes, now_ns() - t1, BATCH);
+    }
+    report(&S, "add_player", b->players);
+    report(&removes, "remove_player", b->players);
+}
+
+// Single-card purchases for random players into one long match.
+static void bench_buy(Bench* b) {
+    Match m = {0};
+    m.match_number = 1;
+    match_start(&m, GAME_NORMAL, 25);
+    samples_begin(&S);
+    while (samples_more(&S, b)) {
+        uint64_t t0 = now_ns();
+        for (uint32_t i = 0; i < BATCH; ++i) match_buy_cards(&m, &b->roster, engine_find_player(&b->roster, random_id(b)), 1);
+        samples_add(&S, now_ns() - t0, BATCH);
+    }
+    match_cancel(&m, &b->roster);
+    match_release(&m);
+    report(&S, "buy_cards", b->players);
+}
+
+// match_end alone, after every player bought a card and `winners` of them were named.
+static void bench_match_end(Bench* b, GameMode mode, uint32_t winners) {
+    if (winners > b->players) return;
+    char name[32];
+    snprintf(name, sizeof(name), "match_end_%s_w%u", mode == GAME_FULL_HOUSE ? "fullhouse" : "normal", winners);
+    if (!selected(b, name)) return;
+    Accounting acc;
+    engine_init(&acc);
+    Match m = {0};
+    samples_begin(&S);
+    while (samples_more(&S, b)) {
+        m.match_number = acc.next_match++;
+        match_start(&m, mode, 25);
+        for (uint32_t i = 0; i < b->id_count; ++i) match_buy_cards(&m, &b->roster, engine_find_player(&b->roster, b->ids[i]), 1);
+        for (uint32_t w = 0; w < winners; ++w) match_add_winner(&m, &b->roster, b->ids[(uint64_t)w * b->id_count / winners]);
+        uint64_t t0 = now_ns();
+        match_end(&m, &acc, &b->roster);
+        samples_add(&S, now_ns() - t0, 1);
+    }
+    match_release(&m);
+    report(&S, name, b->players);
+}
+
+// The top 10 of each board in turn, with the scores spread by a previous match_end benchmark or not.
+static void bench_leaderboard_top(Bench* b) {
+    BoardEntry top[10];
+    uint64_t sink = 0;
+    samples_begin(&S);
+    while (samples_more(&S, b)) {
+        uint64_t t0 = now_ns();
+        for (uint32_t i = 0; i < BATCH; ++i) sink += leaderboard_top(&b->roster, (BoardKind)(i % BOARD_COUNT), 10, top);
+        samples_add(&S, now_ns() - t0, BATCH);
+    }
+    if (sink == 0) fprintf(stderr, "unexpected\n");
+    report(&S, "leaderboard_top10", b->players);
+}
+
+// Building the boards over the whole roster, as at session start.
+static void bench_leaderboard_attach(Bench* b) {
+    samples_begin(&S);
+    while (samples_more(&S, b)) {
+        uint64_t t0 = now_ns();
+        if (leaderboard_attach(&b->roster) != 0) die_oom();
+        samples_add(&S, now_ns() - t0, 1);
+    }
+    report(&S, "leaderboard_attach", b->players);
+}
+
+static void bench_save_load(Bench* b) {
+    static Samples loads;
+    snprintf(b->path, sizeof(b->path), "%s/bench_roster.bin", b->dir);
+    samples_begin(&S);
+    samples_begin(&loads);
+    while (samples_more(&S, b)) {
+        uint64_t t0 = now_ns();
+        if (persist_save_roster(b->path, &b->roster, NULL) != 0) { fprintf(stderr, "cannot write %s\n", b->path); exit(1); }
+        uint64_t t1 = now_ns();
+        Roster loaded;
+        roster_init(&loaded);
+        if (persist_load_roster(b->path, &loaded, b->players * 2, NULL) != 0) { fprintf(stderr, "cannot load %s\n", b->path); exit(1); }
+        uint64_t t2 = now_ns();
+        roster_free(&loaded);
+        samples_add(&S, t1 - t0, 1);
+        samples_add(&loads, t2 - t1, 1);
+    }
+    remove(b->path);
+    if (selected(b, "save_roster")) report(&S, "save_roster", b->players);
+    if (selected(b, "load_roster")) report(&loads, "load_roster", b->players);
+}
+
+// threads 0 lets the export use one thread per core, as the menu does.
+static void bench_export(Bench* b, unsigned threads, const char* name) {
+    if (!selected(b, name)) return;
+    snprintf(b->path, sizeof(b->path), "%s/bench_players.csv", b->dir);
+    samples_begin(&S);
+    while (samples_more(&S, b)) {
+        uint64_t t0 = now_ns();
+        if (persist_export_players_csv(b->path, &b->roster, threads) != 0) { fprintf(stderr, "cannot write %s\n", b->path); exit(1); }
+        samples_add(&S, now_ns() - t0, 1);
+    }
+    remove(b->path);
+    report(&S, name, b->players);
+}
+
+// Independent of the roster, so reported once with players 0.
+static void bench_transaction(Bench* b) {
+    snprintf(b->path, sizeof(b->path), "%s/bench_transactions.csv", b->dir);
+    remove(b->path);
+    samples_begin(&S);
+    while (samples_more(&S, b)) {
+        uint64_t t0 = now_ns();
+        for (uint32_t i = 0; i < 16; ++i) persist_append_transaction(b->path, "buy", "buy,id=412,count=3,cost=0.75");
+        samples_add(&S, now_ns() - t0, 16);
+    }
+    remove(b->path);
+    report(&S, "append_transaction", 0);
+}
+
+int main(int argc, char** argv) {
+    Bench b = {0};
+    uint32_t max_players = 1000000;
+    b.budget = 1.0;
+    b.dir = ".";
+    b.seed = 2463534242u;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-s") == 0) max_players = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        else if (strcmp(argv[i], "-t") == 0) b.budget = strtod(argv[i + 1], NULL);
+        else if (strcmp(argv[i], "-d") == 0) b.dir = argv[i + 1];
+        else if (strcmp(argv[i], "-f") == 0) b.filter = argv[i + 1];
+        else argc = 0;
+    }
+    if (argc % 2 == 0 || max_players < 100 || b.budget <= 0) {
+        fprintf(stderr, "usage: bench [-s max players] [-t seconds per benchmark] [-d scratch dir] [-f name prefix]\n");
+        return 2;
+    }
+    cfg_init_defaults();
+    cfg_set_max_players(UINT32_MAX);
+    cfg_set_allow_multi_winners(1);
+
+    printf("# bingo-bench %d\n", BENCH_FORMAT);
+    printf("bench,players,ops,seconds,ops_per_sec,p50_ns,p90_ns,p99_ns,max_ns\n");
+    if (selected(&b, "append_transaction")) bench_transaction(&b);
+    static const uint32_t winner_counts[] = {1, 8, 64};
+    for (uint32_t n = 100; n <= max_players; n *= 10) {
+        fprintf(stderr, "%u players...\n", n);
+        b.players = n;
+        roster_setup(&b);
+        if (selected(&b, "find_player")) bench_find(&b);
+        if (selected(&b, "add_player") || selected(&b, "remove_player")) bench_add_remove(&b);
+        if (selected(&b, "buy_cards")) bench_buy(&b);
+        for (uint32_t w = 0; w < sizeof(winner_counts) / sizeof(winner_counts[0]); ++w) {
+            bench_match_end(&b, GAME_NORMAL, winner_counts[w]);
+            bench_match_end(&b, GAME_FULL_HOUSE, winner_counts[w]);
+        }
+        if (selected(&b, "leaderboard_top10")) bench_leaderboard_top(&b);
+        if (selected(&b, "leaderboard_attach")) bench_leaderboard_attach(&b);
+        if (selected(&b, "save_roster") || selected(&b, "load_roster")) bench_save_load(&b);
+        bench_export(&b, 0, "export_players_csv");
+        bench_export(&b, 1, "export_players_csv_1t");
+        roster_teardown(&b);
+        if (n > UINT32_MAX / 10) break;
+    }
+    return 0;
+}
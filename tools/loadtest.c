@@ -0,0 +1,249 @@
+// Load-test client for `bingo --serve` (Linux). Opens several connections, keeps a fixed
+// number of pipelined requests in flight on each, and reports throughput and latency.
+//
+//   loadtest <unix:path|tcp:port> [-c connections] [-d depth] [-n ops per connection] [-p players]
+//
+// Setup adds the players and starts a normal match if none is open; the match it started
+// is cancelled at the end (refunding the purchases), the added players stay.
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+typedef struct {
+    const char* endpoint;
+    const uint32_t* ids;
+    uint32_t id_count;
+    uint32_t depth;
+    uint32_t ops;
+    uint32_t seed;
+    uint64_t* latencies_ns;    // one per op
+    uint32_t errors;
+    int failed;
+} Worker;
+
+typedef struct {
+    int fd;
+    char buf[65536];
+    size_t len, pos;
+} Conn;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int conn_open(Conn* c, const char* endpoint) {
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+    if (strncmp(endpoint, "unix:", 5) == 0) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(endpoint + 5) >= sizeof(addr.sun_path)) return -1;
+        strcpy(addr.sun_path, endpoint + 5);
+        c->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (c->fd < 0 || connect(c->fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) return -1;
+    } else if (strncmp(endpoint, "tcp:", 4) == 0) {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)atoi(endpoint + 4));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        c->fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (c->fd < 0 || connect(c->fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) return -1;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int conn_send(Conn* c, const char* data, size_t len) {
+    while (len) {
+        ssize_t n = send(c->fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) { if (errno == EINTR) continue; return -1; }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Next response line (NUL-terminated, without the newline), or NULL if the connection closed.
+static char* conn_line(Conn* c) {
+    for (;;) {
+        char* nl = (char*)memchr(c->buf + c->pos, '\n', c->len - c->pos);
+        if (nl) {
+            *nl = '\0';
+            char* line = c->buf + c->pos;
+            c->pos = (size_t)(nl - c->buf) + 1;
+            return line;
+        }
+        memmove(c->buf, c->buf + c->pos, c->len - c->pos);
+        c->len -= c->pos;
+        c->pos = 0;
+        if (c->len == sizeof(c->buf)) return NULL;
+        ssize_t n = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return NULL;
+        c->len += (size_t)n;
+    }
+}
+
+static char* request(Conn* c, const char* cmd) {
+    if (conn_send(c, cmd, strlen(cmd)) != 0) return NULL;
+    return conn_line(c);
+}
+
+static uint32_t next_rand(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// 50% buy, 30% recharge, 20% player lookup.
+static int format_op(char* out, size_t cap, Worker* w) {
+    uint32_t r = next_rand(&w->seed);
+    uint32_t id = w->ids[r % w->id_count];
+    uint32_t kind = (r >> 16) % 10;
+    if (kind < 5) return snprintf(out, cap, "buy %u 1\n", id);
+    if (kind < 8) return snprintf(out, cap, "recharge %u 0.25\n", id);
+    return snprintf(out, cap, "find %u\n", id);
+}
+
+static void* worker_main(void* arg) {
+    Worker* w = (Worker*)arg;
+    Conn* c = (Conn*)malloc(sizeof(Conn));
+    uint64_t* sent_at = (uint64_t*)malloc(sizeof(uint64_t) * w->depth);
+    if (!c || !sent_at || conn_open(c, w->endpoint) != 0) { w->failed = 1; goto done; }
+    uint32_t sent = 0, done_ops = 0;
+    char cmd[64];
+    char batch[64 * 64];
+    // prime the pipeline, then send one request per response
+    size_t blen = 0;
+    while (sent < w->ops && sent < w->depth) {
+        int n = format_op(cmd, sizeof(cmd), w);
+        if (blen + (size_t)n > sizeof(batch)) { if (conn_send(c, batch, blen) != 0) { w->failed = 1; goto done; } blen = 0; }
+        memcpy(batch + blen, cmd, (size_t)n);
+        blen += (size_t)n;
+        sent_at[sent % w->depth] = now_ns();
+        sent++;
+    }
+    if (blen && conn_send(c, batch, blen) != 0) { w->failed = 1; goto done; }
+    while (done_ops < w->ops) {
+        char* line = conn_line(c);
+        if (!line) { w->failed = 1; goto done; }
+        uint64_t t = now_ns();
+        if (strncmp(line, "ok", 2) != 0) w->errors++;
+        w->latencies_ns[done_ops] = t - sent_at[done_ops % w->depth];
+        done_ops++;
+        if (sent < w->ops) {
+            int n = format_op(cmd, sizeof(cmd), w);
+            sent_at[sent % w->depth] = now_ns();
+            if (conn_send(c, cmd, (size_t)n) != 0) { w->failed = 1; goto done; }
+            sent++;
+        }
+    }
+    char* ok = request(c, "sync\n"); // count the run as done only once it is durable
+    if (!ok || strncmp(ok, "ok", 2) != 0) w->failed = 1;
+done:
+    if (c && c->fd >= 0) close(c->fd);
+    free(c);
+    free(sent_at);
+    return NULL;
+}
+
+static int cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static double pct_us(const uint64_t* sorted, size_t n, double p) {
+    size_t i = (size_t)(p * (double)(n - 1));
+    return (double)sorted[i] / 1000.0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: loadtest <unix:path|tcp:port> [-c connections] [-d depth] [-n ops] [-p players]\n");
+        return 2;
+    }
+    const char* endpoint = argv[1];
+    uint32_t conns = 8, depth = 32, ops = 100000, players = 200;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        uint32_t v = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        if (v == 0) { fprintf(stderr, "bad value for %s\n", argv[i]); return 2; }
+        if (strcmp(argv[i], "-c") == 0) conns = v;
+        else if (strcmp(argv[i], "-d") == 0) depth = v;
+        else if (strcmp(argv[i], "-n") == 0) ops = v;
+        else if (strcmp(argv[i], "-p") == 0) players = v;
+        else { fprintf(stderr, "unknown option %s\n", argv[i]); return 2; }
+    }
+
+    Conn* setup = (Conn*)malloc(sizeof(Conn));
+    uint32_t* ids = (uint32_t*)malloc(sizeof(uint32_t) * players);
+    if (!setup || !ids || conn_open(setup, endpoint) != 0) { fprintf(stderr, "cannot connect to %s\n", endpoint); return 1; }
+    for (uint32_t i = 0; i < players; ++i) {
+        char cmd[64];
+        snprintf(cmd, sizeof(cmd), "add load%u 1000000\n", i);
+        char* line = request(setup, cmd);
+        if (!line || sscanf(line, "ok %u", &ids[i]) != 1) { fprintf(stderr, "setup failed: %s\n", line ? line : "closed"); return 1; }
+    }
+    char* line = request(setup, "start normal\n");
+    if (!line) { fprintf(stderr, "setup failed: closed\n"); return 1; }
+    int started = strncmp(line, "ok", 2) == 0; // err match_active: sell into the open match
+
+    Worker* workers = (Worker*)calloc(conns, sizeof(Worker));
+    pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t) * conns);
+    if (!workers || !threads) return 1;
+    for (uint32_t i = 0; i < conns; ++i) {
+        workers[i].endpoint = endpoint;
+        workers[i].ids = ids;
+        workers[i].id_count = players;
+        workers[i].depth = depth;
+        workers[i].ops = ops;
+        workers[i].seed = 2463534242u + i * 7919u;
+        workers[i].latencies_ns = (uint64_t*)calloc(ops, sizeof(uint64_t));
+        if (!workers[i].latencies_ns) return 1;
+    }
+    uint64_t t0 = now_ns();
+    for (uint32_t i = 0; i < conns; ++i) pthread_create(&threads[i], NULL, worker_main, &workers[i]);
+    for (uint32_t i = 0; i < conns; ++i) pthread_join(threads[i], NULL);
+    double secs = (double)(now_ns() - t0) / 1e9;
+
+    size_t total = (size_t)conns * ops;
+    uint64_t* all = (uint64_t*)malloc(sizeof(uint64_t) * total);
+    if (!all) return 1;
+    uint32_t errors = 0;
+    int failed = 0;
+    for (uint32_t i = 0; i < conns; ++i) {
+        memcpy(all + (size_t)i * ops, workers[i].latencies_ns, sizeof(uint64_t) * ops);
+        errors += workers[i].errors;
+        failed |= workers[i].failed;
+        free(workers[i].latencies_ns);
+    }
+    qsort(all, total, sizeof(uint64_t), cmp_u64);
+    if (started) request(setup, "cancel\n");
+    close(setup->fd);
+
+    printf("connections %u, depth %u, ops %zu, errors %u%s\n", conns, depth, total, errors, failed ? ", CONNECTION FAILED" : "");
+    printf("throughput  %.0f ops/s (%.2f s)\n", (double)total / secs, secs);
+    printf("latency us  p50 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+           pct_us(all, total, 0.50), pct_us(all, total, 0.99), pct_us(all, total, 0.999), (double)all[total - 1] / 1000.0);
+    free(all);
+    free(workers);
+    free(threads);
+    free(ids);
+    free(setup);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,232 @@
+// Rebuilds player balances from the logs, for recovery after an incident. Starts from a roster
+// checkpoint (a backup of roster.bin, -b) or an empty roster, then replays:
+//
+//   - transactions.csv: add, remove, recharge and buy rows at or after -s;
+//   - the player ledger: payouts of ended matches and refunds of cancelled ones at or after -s.
+//
+// Purchases come from the buy rows and payouts from the ledger, so every movement counts once.
+// A match still open when the logs end keeps its players' spend, as its pot would. Records
+// (wins, losses) are left as the checkpoint has them; money and lifetime cards are rebuilt.
+//
+// Malformed log rows are reported by line number and skipped. Rows that do not fit the roster
+// (a buy for an unknown player, an add of an ID already taken) are reported as conflicts. With
+// -c the rebuilt roster is compared with a current roster file, player by player.
+//
+//   replay [-d data dir] [-b roster backup] [-s since] [-o rebuilt.csv] [-w rebuilt roster.bin]
+//          [-c roster.bin to compare] [-q]
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bingo.h"
+#include "audit.h"
+#include "config.h"
+#include "persist.h"
+
+#define REPLAY_REPORT_LIMIT 20 // lines printed per kind of problem; all are counted
+
+typedef struct {
+    Roster roster;
+    int64_t since;
+    int quiet;
+    uint64_t rows[TXN_BUY + 1];
+    uint64_t ledger_rows;
+    uint64_t malformed;
+    uint64_t conflicts;
+    uint64_t skipped_ids;      // IDs never seen in an add row (players added before the log)
+} Replay;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: replay [-d data dir] [-b roster backup] [-s since] [-o rebuilt.csv] [-w rebuilt roster.bin] [-c roster.bin] [-q]\n");
+}
+
+static void malformed(void* ctx, uint64_t line, const char* reason) {
+    Replay* rp = (Replay*)ctx;
+    if (++rp->malformed <= REPLAY_REPORT_LIMIT && !rp->quiet) printf("transactions.csv:%llu: %s\n", (unsigned long long)line, reason);
+}
+
+static void conflict(Replay* rp, const TxnRow* row, const char* what) {
+    if (++rp->conflicts <= REPLAY_REPORT_LIMIT && !rp->quiet)
+        printf("transactions.csv:%llu: %s (player %u)\n", (unsigned long long)row->line, what, row->player_id);
+}
+
+static int apply_transaction(void* ctx, const TxnRow* row) {
+    Replay* rp = (Replay*)ctx;
+    Roster* r = &rp->roster;
+    if (row->type == TXN_OTHER || row->at < rp->since) return 0;
+    rp->rows[row->type]++;
+    Player* p = row->type == TXN_ADD ? NULL : engine_find_player(r, row->player_id);
+    switch (row->type) {
+        case TXN_ADD: {
+            if (row->player_id < r->next_id) { conflict(rp, row, "add of an ID already used"); break; }
+            rp->skipped_ids += row->player_id - r->next_id;
+            r->next_id = row->player_id; // IDs in between were never logged
+            char name[PLAYER_NAME_LEN];
+            memcpy(name, row->name, row->name_len);
+            name[row->name_len] = '\0';
+            if (engine_add_player(r, name, row->amount) != (int)row->player_id) { fprintf(stderr, "out of memory\n"); return 1; }
+        } break;
+        case TXN_REMOVE:
+            if (engine_remove_player(r, row->player_id) != 0) conflict(rp, row, "remove of an unknown player");
+            break;
+        case TXN_RECHARGE:
+            if (engine_recharge_player(r, row->player_id, row->amount) != 0) conflict(rp, row, "recharge of an unknown player");
+            break;
+        case TXN_BUY:
+            if (!p) { conflict(rp, row, "buy by an unknown player"); break; }
+            p->balance -= row->amount;
+            p->total_spent += row->amount;
+            p->lifetime_cards += row->count;
+            r->totals.balances -= row->amount;
+            r->totals.spent += row->amount;
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+typedef struct {
+    Replay* rp;
+    Player* p;
+} LedgerCtx;
+
+static int apply_ledger(void* ctx, const LedgerRow* row) {
+    LedgerCtx* c = (LedgerCtx*)ctx;
+    Roster* r = &c->rp->roster;
+    c->rp->ledger_rows++;
+    c->p->balance += row->payout;
+    r->totals.balances += row->payout;
+    if (row->flags & LEDGER_CANCELLED) {
+        // the refund undoes the purchase the buy row booked
+        c->p->total_spent -= row->payout;
+        r->totals.spent -= row->payout;
+    } else {
+        c->p->total_won += row->payout;
+        r->totals.won += row->payout;
+    }
+    return 0;
+}
+
+// Prints the players whose money or cards differ from the roster file; returns how many.
+static uint64_t compare(const Replay* rp, const char* path, int quiet) {
+    Roster cur;
+    roster_init(&cur);
+    if (persist_load_roster(path, &cur, UINT32_MAX, NULL) != 0) { fprintf(stderr, "cannot load %s\n", path); exit(1); }
+    if (cur.needs_rewrite) audit_book_openings(&cur, NULL, NULL); // an older file, as the session reads it
+    uint64_t diffs = 0;
+    Roster* a = (Roster*)&rp->roster;
+    for (int pass = 0; pass < 2; ++pass) {
+        Roster* from = pass == 0 ? a : &cur;
+        Roster* other = pass == 0 ? &cur : a;
+        for (uint32_t i = 0; i < from->slot_count; ++i) {
+            const Player* p = roster_at(from, i);
+            if (p->id == 0) continue;
+            const Player* q = engine_find_player(other, p->id);
+            if (pass == 1 && q) continue; // compared in the first pass
+            const Player* re = pass == 0 ? p : q;
+            const Player* cu = pass == 0 ? q : p;
+            int same = re && cu && re->balance == cu->balance && re->total_recharged == cu->total_recharged &&
+                       re->total_spent == cu->total_spent && re->total_won == cu->total_won && re->lifetime_cards == cu->lifetime_cards;
+            if (same) continue;
+            if (++diffs > REPLAY_REPORT_LIMIT || quiet) continue;
+            if (!cu) printf("player %u: replayed only (balance %.2f)\n", p->id, money_units(re->balance));
+            else if (!re) printf("player %u: in %s only (balance %.2f)\n", p->id, path, money_units(cu->balance));
+            else
+                printf("player %u: balance %.2f vs %.2f, recharged %.2f vs %.2f, spent %.2f vs %.2f, won %.2f vs %.2f, cards %u vs %u\n", p->id,
+                       money_units(re->balance), money_units(cu->balance), money_units(re->total_recharged), money_units(cu->total_recharged),
+                       money_units(re->total_spent), money_units(cu->total_spent), money_units(re->total_won), money_units(cu->total_won),
+                       re->lifetime_cards, cu->lifetime_cards);
+        }
+    }
+    roster_free(&cur);
+    return diffs;
+}
+
+int main(int argc, char** argv) {
+    const char* dir = "data";
+    const char* backup = NULL;
+    const char* out_csv = NULL;
+    const char* out_roster = NULL;
+    const char* current = NULL;
+    Replay* rp = (Replay*)calloc(1, sizeof(Replay));
+    if (!rp) { fprintf(stderr, "out of memory\n"); return 1; }
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-q") == 0) { rp->quiet = 1; continue; }
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) { usage(); return 2; }
+        const char* arg = argv[++i];
+        switch (argv[i - 1][1]) {
+            case 'd': dir = arg; break;
+            case 'b': backup = arg; break;
+            case 's': rp->since = strtoll(arg, NULL, 10); break;
+            case 'o': out_csv = arg; break;
+            case 'w': out_roster = arg; break;
+            case 'c': current = arg; break;
+            default: usage(); return 2;
+        }
+    }
+    cfg_init_defaults();
+    cfg_set_max_players(UINT32_MAX - 1);
+    roster_init(&rp->roster);
+    if (backup) {
+        if (persist_load_roster(backup, &rp->roster, UINT32_MAX, NULL) != 0) { fprintf(stderr, "cannot load %s\n", backup); return 1; }
+        if (rp->roster.needs_rewrite) audit_book_openings(&rp->roster, NULL, NULL);
+        Accounting none;
+        memset(&none, 0, sizeof(none));
+        audit_rebase(&rp->roster, &none, NULL, 0);
+    }
+    uint32_t baseline = rp->roster.count;
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/transactions.csv", dir);
+    FILE* probe = fopen(path, "rb");
+    long long bytes = 0;
+    if (probe) { fseek(probe, 0, SEEK_END); bytes = ftell(probe); fclose(probe); }
+    uint64_t t0 = now_ns();
+    int rows = persist_read_transactions(path, apply_transaction, rp, malformed, rp);
+    uint64_t t1 = now_ns();
+    if (rows < 0) { fprintf(stderr, "cannot read %s\n", path); return 1; }
+
+    snprintf(path, sizeof(path), "%s/ledger", dir);
+    PlayerLedger* l = persist_ledger_open(path);
+    if (!l) { fprintf(stderr, "cannot open the ledger at %s\n", path); return 1; }
+    for (uint32_t i = 0; i < rp->roster.slot_count; ++i) {
+        LedgerCtx c = { rp, roster_at(&rp->roster, i) };
+        if (c.p->id == 0) continue;
+        if (persist_ledger_statement(l, c.p->id, rp->since, INT64_MAX, apply_ledger, &c) < 0) { fprintf(stderr, "ledger read error\n"); return 1; }
+    }
+    persist_ledger_close(l);
+    uint64_t t2 = now_ns();
+
+    AuditTotals sums;
+    audit_roster(&rp->roster, &sums); // negative fields point at rows missing from the logs
+    double secs = (double)(t1 - t0) / 1e9;
+    printf("transactions: %d rows (%llu add, %llu remove, %llu recharge, %llu buy), %llu malformed, %.1f MB in %.3f s (%.0f MB/s)\n", rows,
+           (unsigned long long)rp->rows[TXN_ADD], (unsigned long long)rp->rows[TXN_REMOVE], (unsigned long long)rp->rows[TXN_RECHARGE],
+           (unsigned long long)rp->rows[TXN_BUY], (unsigned long long)rp->malformed, (double)bytes / 1e6, secs, secs > 0 ? (double)bytes / 1e6 / secs : 0.0);
+    printf("ledger: %llu rows in %.3f s\n", (unsigned long long)rp->ledger_rows, (double)(t2 - t1) / 1e9);
+    printf("players: %u (%u from the checkpoint), %llu conflicts, %llu IDs never added in the log, %u with a negative money field\n", rp->roster.count,
+           baseline, (unsigned long long)rp->conflicts, (unsigned long long)rp->skipped_ids, sums.negative);
+    printf("totals: balances %.2f, recharged %.2f, spent %.2f, won %.2f\n", money_units(sums.balance), money_units(sums.recharged),
+           money_units(sums.spent), money_units(sums.won));
+
+    int status = 0;
+    if (out_csv && persist_export_players_csv(out_csv, &rp->roster, 0) != 0) { fprintf(stderr, "cannot write %s\n", out_csv); status = 1; }
+    if (out_roster && persist_save_roster(out_roster, &rp->roster, NULL) != 0) { fprintf(stderr, "cannot write %s\n", out_roster); status = 1; }
+    if (current) {
+        uint64_t diffs = compare(rp, current, rp->quiet);
+        printf("compare: %llu players differ from %s\n", (unsigned long long)diffs, current);
+        if (diffs) status = 1;
+    }
+    roster_free(&rp->roster);
+    free(rp);
+    return status;
+}
@@ -0,0 +1,265 @@
+// Deterministic session simulator and load generator. Plays whole nights against the engine
+// API at full speed: a share of the roster turns up, plays a run of normal matches that feed the
+// saved pot (buying cards in one batch per match, recharging when short), then a full house
+// match that pays it out. Some players leave and new ones join between nights.
+//
+// After every match_end it checks that no cent was created or lost, both with the engine's own
+// O(1) books (audit_verify) and independently: the balances plus the saved pot must equal the
+// money put in (opening balances and recharges) less the balances of players who left. Every
+// night, or every match with -V, it also reconciles each player (audit_recount).
+//
+// The same options and seed always play the same session; the final checksum over the roster
+// and the saved pot shows it.
+//
+//   simulate [-s seed] [-n nights] [-p players] [-m normal matches per night] [-a attendance %]
+//            [-j join %] [-c mean cards] [-x max cards] [-w max winners] [-W max full house winners]
+//            [-r recharge %] [-R recharge units] [-b opening units] [-F full house card cents]
+//            [-q churn %] [-V]
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bingo.h"
+#include "audit.h"
+#include "config.h"
+
+typedef struct {
+    uint64_t seed;
+    uint32_t nights;
+    uint32_t players;
+    uint32_t matches;          // normal matches per night, before the full house
+    uint32_t attendance;       // % of the roster playing a night
+    uint32_t join;             // % of the night's players buying into each match
+    uint32_t mean_cards;       // geometric distribution, 1..max_cards
+    uint32_t max_cards;
+    uint32_t max_winners;      // each match names 1..max of its buyers
+    uint32_t max_fh_winners;
+    uint32_t recharge;         // % chance a player short of balance recharges
+    Money recharge_amount;
+    Money opening;
+    Money fullhouse_cost;
+    uint32_t churn;            // % of the roster replaced between nights
+    int verify_every_match;
+} SimOptions;
+
+typedef struct {
+    SimOptions o;
+    uint64_t rng;
+    Roster roster;
+    Accounting acc;
+    Match match;
+    uint32_t* night;           // IDs of the players attending tonight
+    uint32_t night_count;
+    MatchPurchase* items;
+    int* status;
+    Money money_in;            // opening balances and recharges
+    Money money_out;           // balances taken away by players who left
+    uint64_t events;
+    uint64_t buys;
+    uint64_t rejected;         // purchase lines refused for balance
+    uint64_t recharges;
+    uint64_t matches;
+    int failed;
+} Sim;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift64*: small, fast and the same on every platform.
+static uint32_t next_rand(Sim* s) {
+    s->rng ^= s->rng >> 12;
+    s->rng ^= s->rng << 25;
+    s->rng ^= s->rng >> 27;
+    return (uint32_t)((s->rng * 2685821657736338717ull) >> 32);
+}
+
+static uint32_t rand_below(Sim* s, uint32_t n) {
+    return (uint32_t)(((uint64_t)next_rand(s) * n) >> 32);
+}
+
+static int chance(Sim* s, uint32_t percent) {
+    return rand_below(s, 100) < percent;
+}
+
+// 1..max cards, geometric with the given mean (capped).
+static uint32_t draw_cards(Sim* s) {
+    uint32_t cards = 1;
+    uint32_t stop = 100 / s->o.mean_cards; // % chance of stopping after each card
+    while (cards < s->o.max_cards && !chance(s, stop)) cards++;
+    return cards;
+}
+
+static void count_event(void* ctx, const EngineEvent* ev) {
+    (void)ev;
+    ((Sim*)ctx)->events++;
+}
+
+static void fail(Sim* s, const char* what) {
+    if (!s->failed) fprintf(stderr, "match %u: %s\n", s->match.match_number, what);
+    s->failed = 1;
+}
+
+static void add_player(Sim* s) {
+    char name[32];
+    snprintf(name, sizeof(name), "sim%u", s->roster.next_id);
+    if (engine_add_player(&s->roster, name, s->o.opening) < 0) { fprintf(stderr, "out of memory\n"); exit(1); }
+    s->money_in += s->o.opening;
+}
+
+// Conservation after a match_end: the engine's books, then the simulator's own count.
+static void check_books(Sim* s, int full) {
+    if (audit_verify(&s->roster, &s->acc, &s->match, 1) != 0) fail(s, "books do not balance (audit_verify)");
+    if (!full) return;
+    AuditTotals t;
+    if (audit_recount(&s->roster, &t) != 0) fail(s, "a player does not reconcile (audit_recount)");
+    if (t.balance + s->acc.saved_pot != s->money_in - s->money_out) fail(s, "balances + saved pot != money put in - money taken out");
+}
+
+static void play_match(Sim* s, GameMode mode) {
+    s->match.match_number = s->acc.next_match++;
+    match_start(&s->match, mode, mode == GAME_FULL_HOUSE ? s->o.fullhouse_cost : 0);
+    Money cost = s->match.card_cost;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < s->night_count; ++i) {
+        if (!chance(s, s->o.join)) continue;
+        uint32_t cards = draw_cards(s);
+        Player* p = engine_find_player(&s->roster, s->night[i]);
+        if (p->balance < cost * (Money)cards && chance(s, s->o.recharge)) {
+            engine_recharge_player(&s->roster, p->id, s->o.recharge_amount);
+            s->money_in += s->o.recharge_amount;
+            s->recharges++;
+        }
+        s->items[n++] = (MatchPurchase){p->id, cards};
+    }
+    int bought = match_buy_cards_batch(&s->match, &s->roster, s->items, n, s->status);
+    if (bought < 0) { fprintf(stderr, "out of memory\n"); exit(1); }
+    s->buys += (uint64_t)bought;
+    s->rejected += n - (uint32_t)bought;
+
+    uint32_t buyers = s->match.entry_count;
+    if (buyers == 0) { match_cancel(&s->match, &s->roster); return; }
+    uint32_t max = mode == GAME_FULL_HOUSE ? s->o.max_fh_winners : s->o.max_winners;
+    uint32_t winners = 1 + rand_below(s, max < buyers ? max : buyers);
+    // distinct buyers: retry the few duplicates
+    while (s->match.winner_count < winners) {
+        int rc = match_add_winner(&s->match, &s->roster, s->match.entries[rand_below(s, buyers)].player_id);
+        if (rc != 0 && rc != -6) { fail(s, "winner rejected"); break; }
+    }
+    match_end(&s->match, &s->acc, &s->roster);
+    s->matches++;
+    check_books(s, s->o.verify_every_match);
+}
+
+static void play_night(Sim* s) {
+    s->night_count = 0;
+    for (uint32_t i = 0; i < s->roster.slot_count; ++i) {
+        const Player* p = roster_at(&s->roster, i);
+        if (p->id && chance(s, s->o.attendance)) s->night[s->night_count++] = p->id;
+    }
+    for (uint32_t m = 0; m < s->o.matches; ++m) play_match(s, GAME_NORMAL);
+    play_match(s, GAME_FULL_HOUSE);
+    check_books(s, 1);
+
+    // churn: some players leave with their balance, as many new ones join
+    uint32_t leaving = (uint32_t)((uint64_t)s->roster.count * s->o.churn / 100);
+    for (uint32_t i = 0; i < leaving; ++i) {
+        uint32_t slot = rand_below(s, s->roster.slot_count);
+        Player* p = roster_at(&s->roster, slot);
+        if (!p->id) continue; // already left tonight
+        s->money_out += p->balance;
+        engine_remove_player(&s->roster, p->id);
+        add_player(s);
+    }
+}
+
+static uint64_t checksum(const Sim* s) {
+    uint64_t h = 1469598103934665603ull; // FNV-1a over (id, balance, won) and the saved pot
+    for (uint32_t i = 0; i < s->roster.slot_count; ++i) {
+        const Player* p = roster_at(&s->roster, i);
+        if (!p->id) continue;
+        uint64_t v[3] = {p->id, (uint64_t)p->balance, (uint64_t)p->total_won};
+        for (int k = 0; k < 3; ++k) { h ^= v[k]; h *= 1099511628211ull; }
+    }
+    h ^= (uint64_t)s->acc.saved_pot;
+    return h * 1099511628211ull;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: simulate [-s seed] [-n nights] [-p players] [-m normal matches per night] [-a attendance %%]\n"
+                    "                [-j join %%] [-c mean cards] [-x max cards] [-w max winners] [-W max full house winners]\n"
+                    "                [-r recharge %%] [-R recharge units] [-b opening units] [-F full house card cents]\n"
+                    "                [-q churn %%] [-V]\n");
+}
+
+int main(int argc, char** argv) {
+    SimOptions o = {1, 7, 5000, 30, 60, 90, 3, 12, 3, 2, 50, 2000, 2000, 100, 1, 0};
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-V") == 0) { o.verify_every_match = 1; continue; }
+        if (i + 1 >= argc || argv[i][0] != '-' || strlen(argv[i]) != 2) { usage(); return 2; }
+        const char* arg = argv[++i];
+        uint64_t v = strtoull(arg, NULL, 10);
+        switch (argv[i - 1][1]) {
+            case 's': o.seed = v; break;
+            case 'n': o.nights = (uint32_t)v; break;
+            case 'p': o.players = (uint32_t)v; break;
+            case 'm': o.matches = (uint32_t)v; break;
+            case 'a': o.attendance = (uint32_t)v; break;
+            case 'j': o.join = (uint32_t)v; break;
+            case 'c': o.mean_cards = (uint32_t)v; break;
+            case 'x': o.max_cards = (uint32_t)v; break;
+            case 'w': o.max_winners = (uint32_t)v; break;
+            case 'W': o.max_fh_winners = (uint32_t)v; break;
+            case 'r': o.recharge = (uint32_t)v; break;
+            case 'R': o.recharge_amount = money_from_units(strtod(arg, NULL)); break;
+            case 'b': o.opening = money_from_units(strtod(arg, NULL)); break;
+            case 'F': o.fullhouse_cost = (Money)v; break;
+            case 'q': o.churn = (uint32_t)v; break;
+            default: usage(); return 2;
+        }
+    }
+    if (o.players == 0 || o.mean_cards == 0 || o.mean_cards > 100 || o.max_cards == 0 || o.max_winners == 0 || o.max_winners > 64 ||
+        o.max_fh_winners == 0 || o.max_fh_winners > 64 || o.fullhouse_cost <= 0 || o.churn > 100) {
+        usage();
+        return 2;
+    }
+
+    Sim* s = (Sim*)calloc(1, sizeof(Sim));
+    if (!s) { fprintf(stderr, "out of memory\n"); return 1; }
+    s->o = o;
+    s->rng = o.seed * 0x9E3779B97F4A7C15ull + 1; // never zero
+    engine_init(&s->acc); // resets the configuration to its defaults
+    if (cfg_get_max_players() < o.players) cfg_set_max_players(o.players);
+    roster_init(&s->roster);
+    s->night = (uint32_t*)malloc(sizeof(uint32_t) * o.players);
+    s->items = (MatchPurchase*)malloc(sizeof(MatchPurchase) * o.players);
+    s->status = (int*)malloc(sizeof(int) * o.players);
+    if (!s->night || !s->items || !s->status || roster_reserve(&s->roster, o.players) != 0) { fprintf(stderr, "out of memory\n"); return 1; }
+    for (uint32_t i = 0; i < o.players; ++i) add_player(s);
+    engine_set_event_sink(count_event, s);
+
+    uint64_t t0 = now_ns();
+    for (uint32_t n = 0; n < o.nights && !s->failed; ++n) play_night(s);
+    double secs = (double)(now_ns() - t0) / 1e9;
+
+    printf("seed %llu: %u nights, %u players, %llu matches, %llu purchases (%llu refused), %llu recharges\n",
+           (unsigned long long)o.seed, o.nights, o.players, (unsigned long long)s->matches, (unsigned long long)s->buys,
+           (unsigned long long)s->rejected, (unsigned long long)s->recharges);
+    printf("%.3f s: %.0f matches/s, %.0f events/s\n", secs, s->matches / secs, s->events / secs);
+    printf("money in %.2f, out %.2f, saved pot %.2f\n", money_units(s->money_in), money_units(s->money_out), money_units(s->acc.saved_pot));
+    printf("checksum %016llx\n", (unsigned long long)checksum(s));
+    printf("%s\n", s->failed ? "CONSERVATION CHECK FAILED" : "all checks passed: no cent created or lost");
+    int rc = s->failed ? 1 : 0;
+    engine_set_event_sink(NULL, NULL);
+    match_release(&s->match);
+    roster_free(&s->roster);
+    free(s->night);
+    free(s->items);
+    free(s->status);
+    free(s);
+    return rc;
+}
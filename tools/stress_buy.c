@@ -0,0 +1,246 @@
+// Concurrency stress test for card sales through the shared engine handle (engine.h).
+// For 1, 2, 4, ... threads it sells into one match, first through engine_match_buy (every sale
+// under the hall lock), then through per-thread sellers, and reports sales per second. Each
+// run then checks that no cent was lost: the pot equals the sum of the sales the threads saw
+// succeed, every player's money adds up, and after the payout the balances plus the saved pot
+// equal the money put in. A last run drains balances to zero from all threads at once to
+// check that a reservation never overdraws, then again with one thread buying through
+// engine_match_buy_batch, which debits without compare-and-swap, beside the sellers.
+//
+//   stress_buy [-t max threads] [-n sales per thread] [-p players]
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "bingo.h"
+#include "audit.h"
+#include "config.h"
+#include "engine.h"
+
+#define CARD_COST 25 // cents
+
+typedef struct {
+    Engine* engine;
+    EngineSeller* seller;      // NULL: sell through engine_match_buy
+    uint32_t players;
+    uint32_t sales;
+    uint32_t seed;
+    Money sold;                // cents of the sales that succeeded
+    Money recharged;
+    uint64_t rejected;
+    int failed;
+} Worker;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t next_rand(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// Mostly sales of 1-3 cards to random players, with a recharge every 16th operation and a read
+// of the match (which merges the sellers' sales while they keep selling) every 4096th.
+static void* worker_main(void* arg) {
+    Worker* w = (Worker*)arg;
+    for (uint32_t i = 0; i < w->sales; ++i) {
+        if ((i & 4095) == 4095) {
+            Match m;
+            if (engine_match_get(w->engine, 0, &m) != 0) w->failed = 1;
+        }
+        uint32_t r = next_rand(&w->seed);
+        uint32_t id = 1 + r % w->players;
+        if ((r >> 24 & 15) == 0) {
+            if (engine_player_recharge(w->engine, id, 100) == 0) w->recharged += 100;
+            continue;
+        }
+        uint32_t count = 1 + (r >> 28) % 3;
+        int rc = w->seller ? engine_seller_buy(w->seller, id, count) : engine_match_buy(w->engine, 0, id, count);
+        if (rc == 0) w->sold += CARD_COST * (Money)count;
+        else if (rc == -4) w->rejected++;
+        else w->failed = 1;
+    }
+    return NULL;
+}
+
+// Runs `threads` workers against a fresh engine; returns sales per second, or -1 if a check failed.
+static double run(uint32_t threads, uint32_t sales, uint32_t players, Money initial, int sellers) {
+    Engine* e = engine_create(1);
+    Worker* workers = (Worker*)calloc(threads, sizeof(Worker));
+    pthread_t* tids = (pthread_t*)malloc(sizeof(pthread_t) * threads);
+    if (!e || !workers || !tids) { fprintf(stderr, "out of memory\n"); exit(1); }
+    for (uint32_t i = 0; i < players; ++i) engine_player_add(e, "p", initial);
+    engine_match_start(e, 0, GAME_NORMAL, CARD_COST);
+    for (uint32_t t = 0; t < threads; ++t) {
+        workers[t].engine = e;
+        workers[t].seller = sellers ? engine_seller_open(e, 0) : NULL;
+        workers[t].players = players;
+        workers[t].sales = sales;
+        workers[t].seed = 2463534242u + t * 7919u;
+        if (sellers && !workers[t].seller) { fprintf(stderr, "out of memory\n"); exit(1); }
+    }
+    uint64_t t0 = now_ns();
+    for (uint32_t t = 0; t < threads; ++t) pthread_create(&tids[t], NULL, worker_main, &workers[t]);
+    for (uint32_t t = 0; t < threads; ++t) pthread_join(tids[t], NULL);
+    double secs = (double)(now_ns() - t0) / 1e9;
+
+    Money sold = 0, recharged = 0;
+    int ok = 1;
+    for (uint32_t t = 0; t < threads; ++t) {
+        sold += workers[t].sold;
+        recharged += workers[t].recharged;
+        if (workers[t].failed) ok = 0;
+        if (workers[t].seller && engine_seller_close(workers[t].seller) != 0) ok = 0;
+    }
+    Match m;
+    engine_match_get(e, 0, &m);
+    if (m.pot != sold) { printf("  pot %lld != sold %lld\n", (long long)m.pot, (long long)sold); ok = 0; }
+
+    // every player: recharged (opening balance included) - spent == balance, never below zero
+    Roster* r;
+    Accounting* acc;
+    Match* halls;
+    engine_exclusive_begin(e, &r, &acc, &halls);
+    AuditTotals totals;
+    if (audit_recount(r, &totals) != 0 || totals.won != 0 || audit_verify(r, acc, halls, 1) != 0) ok = 0;
+    Money spent = totals.spent;
+    uint64_t cards = 0, ledger_cards = 0;
+    uint32_t first_buyer = halls[0].entry_count ? halls[0].entries[0].player_id : 0;
+    for (uint32_t i = 0; i < r->slot_count; ++i) cards += roster_at(r, i)->cards_owned;
+    for (uint32_t i = 0; i < halls[0].entry_count; ++i) ledger_cards += halls[0].entries[i].cards;
+    if (spent != sold || cards != ledger_cards || ledger_cards * CARD_COST != (uint64_t)sold) {
+        printf("  spent %lld, cards %llu, ledger cards %llu, sold %lld\n", (long long)spent,
+               (unsigned long long)cards, (unsigned long long)ledger_cards, (long long)sold);
+        ok = 0;
+    }
+    engine_exclusive_end(e);
+
+    // pay out and check the money put in is all in balances or the saved pot
+    if (first_buyer) engine_match_add_winner(e, 0, first_buyer);
+    if (engine_match_end(e, 0) != 0 || engine_verify(e) != 0) ok = 0;
+    engine_exclusive_begin(e, &r, &acc, &halls);
+    if (audit_recount(r, &totals) != 0) ok = 0;
+    Money after = totals.balance;
+    Money in = initial * (Money)players + recharged;
+    if (totals.recharged != in) ok = 0;
+    if (after + acc->saved_pot != in) { printf("  balances %lld + saved %lld != %lld put in\n", (long long)after, (long long)acc->saved_pot, (long long)in); ok = 0; }
+    engine_exclusive_end(e);
+
+    engine_destroy(e);
+    free(workers);
+    free(tids);
+    return ok ? (double)threads * sales / secs : -1.0;
+}
+
+typedef struct {
+    Engine* engine;
+    EngineSeller* seller;      // NULL: buy through engine_match_buy_batch
+    uint32_t players;
+    uint32_t cards;
+    int failed;
+} Drainer;
+
+// Buys single cards round-robin until every player is out of money.
+static void* drain_main(void* arg) {
+    Drainer* d = (Drainer*)arg;
+    for (uint32_t idle = 0, id = 1; idle < d->players; id = id % d->players + 1) {
+        if (engine_seller_buy(d->seller, id, 1) == 0) { d->cards++; idle = 0; }
+        else idle++;
+    }
+    return NULL;
+}
+
+// One card for every player per batch, until a batch buys nothing.
+static void* batch_drain_main(void* arg) {
+    Drainer* d = (Drainer*)arg;
+    MatchPurchase* items = (MatchPurchase*)malloc(sizeof(MatchPurchase) * d->players);
+    int* status = (int*)malloc(sizeof(int) * d->players);
+    if (!items || !status) { fprintf(stderr, "out of memory\n"); exit(1); }
+    for (uint32_t i = 0; i < d->players; ++i) { items[i].player_id = i + 1; items[i].count = 1; }
+    for (;;) {
+        int bought = engine_match_buy_batch(d->engine, 0, items, d->players, status);
+        if (bought < 0) { d->failed = 1; break; }
+        if (bought == 0) break;
+        d->cards += (uint32_t)bought;
+    }
+    free(items);
+    free(status);
+    return NULL;
+}
+
+// Players get exactly `per_player` cards' worth; all threads race to spend it. With `batch`,
+// thread 0 buys through engine_match_buy_batch instead of a seller.
+static int overdraw_check(uint32_t threads, uint32_t players, uint32_t per_player, int batch) {
+    Engine* e = engine_create(1);
+    Drainer* d = (Drainer*)calloc(threads, sizeof(Drainer));
+    pthread_t* tids = (pthread_t*)malloc(sizeof(pthread_t) * threads);
+    if (!e || !d || !tids) { fprintf(stderr, "out of memory\n"); exit(1); }
+    for (uint32_t i = 0; i < players; ++i) engine_player_add(e, "p", CARD_COST * (Money)per_player);
+    engine_match_start(e, 0, GAME_NORMAL, CARD_COST);
+    int ok = 1;
+    for (uint32_t t = 0; t < threads; ++t) {
+        d[t].engine = e;
+        d[t].seller = batch && t == 0 ? NULL : engine_seller_open(e, 0);
+        d[t].players = players;
+        if (!d[t].seller && !(batch && t == 0)) { fprintf(stderr, "out of memory\n"); exit(1); }
+        pthread_create(&tids[t], NULL, d[t].seller ? drain_main : batch_drain_main, &d[t]);
+    }
+    uint64_t cards = 0;
+    for (uint32_t t = 0; t < threads; ++t) {
+        pthread_join(tids[t], NULL);
+        cards += d[t].cards;
+        if (d[t].failed) ok = 0;
+        if (d[t].seller && engine_seller_close(d[t].seller) != 0) ok = 0;
+    }
+    if (cards != (uint64_t)players * per_player) ok = 0;
+    for (uint32_t id = 1; id <= players; ++id) {
+        Player p;
+        if (engine_player_get(e, id, &p, NULL) != 0 || p.balance != 0) ok = 0;
+    }
+    Match m;
+    engine_match_get(e, 0, &m);
+    if (m.pot != CARD_COST * (Money)cards) ok = 0;
+    printf("overdraw check%s: %u threads sold %llu of %llu cards, pot %.2f: %s\n", batch ? " (with a batch buyer)" : "", threads, (unsigned long long)cards,
+           (unsigned long long)players * per_player, money_units(m.pot), ok ? "ok" : "FAILED");
+    engine_match_cancel(e, 0);
+    engine_destroy(e);
+    free(d);
+    free(tids);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    uint32_t max_threads = 8, sales = 1000000, players = 10000;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        uint32_t v = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+        if (v == 0) { fprintf(stderr, "bad value for %s\n", argv[i]); return 2; }
+        if (strcmp(argv[i], "-t") == 0) max_threads = v;
+        else if (strcmp(argv[i], "-n") == 0) sales = v;
+        else if (strcmp(argv[i], "-p") == 0) players = v;
+        else { fprintf(stderr, "usage: stress_buy [-t max threads] [-n sales per thread] [-p players]\n"); return 2; }
+    }
+    if (argc % 2 == 0) { fprintf(stderr, "usage: stress_buy [-t max threads] [-n sales per thread] [-p players]\n"); return 2; }
+    if (cfg_get_max_players() < players) cfg_set_max_players(players);
+    // enough money for about half the sales, so reservations are also refused under contention
+    Money initial = CARD_COST * 2 * ((Money)sales * max_threads / players / 2 + 1);
+    int ok = 1;
+    printf("threads  hall lock sales/s  sellers sales/s  speedup\n");
+    for (uint32_t t = 1; t <= max_threads; t *= 2) {
+        double locked = run(t, sales, players, initial, 0);
+        double sellers = run(t, sales, players, initial, 1);
+        if (locked < 0 || sellers < 0) ok = 0;
+        printf("%7u  %17.0f  %15.0f  %6.2fx%s\n", t, locked, sellers, sellers / locked, locked < 0 || sellers < 0 ? "  CHECK FAILED" : "");
+    }
+    if (!overdraw_check(max_threads, 64, 1000, 0)) ok = 0;
+    if (!overdraw_check(max_threads < 2 ? 2 : max_threads, 16, 20000, 1)) ok = 0;
+    printf("%s\n", ok ? "all checks passed: no cent lost" : "CHECKS FAILED");
+    return ok ? 0 : 1;
+}